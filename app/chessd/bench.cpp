@@ -0,0 +1,166 @@
+#include "bench.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "controller.h"
+#include "latency.h"
+#include "listener.h"
+#include "notation.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Longest game played before starting a new one
+static const size_t max_plies = 200;
+
+// Promotes pawns to queens, as the server does unless told otherwise
+class QueenListener : public GameListener
+{
+public:
+	PieceTypeId promotePawn(GameController const& gameController,
+	                        Square pawn) override
+	{
+		return PieceTypeId::QUEEN;
+	}
+
+	void catchError(GameController const& gameController,
+	                GameError err) override {}
+};
+
+// Connection to the server, sending one request at a time
+class Client
+{
+public:
+	explicit Client(int fd) : m_fd(fd) {}
+	~Client() { close(m_fd); }
+
+	// Send request and wait for the reply
+	// Returns false if the connection was lost
+	bool request(string const& line, string& reply)
+	{
+		auto const text = line + '\n';
+		size_t sent = 0;
+		while (sent < text.size()) {
+			auto const n = send(m_fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+			if (n <= 0)
+				return false;
+			sent += static_cast<size_t>(n);
+		}
+
+		while (true) {
+			auto const end = m_input.find('\n');
+			if (end != string::npos) {
+				reply = m_input.substr(0, end);
+				m_input.erase(0, end + 1);
+				return true;
+			}
+			char buffer[4096];
+			auto const n = recv(m_fd, buffer, sizeof(buffer), 0);
+			if (n <= 0)
+				return false;
+			m_input.append(buffer, static_cast<size_t>(n));
+		}
+	}
+private:
+	int m_fd;
+	string m_input;
+};
+
+// Get legal event of the game state at random, in coordinate notation
+static string pickEvent(GameController const& controller, mt19937_64& rng)
+{
+	vector<EventRecord> events;
+	getLegalEvents(controller.getLegalMoves(), events);
+	if (events.empty())
+		return {};
+	auto record = events[rng() % events.size()];
+	return formatEvent(record);
+}
+
+bool runBench(Address const& address, unsigned int connections, chrono::seconds duration)
+{
+	LatencyHistogram latency;
+	atomic<bool> failed(false);
+	atomic<uint64_t> games(0);
+	auto const deadline = chrono::steady_clock::now() + duration;
+
+	auto play = [&] (unsigned int index) {
+		int fd = connectTo(address);
+		if (fd < 0) {
+			failed = true;
+			return;
+		}
+		Client client(fd);
+		mt19937_64 rng(index);
+		string reply;
+
+		auto timed_request = [&] (string const& line) {
+			auto const start = chrono::steady_clock::now();
+			bool const ok = client.request(line, reply) && reply.compare(0, 2, "ok") == 0;
+			latency.record(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+				chrono::steady_clock::now() - start).count()));
+			if (!ok)
+				failed = true;
+			return ok;
+		};
+
+		while (!failed && chrono::steady_clock::now() < deadline) {
+			if (!timed_request("new"))
+				return;
+			auto const id = reply.substr(3);
+
+			// The server validates every move against its own copy of
+			// the game, which this one mirrors
+			GameController controller(make_unique<GameState>(), make_shared<QueenListener>());
+			while (controller.getPly() < max_plies &&
+			       controller.getState().getPhase() == Phase::RUNNING &&
+			       chrono::steady_clock::now() < deadline) {
+				auto const text = pickEvent(controller, rng);
+				if (text.empty())
+					break;
+				if (!timed_request("move " + id + ' ' + text))
+					return;
+				if (reply == "ok promotion" && !timed_request("promote " + id + " q"))
+					return;
+				auto const record = parseEvent(controller.getState(), text);
+				controller.update(makeEvent(*record));
+			}
+
+			if (!timed_request("close " + id))
+				return;
+			games.fetch_add(1, memory_order_relaxed);
+		}
+	};
+
+	auto const start = chrono::steady_clock::now();
+	vector<thread> threads;
+	for (unsigned int i = 0; i < connections; ++i)
+		threads.emplace_back(play, i);
+	for (auto& t : threads)
+		t.join();
+	auto const elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	cout << connections << " connections, " << games.load() << " games, "
+	     << latency.getCount() << " requests in " << fixed << setprecision(1)
+	     << elapsed << " s" << endl
+	     << setprecision(0) << latency.getCount() / elapsed << " req/s"
+	     << ", p50 " << latency.getPercentile(50.0) / 1000 << " us"
+	     << ", p99 " << latency.getPercentile(99.0) / 1000 << " us"
+	     << ", max " << latency.getMax() / 1000 << " us" << endl;
+
+	if (failed)
+		cerr << formatAddress(address) << ": a request failed" << endl;
+	return !failed;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <chrono>
+
+#include "net.h"
+
+// Play random games on a running server from several connections at
+// once, each sending one request at a time, and report requests per
+// second and round-trip latency
+// Returns true if every request succeeded
+bool runBench(Address const& address, unsigned int connections,
+              std::chrono::seconds duration);
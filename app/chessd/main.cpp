@@ -0,0 +1,110 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "bench.h"
+#include "net.h"
+#include "pool.h"
+#include "server.h"
+#include "session.h"
+
+using namespace std;
+
+// Print how to use the program
+static void print_usage(char const* program)
+{
+	cerr << "Usage: " << program << " [-u PATH | -p PORT] [-j THREADS] [-i SECONDS] [-J DIR]" << endl
+	     << "       " << program << " [-u PATH | -p PORT] -b [-c CONNECTIONS] [-d SECONDS]" << endl
+	     << endl
+	     << "Hosts games for clients connected to a Unix domain socket or to a" << endl
+	     << "TCP port on the loopback interface, one request per line:" << endl
+	     << endl
+	     << "  new                  create a game, replying with its ID" << endl
+	     << "  move ID EVENT        apply event in coordinate notation (e.g. e2e4)" << endl
+	     << "  promote ID PIECE     promote pawn moved without a piece type (q, r, b, n)" << endl
+	     << "  legal ID             list legal events" << endl
+	     << "  peek ID              get the latest position, without waiting for moves" << endl
+	     << "  save ID              get the game state, as saved, in one line" << endl
+	     << "  load ID STATE        replace the game state" << endl
+	     << "  close ID             end the game" << endl
+	     << "  stats                get number of requests, sessions and latency" << endl
+	     << endl
+	     << "Replies are \"ok ...\" or \"err REASON\", in the order of the requests." << endl
+	     << "With -b, plays random games against a running server instead." << endl
+	     << endl
+	     << "  -u PATH         Unix domain socket (default: chessd.sock)" << endl
+	     << "  -p PORT         TCP port on 127.0.0.1, instead of a socket file" << endl
+	     << "  -j THREADS      worker threads (default: one per core)" << endl
+	     << "  -i SECONDS      interval of the throughput report (default: 5, 0 for none)" << endl
+	     << "  -J DIR          keep a journal of each game in DIR, so that the games" << endl
+	     << "                  open when the server stops go on when it starts again" << endl
+	     << "  -b              run the load generator" << endl
+	     << "  -c CONNECTIONS  connections of the load generator (default: 16)" << endl
+	     << "  -d SECONDS      duration of the load (default: 10)" << endl;
+}
+
+int main(int argc, char** argv)
+{
+	Address address;
+	address.path = "chessd.sock";
+	unsigned int threads = 0;
+	unsigned long interval = 5;
+	string journal_dir;
+	bool benching = false;
+	unsigned int connections = 16;
+	unsigned long duration = 10;
+
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "-u" && i + 1 < argc) {
+			address.path = argv[++i];
+			address.port = 0;
+		} else if (arg == "-p" && i + 1 < argc) {
+			address.port = static_cast<uint16_t>(strtoul(argv[++i], nullptr, 10));
+			address.path.clear();
+		} else if (arg == "-j" && i + 1 < argc) {
+			threads = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		} else if (arg == "-i" && i + 1 < argc) {
+			interval = strtoul(argv[++i], nullptr, 10);
+		} else if (arg == "-J" && i + 1 < argc) {
+			journal_dir = argv[++i];
+		} else if (arg == "-b") {
+			benching = true;
+		} else if (arg == "-c" && i + 1 < argc) {
+			connections = max(1u, static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10)));
+		} else if (arg == "-d" && i + 1 < argc) {
+			duration = strtoul(argv[++i], nullptr, 10);
+		} else {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (benching)
+		return runBench(address, connections, chrono::seconds(duration)) ?
+			EXIT_SUCCESS : EXIT_FAILURE;
+
+	SessionTable sessions;
+	if (!journal_dir.empty() && !sessions.resume(journal_dir)) {
+		cerr << journal_dir << ": could not resume the games journaled there" << endl;
+		return EXIT_FAILURE;
+	}
+	auto pool = make_unique<WorkerPool>(threads);
+	Server server(sessions, *pool);
+	if (!server.listen(address)) {
+		cerr << formatAddress(address) << ": " << strerror(errno) << endl;
+		return EXIT_FAILURE;
+	}
+
+	cerr << "chessd: listening on " << formatAddress(address)
+	     << " with " << pool->size() << " workers" << endl;
+	server.run(&cerr, chrono::seconds(interval));
+
+	// Jobs left reply through the server, so they go first
+	pool.reset();
+	return EXIT_SUCCESS;
+}
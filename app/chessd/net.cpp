@@ -0,0 +1,122 @@
+#include "net.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+string formatAddress(Address const& address)
+{
+	if (!address.path.empty())
+		return address.path;
+	return "127.0.0.1:" + to_string(address.port);
+}
+
+bool setNonBlocking(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Fill socket address, returning its length (0 if the path is too long)
+static socklen_t makeAddress(Address const& address, sockaddr_storage& storage)
+{
+	memset(&storage, 0, sizeof(storage));
+	if (!address.path.empty()) {
+		auto& un = reinterpret_cast<sockaddr_un&>(storage);
+		if (address.path.size() >= sizeof(un.sun_path))
+			return 0;
+		un.sun_family = AF_UNIX;
+		memcpy(un.sun_path, address.path.c_str(), address.path.size() + 1);
+		return sizeof(un);
+	}
+	auto& in = reinterpret_cast<sockaddr_in&>(storage);
+	in.sin_family = AF_INET;
+	in.sin_port = htons(address.port);
+	in.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	return sizeof(in);
+}
+
+// Check whether the path of an address is a socket file nobody listens
+// on, as left behind by a previous run
+static bool isStaleSocket(Address const& address)
+{
+	struct stat st;
+	if (lstat(address.path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode))
+		return false;
+	int fd = connectTo(address);
+	if (fd >= 0) {
+		close(fd);
+		return false;
+	}
+	return errno == ECONNREFUSED;
+}
+
+int listenOn(Address const& address)
+{
+	sockaddr_storage storage;
+	auto const length = makeAddress(address, storage);
+	if (length == 0) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	if (address.path.empty()) {
+		int yes = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+	} else if (isStaleSocket(address)) {
+		// It would fail bind, while anything else there (such as a server
+		// still running) is left alone, and fails it
+		unlink(address.path.c_str());
+	}
+
+	if (bind(fd, reinterpret_cast<sockaddr*>(&storage), length) != 0 ||
+	    listen(fd, SOMAXCONN) != 0 || !setNonBlocking(fd)) {
+		int err = errno;
+		close(fd);
+		errno = err;
+		return -1;
+	}
+	return fd;
+}
+
+int connectTo(Address const& address)
+{
+	sockaddr_storage storage;
+	auto const length = makeAddress(address, storage);
+	if (length == 0) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, reinterpret_cast<sockaddr*>(&storage), length) != 0) {
+		int err = errno;
+		close(fd);
+		errno = err;
+		return -1;
+	}
+
+	// Requests are small and answered one at a time
+	if (address.path.empty()) {
+		int yes = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+	}
+	return fd;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Where the server listens: a Unix domain socket, if a path is given,
+// or else a TCP port on the loopback interface
+struct Address
+{
+	std::string path;
+	std::uint16_t port = 0;
+};
+
+// Get address as text, for messages
+std::string formatAddress(Address const& address);
+
+// Create non-blocking socket listening on the address
+// Returns the file descriptor, or -1 on error (with errno set)
+int listenOn(Address const& address);
+
+// Create blocking socket connected to the address
+// Returns the file descriptor, or -1 on error (with errno set)
+int connectTo(Address const& address);
+
+// Make file descriptor non-blocking
+// Returns true on success
+bool setNonBlocking(int fd);
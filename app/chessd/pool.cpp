@@ -0,0 +1,55 @@
+#include "pool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+WorkerPool::WorkerPool(unsigned int threads) :
+	m_stopping(false)
+{
+	if (threads == 0)
+		threads = max(1u, thread::hardware_concurrency());
+	for (unsigned int i = 0; i < threads; ++i)
+		m_threads.emplace_back(&WorkerPool::work, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_ready.notify_all();
+	for (auto& t : m_threads)
+		t.join();
+}
+
+void WorkerPool::submit(function<void()> task)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_tasks.push_back(move(task));
+	}
+	m_ready.notify_one();
+}
+
+unsigned int WorkerPool::size() const
+{
+	return static_cast<unsigned int>(m_threads.size());
+}
+
+void WorkerPool::work()
+{
+	while (true) {
+		function<void()> task;
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_ready.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+			if (m_tasks.empty())
+				return;
+			task = move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads that run tasks in the order they are submitted
+class WorkerPool
+{
+public:
+	// Start threads (0 for one per core)
+	explicit WorkerPool(unsigned int threads);
+
+	// Run the tasks left and join the threads
+	~WorkerPool();
+
+	WorkerPool(WorkerPool const&) = delete;
+	WorkerPool& operator=(WorkerPool const&) = delete;
+
+	// Queue task to be run by some thread
+	void submit(std::function<void()> task);
+
+	// Get number of threads
+	unsigned int size() const;
+private:
+	void work();
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	std::deque<std::function<void()>> m_tasks;
+	bool m_stopping;
+	std::vector<std::thread> m_threads;
+};
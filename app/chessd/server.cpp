@@ -0,0 +1,373 @@
+#include "server.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "pool.h"
+#include "session.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Tokens of epoll events that are not connections
+static const uint64_t listener_token = 0;
+static const uint64_t wakeup_token = 1;
+
+// Longest request line, beyond which the connection is dropped
+static const size_t max_line_size = 1 << 16;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void handleSignal(int)
+{
+	stopping = 1;
+}
+
+Server::Server(SessionTable& sessions, WorkerPool& pool) :
+	m_sessions(sessions),
+	m_pool(pool),
+	m_epoll(epoll_create1(EPOLL_CLOEXEC)),
+	m_listener(-1),
+	m_wakeup(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+	m_next_connection(wakeup_token + 1),
+	m_requests(0)
+{
+	epoll_event ev{};
+	ev.events = EPOLLIN;
+	ev.data.u64 = wakeup_token;
+	epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &ev);
+}
+
+Server::~Server()
+{
+	for (auto& [id, connection] : m_connections)
+		close(connection.fd);
+	if (m_listener >= 0) {
+		close(m_listener);
+		if (!m_address.path.empty())
+			unlink(m_address.path.c_str());
+	}
+	close(m_wakeup);
+	close(m_epoll);
+}
+
+bool Server::listen(Address const& address)
+{
+	m_listener = listenOn(address);
+	if (m_listener < 0)
+		return false;
+	m_address = address;
+	epoll_event ev{};
+	ev.events = EPOLLIN;
+	ev.data.u64 = listener_token;
+	return epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_listener, &ev) == 0;
+}
+
+void Server::run(ostream* log, chrono::seconds interval)
+{
+	struct sigaction action{};
+	action.sa_handler = handleSignal;
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+	signal(SIGPIPE, SIG_IGN);
+
+	epoll_event events[256];
+	auto last_report = chrono::steady_clock::now();
+
+	while (!stopping) {
+		int timeout = -1;
+		if (log && interval.count() > 0) {
+			auto const left = chrono::duration_cast<chrono::milliseconds>(
+				last_report + interval - chrono::steady_clock::now());
+			timeout = static_cast<int>(max<int64_t>(0, left.count()));
+		}
+
+		int cnt = epoll_wait(m_epoll, events, static_cast<int>(size(events)), timeout);
+		if (cnt < 0 && errno != EINTR)
+			break;
+
+		for (int i = 0; i < cnt; ++i) {
+			auto const token = events[i].data.u64;
+			if (token == listener_token) {
+				accept();
+			} else if (token == wakeup_token) {
+				uint64_t value;
+				while (::read(m_wakeup, &value, sizeof(value)) > 0) {}
+				flushCompleted();
+			} else {
+				auto it = m_connections.find(token);
+				if (it == m_connections.end())
+					continue;
+				if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+					closeConnection(token);
+					continue;
+				}
+				if ((events[i].events & EPOLLOUT) && !flush(token, it->second))
+					continue;
+				if (events[i].events & EPOLLIN)
+					read(token, it->second);
+			}
+		}
+
+		auto const now = chrono::steady_clock::now();
+		if (log && interval.count() > 0 && now - last_report >= interval) {
+			report(*log, chrono::duration<double>(now - last_report).count());
+			last_report = now;
+		}
+	}
+}
+
+void Server::accept()
+{
+	while (true) {
+		int fd = accept4(m_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+		auto const id = m_next_connection++;
+		epoll_event ev{};
+		ev.events = EPOLLIN;
+		ev.data.u64 = id;
+		if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) != 0) {
+			close(fd);
+			continue;
+		}
+		m_connections.emplace(id, Connection{ fd, {}, {}, {}, EPOLLIN, false });
+	}
+}
+
+void Server::read(uint64_t id, Connection& connection)
+{
+	char buffer[1 << 14];
+	while (true) {
+		auto const n = ::read(connection.fd, buffer, sizeof(buffer));
+		if (n < 0 && errno != EAGAIN && errno != EINTR) {
+			closeConnection(id);
+			return;
+		}
+		// The requests sent before the client stopped sending are still
+		// answered, and the connection closed once they are
+		if (n == 0) {
+			connection.ending = true;
+			break;
+		}
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		connection.input.append(buffer, static_cast<size_t>(n));
+	}
+
+	size_t begin = 0;
+	while (true) {
+		auto const end = connection.input.find('\n', begin);
+		if (end == string::npos)
+			break;
+		auto line = connection.input.substr(begin, end - begin);
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		begin = end + 1;
+		if (!line.empty())
+			dispatch(id, connection, line);
+	}
+	connection.input.erase(0, begin);
+
+	if (connection.input.size() > max_line_size) {
+		closeConnection(id);
+		return;
+	}
+	flush(id, connection);
+}
+
+void Server::dispatch(uint64_t id, Connection& connection, string const& line)
+{
+	auto reply = make_shared<Reply>();
+	reply->start = chrono::steady_clock::now();
+	connection.replies.push_back(reply);
+
+	istringstream ss(line);
+	string command;
+	ss >> command;
+
+	if (command == "new") {
+		auto const session = m_sessions.create();
+		complete(id, *reply, session ? "ok " + to_string(session->getId()) :
+		                               "err could not journal game");
+		return;
+	}
+
+	if (command == "stats") {
+		ostringstream os;
+		os << "ok requests " << m_requests.load(memory_order_relaxed)
+		   << " sessions " << m_sessions.size()
+		   << " p50_us " << m_latency.getPercentile(50.0) / 1000
+		   << " p99_us " << m_latency.getPercentile(99.0) / 1000;
+		complete(id, *reply, os.str());
+		return;
+	}
+
+	uint64_t session_id;
+	if (!(ss >> session_id)) {
+		complete(id, *reply, "err invalid request");
+		return;
+	}
+
+	if (command == "close") {
+		complete(id, *reply, m_sessions.erase(session_id) ? "ok" : "err unknown game");
+		return;
+	}
+
+	if (command == "peek") {
+		// Spectators read the latest snapshot without queueing
+		// behind the moves of the game
+		auto const session = m_sessions.find(session_id);
+		complete(id, *reply, session ? session->peek() : "err unknown game");
+		return;
+	}
+
+	string argument;
+	ss >> ws;
+	getline(ss, argument);
+
+	function<string(Session&)> request;
+	if (command == "move")
+		request = [argument] (Session& s) { return s.move(argument); };
+	else if (command == "promote")
+		request = [argument] (Session& s) { return s.promote(argument); };
+	else if (command == "legal")
+		request = [] (Session& s) { return s.legal(); };
+	else if (command == "save")
+		request = [] (Session& s) { return s.save(); };
+	else if (command == "load")
+		request = [argument] (Session& s) { return s.load(argument); };
+
+	if (!request) {
+		complete(id, *reply, "err unknown command");
+		return;
+	}
+
+	auto const session = m_sessions.find(session_id);
+	if (!session) {
+		complete(id, *reply, "err unknown game");
+		return;
+	}
+
+	session->post(m_pool, [this, id, reply, request] (Session& s) {
+		complete(id, *reply, request(s));
+	});
+}
+
+void Server::complete(uint64_t id, Reply& reply, string text)
+{
+	auto const elapsed = chrono::steady_clock::now() - reply.start;
+	auto const ns = static_cast<uint64_t>(
+		chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+	m_latency.record(ns);
+	m_interval_latency.record(ns);
+	m_requests.fetch_add(1, memory_order_relaxed);
+
+	reply.text = move(text);
+	reply.text += '\n';
+	reply.done.store(true, memory_order_release);
+
+	bool wake;
+	{
+		lock_guard<mutex> lock(m_completed_mutex);
+		wake = m_completed.empty();
+		m_completed.push_back(id);
+	}
+	// One wake-up is enough for all replies completed until the event
+	// loop takes the list
+	if (wake) {
+		uint64_t one = 1;
+		auto n = write(m_wakeup, &one, sizeof(one));
+		(void) n;
+	}
+}
+
+void Server::flushCompleted()
+{
+	vector<uint64_t> completed;
+	{
+		lock_guard<mutex> lock(m_completed_mutex);
+		completed.swap(m_completed);
+	}
+	for (auto id : completed) {
+		auto it = m_connections.find(id);
+		if (it != m_connections.end())
+			flush(id, it->second);
+	}
+}
+
+bool Server::flush(uint64_t id, Connection& connection)
+{
+	auto& replies = connection.replies;
+	while (!replies.empty() && replies.front()->done.load(memory_order_acquire)) {
+		connection.output += replies.front()->text;
+		replies.pop_front();
+	}
+
+	while (!connection.output.empty()) {
+		auto const n = send(connection.fd, connection.output.data(),
+		                    connection.output.size(), MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				break;
+			closeConnection(id);
+			return false;
+		}
+		connection.output.erase(0, static_cast<size_t>(n));
+	}
+
+	if (connection.ending && replies.empty() && connection.output.empty()) {
+		closeConnection(id);
+		return false;
+	}
+
+	// Only wait for the socket to be writable while there is a backlog,
+	// and for requests until the client sent them all
+	uint32_t const events =
+		(connection.ending ? 0 : static_cast<uint32_t>(EPOLLIN)) |
+		(connection.output.empty() ? 0 : static_cast<uint32_t>(EPOLLOUT));
+	if (events != connection.events) {
+		epoll_event ev{};
+		ev.events = events;
+		ev.data.u64 = id;
+		epoll_ctl(m_epoll, EPOLL_CTL_MOD, connection.fd, &ev);
+		connection.events = events;
+	}
+	return true;
+}
+
+void Server::closeConnection(uint64_t id)
+{
+	auto it = m_connections.find(id);
+	if (it == m_connections.end())
+		return;
+	// Replies still being worked on are kept alive by their jobs
+	close(it->second.fd);
+	m_connections.erase(it);
+}
+
+void Server::report(ostream& log, double seconds)
+{
+	auto const count = m_interval_latency.getCount();
+	log << "chessd: " << fixed << setprecision(0) << count / seconds << " req/s"
+	    << ", p50 " << m_interval_latency.getPercentile(50.0) / 1000 << " us"
+	    << ", p99 " << m_interval_latency.getPercentile(99.0) / 1000 << " us"
+	    << ", " << m_sessions.size() << " sessions"
+	    << ", " << m_connections.size() << " connections" << endl;
+	// Requests finishing right now may be counted in either interval
+	m_interval_latency.reset();
+}
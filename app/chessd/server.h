@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "latency.h"
+#include "net.h"
+
+class SessionTable;
+class WorkerPool;
+
+// Event loop of the server. One thread waits on epoll for connections
+// and requests, one per line, and hands them to the worker pool. Replies
+// come back through an eventfd and are written in the order in which
+// the requests of each connection arrived.
+//
+// Requests, with the replies sent back ("ok ..." or "err REASON"):
+//   new                  ok ID
+//   move ID EVENT        ok PHASE (EVENT in coordinate notation), or
+//                        ok promotion if a pawn waits to be promoted
+//   promote ID PIECE     ok PHASE (PIECE is q, r, b or n)
+//   legal ID             ok EVENT...
+//   peek ID              ok ply N turn COLOUR phase PHASE board PIECES
+//                        (64 letters from a1 to h8, upper case for white),
+//                        answered at once from the latest snapshot
+//   save ID              ok STATE (game state, as saved, in one line)
+//   load ID STATE        ok PHASE
+//   close ID             ok
+//   stats                ok requests N sessions N p50_us N p99_us N
+class Server
+{
+public:
+	Server(SessionTable& sessions, WorkerPool& pool);
+
+	// Close every connection
+	~Server();
+
+	Server(Server const&) = delete;
+	Server& operator=(Server const&) = delete;
+
+	// Listen on address
+	// Returns true on success
+	bool listen(Address const& address);
+
+	// Serve requests until asked to stop (by SIGINT or SIGTERM), reporting
+	// requests per second and latency to the log every interval (if any)
+	void run(std::ostream* log, std::chrono::seconds interval);
+private:
+	// A reply that a worker may still be working on
+	struct Reply
+	{
+		std::string text;
+		std::atomic<bool> done{ false };
+		std::chrono::steady_clock::time_point start;
+	};
+
+	struct Connection
+	{
+		int fd;
+		std::string input;
+		std::deque<std::shared_ptr<Reply>> replies;
+		std::string output;
+		std::uint32_t events; // waited for with epoll
+		bool ending; // the client sent all its requests
+	};
+
+	void accept();
+	void read(std::uint64_t id, Connection& connection);
+	void dispatch(std::uint64_t id, Connection& connection, std::string const& line);
+	void complete(std::uint64_t id, Reply& reply, std::string text);
+	void flushCompleted();
+	bool flush(std::uint64_t id, Connection& connection);
+	void closeConnection(std::uint64_t id);
+	void report(std::ostream& log, double seconds);
+private:
+	SessionTable& m_sessions;
+	WorkerPool& m_pool;
+	Address m_address;
+	int m_epoll;
+	int m_listener;
+	int m_wakeup; // eventfd signalled by workers
+	std::uint64_t m_next_connection;
+	std::unordered_map<std::uint64_t, Connection> m_connections;
+
+	std::mutex m_completed_mutex; // guards the field below
+	std::vector<std::uint64_t> m_completed; // connections with replies
+
+	std::atomic<std::uint64_t> m_requests;
+	chesslib::LatencyHistogram m_latency;
+	chesslib::LatencyHistogram m_interval_latency;
+};
@@ -0,0 +1,306 @@
+#include "session.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+#include "history.h"
+#include "listener.h"
+#include "notation.h"
+#include "pool.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+namespace fs = std::filesystem;
+
+// Number of jobs a worker runs for a session before letting the
+// jobs of other sessions, queued in the pool meanwhile, have their turn
+static const int jobs_per_turn = 16;
+
+// Promotions are given as requests of their own, and errors are sent
+// back as replies, so there is nothing to listen to
+class SessionListener : public GameListener
+{
+public:
+	PieceTypeId promotePawn(GameController const& gameController,
+	                        Square pawn) override
+	{
+		return PieceTypeId::QUEEN;
+	}
+
+	void catchError(GameController const& gameController,
+	                GameError err) override {}
+};
+
+// Get name of game phase, as sent to clients
+static char const* getPhaseName(Phase phase)
+{
+	switch (phase) {
+	case Phase::RUNNING:
+		return "running";
+	case Phase::WHITE_WON:
+		return "white_won";
+	case Phase::BLACK_WON:
+		return "black_won";
+	case Phase::DRAW:
+		return "draw";
+	default:
+		return "unknown";
+	}
+}
+
+// Extension of the journal files, named after the identifier of the game
+static char const journal_extension[] = ".journal";
+
+Session::Session(uint64_t id, shared_ptr<GameJournal> journal) :
+	m_id(id),
+	m_controller(make_unique<GameState>(), make_shared<SessionListener>()),
+	m_snapshots(make_shared<SnapshotPublisher>()),
+	m_journal(std::move(journal)),
+	m_running(false)
+{
+	m_controller.addObserver(m_snapshots);
+	if (!m_journal)
+		return;
+
+	// The journal goes on from its last ply, as the game stands there
+	GameState last;
+	if (m_journal->seek(m_journal->getPlyCount(), last)) {
+		stringstream ss;
+		last.save(ss);
+		m_controller.load(ss);
+	}
+	m_controller.addObserver(m_journal);
+}
+
+uint64_t Session::getId() const
+{
+	return m_id;
+}
+
+void Session::post(WorkerPool& pool, Job job)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+		if (m_running)
+			return;
+		m_running = true;
+	}
+	pool.submit([self = shared_from_this(), &pool] { self->run(pool); });
+}
+
+void Session::run(WorkerPool& pool)
+{
+	for (int i = 0; i < jobs_per_turn; ++i) {
+		Job job;
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (m_jobs.empty()) {
+				m_running = false;
+				return;
+			}
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		job(*this);
+	}
+	// Still running, so nobody else submits the session meanwhile
+	pool.submit([self = shared_from_this(), &pool] { self->run(pool); });
+}
+
+string Session::peek() const
+{
+	// Letters of pieces by type, in lower case for black
+	static char const piece_letters[] = ".pkqbnr";
+
+	auto const snapshot = m_snapshots->read();
+	string board(SQ_CNT, '.');
+	for (Square sq = SQ_A1; sq < SQ_CNT; ++sq) {
+		auto const piece = unpackPiece(snapshot.pieces[sq]);
+		auto const letter = piece_letters[static_cast<int>(piece.getType()->getId())];
+		board[sq] = piece.getColour() == Colour::WHITE ? static_cast<char>(toupper(letter)) : letter;
+	}
+	return "ok ply " + to_string(snapshot.ply) +
+	       " turn " + (snapshot.turn == Colour::WHITE ? "white" : "black") +
+	       " phase " + getPhaseName(snapshot.phase) +
+	       " board " + board;
+}
+
+string Session::move(string const& text)
+{
+	auto const record = parseEvent(m_controller.getState(), text);
+	if (!record)
+		return "err invalid move";
+	auto const event = makeEvent(*record);
+	if (!event)
+		return "err invalid move";
+
+	auto status = m_controller.updateAsync(event);
+	if (status == UpdateStatus::PENDING && record->promotion != PieceTypeId::NONE)
+		status = m_controller.resumeUpdate(record->promotion);
+
+	switch (status) {
+	case UpdateStatus::APPLIED:
+		return string("ok ") + getPhaseName(m_controller.getState().getPhase());
+	case UpdateStatus::PENDING:
+		return "ok promotion";
+	default:
+		return m_controller.isUpdatePending() ? "err promotion pending" : "err illegal move";
+	}
+}
+
+string Session::promote(string const& text)
+{
+	auto const promotion = parsePromotion(text);
+	if (!promotion)
+		return "err invalid promotion";
+	if (m_controller.resumeUpdate(*promotion) != UpdateStatus::APPLIED)
+		return "err no promotion pending";
+	return string("ok ") + getPhaseName(m_controller.getState().getPhase());
+}
+
+string Session::legal() const
+{
+	vector<EventRecord> events;
+	if (m_controller.getState().getPhase() == Phase::RUNNING)
+		getLegalEvents(m_controller.getLegalMoves(), events);
+	string reply = "ok";
+	for (auto const& record : events) {
+		reply += ' ';
+		reply += formatEvent(record);
+	}
+	return reply;
+}
+
+string Session::save() const
+{
+	// The position is half-way through the event until the pawn is promoted
+	if (m_controller.isUpdatePending())
+		return "err promotion pending";
+
+	ostringstream ss;
+	m_controller.save(ss);
+	auto text = ss.str();
+	for (auto& c : text)
+		if (c == '\n')
+			c = ' ';
+	return "ok " + text;
+}
+
+string Session::load(string const& text)
+{
+	istringstream ss(text);
+	if (!m_controller.load(ss))
+		return "err invalid state";
+	return string("ok ") + getPhaseName(m_controller.getState().getPhase());
+}
+
+SessionTable::SessionTable() :
+	m_next_id(1),
+	m_size(0)
+{}
+
+bool SessionTable::resume(fs::path const& directory)
+{
+	error_code ec;
+	fs::create_directories(directory, ec);
+	if (ec)
+		return false;
+	m_directory = directory;
+
+	for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+		auto const& path = it->path();
+		if (path.extension() != journal_extension)
+			continue;
+		auto const stem = path.stem().string();
+		char* stem_end;
+		auto const id = strtoull(stem.c_str(), &stem_end, 10);
+		if (stem.empty() || *stem_end != '\0' || id == 0)
+			continue;
+		auto journal = make_shared<GameJournal>();
+		if (!journal->open(path))
+			return false;
+		insert(make_shared<Session>(id, std::move(journal)));
+		if (id >= m_next_id.load(memory_order_relaxed))
+			m_next_id.store(id + 1, memory_order_relaxed);
+	}
+	return !ec;
+}
+
+shared_ptr<Session> SessionTable::create()
+{
+	auto const id = m_next_id.fetch_add(1, memory_order_relaxed);
+	shared_ptr<GameJournal> journal;
+	if (!m_directory.empty()) {
+		journal = make_shared<GameJournal>();
+		if (!journal->open(getJournalPath(id)))
+			return nullptr;
+	}
+	auto session = make_shared<Session>(id, std::move(journal));
+	insert(session);
+	return session;
+}
+
+shared_ptr<Session> SessionTable::find(uint64_t id) const
+{
+	auto const& shard = getShard(id);
+	lock_guard<mutex> lock(shard.mutex);
+	auto it = shard.sessions.find(id);
+	return it == shard.sessions.end() ? nullptr : it->second;
+}
+
+bool SessionTable::erase(uint64_t id)
+{
+	auto& shard = getShard(id);
+	shared_ptr<Session> session; // destroyed outside the lock
+	{
+		lock_guard<mutex> lock(shard.mutex);
+		auto it = shard.sessions.find(id);
+		if (it == shard.sessions.end())
+			return false;
+		session = std::move(it->second);
+		shard.sessions.erase(it);
+	}
+	m_size.fetch_sub(1, memory_order_relaxed);
+
+	// A game that was closed is not resumed
+	if (!m_directory.empty()) {
+		error_code ec;
+		fs::remove(getJournalPath(id), ec);
+	}
+	return true;
+}
+
+size_t SessionTable::size() const
+{
+	return m_size.load(memory_order_relaxed);
+}
+
+SessionTable::Shard& SessionTable::getShard(uint64_t id)
+{
+	return m_shards[id % shard_cnt];
+}
+
+SessionTable::Shard const& SessionTable::getShard(uint64_t id) const
+{
+	return m_shards[id % shard_cnt];
+}
+
+void SessionTable::insert(shared_ptr<Session> session)
+{
+	auto const id = session->getId();
+	auto& shard = getShard(id);
+	{
+		lock_guard<mutex> lock(shard.mutex);
+		shard.sessions.emplace(id, std::move(session));
+	}
+	m_size.fetch_add(1, memory_order_relaxed);
+}
+
+fs::path SessionTable::getJournalPath(uint64_t id) const
+{
+	return m_directory / (to_string(id) + journal_extension);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "controller.h"
+#include "journal.h"
+#include "snapshot.h"
+
+class WorkerPool;
+
+// A game hosted by the server. Requests about the game are posted as
+// jobs, which run on the worker pool one after the other, so that the
+// controller is only ever used by one thread at a time without any
+// thread waiting for another: a job posted while others are queued is
+// simply left for whichever worker is already running them.
+class Session : public std::enable_shared_from_this<Session>
+{
+public:
+	using Job = std::function<void(Session&)>;
+
+	// The game goes on where the journal (if any) ends, and is journaled
+	explicit Session(std::uint64_t id,
+	                 std::shared_ptr<chesslib::GameJournal> journal = nullptr);
+
+	// Get identifier of the session
+	std::uint64_t getId() const;
+
+	// Run job after the jobs posted before it
+	void post(WorkerPool& pool, Job job);
+
+	// Describe the latest position of the game, from any thread, without
+	// waiting for the jobs of the session
+	std::string peek() const;
+
+	// The requests below return the reply to be sent, and may only be
+	// called from a job
+
+	// Apply event in coordinate notation, such as "e2e4" or "e7e8q"
+	// A pawn moved to the last rank without a piece type is left there
+	// until promote is called, with nobody waiting meanwhile
+	std::string move(std::string const& text);
+
+	// Promote pawn left on the last rank by move, to the piece type of
+	// given letter ("q", "r", "b" or "n")
+	std::string promote(std::string const& text);
+
+	// List legal events
+	std::string legal() const;
+
+	// Save game state, in a single line
+	std::string save() const;
+
+	// Load game state, as saved
+	std::string load(std::string const& text);
+private:
+	// Run queued jobs until there are none left
+	void run(WorkerPool& pool);
+private:
+	std::uint64_t m_id;
+	chesslib::GameController m_controller;
+	std::shared_ptr<chesslib::SnapshotPublisher> m_snapshots;
+	std::shared_ptr<chesslib::GameJournal> m_journal;
+
+	std::mutex m_mutex; // guards the fields below
+	std::deque<Job> m_jobs;
+	bool m_running;
+};
+
+// Sessions by identifier, split in shards that are locked separately,
+// so that looking up a session does not contend with looking up others
+class SessionTable
+{
+public:
+	SessionTable();
+
+	// Keep a journal of every game in directory (created if need be),
+	// and resume the games journaled there
+	// Returns true on success
+	bool resume(std::filesystem::path const& directory);
+
+	// Create session with a new identifier (nullptr if its journal
+	// could not be created)
+	std::shared_ptr<Session> create();
+
+	// Find session (nullptr if there is none)
+	std::shared_ptr<Session> find(std::uint64_t id) const;
+
+	// Remove session, which is destroyed once its last job is done,
+	// along with its journal
+	// Returns true if there was one
+	bool erase(std::uint64_t id);
+
+	// Get number of sessions
+	std::size_t size() const;
+private:
+	struct Shard
+	{
+		mutable std::mutex mutex;
+		std::unordered_map<std::uint64_t, std::shared_ptr<Session>> sessions;
+	};
+
+	static constexpr std::size_t shard_cnt = 64;
+
+	Shard& getShard(std::uint64_t id);
+	Shard const& getShard(std::uint64_t id) const;
+
+	// Add session
+	void insert(std::shared_ptr<Session> session);
+
+	// Get path of the journal of a session
+	std::filesystem::path getJournalPath(std::uint64_t id) const;
+private:
+	std::array<Shard, shard_cnt> m_shards;
+	std::filesystem::path m_directory; // of journals (empty for none)
+	std::atomic<std::uint64_t> m_next_id;
+	std::atomic<std::size_t> m_size;
+};
@@ -4,6 +4,9 @@
 #include <fstream>
 #include <filesystem>
 #include <map>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "state.h"
 #include "listener.h"
@@ -12,6 +15,7 @@
 #include "event.h"
 #include "error.h"
 #include "board.h"
+#include "notation.h"
 
 namespace fs = std::filesystem;
 
@@ -40,8 +44,11 @@ template<typename T> map_init_helper<T> map_init(T& item)
 // Maps error values to error messages
 static map<GameError, string> error_message_map;
 
+// Maps draw reasons to their names
+static map<DrawReason, string> draw_reason_name_map;
+
 // Print game error
-void print_error(GameError error);
+void print_error(GameError error, ostream& os = cout);
 
 // Implements GameListener, using the stdout to interact with the user
 class CmdGameListener : public GameListener
@@ -50,6 +57,17 @@ class CmdGameListener : public GameListener
 	void catchError(GameController const& game, GameError error) override;
 };
 
+// Implements GameListener for scripted games, which never ask the user:
+// promotions come along with the moves, and errors are kept for later
+class BatchGameListener : public GameListener
+{
+public:
+	optional<GameError> error;
+
+	PieceTypeId promotePawn(GameController const& game, Square pawn) override;
+	void catchError(GameController const& game, GameError error) override;
+};
+
 // Print whose turn is it in a game state
 void print_turn(GameState const& game)
 {
@@ -279,13 +297,13 @@ PieceTypeId CmdGameListener::promotePawn(GameController const& game, Square pawn
 		return PieceTypeId::QUEEN;
 }
 
-void print_error(GameError error)
+void print_error(GameError error, ostream& os)
 {
 	auto error_message = error_message_map.find(error);
 	if (error_message == error_message_map.end())
-		cout << "Caught unknown error" << endl;
+		os << "Caught unknown error" << endl;
 	else
-		cout << "Error: " << error_message->second << endl;
+		os << "Error: " << error_message->second << endl;
 }
 
 void CmdGameListener::catchError(GameController const& game, GameError error)
@@ -293,6 +311,16 @@ void CmdGameListener::catchError(GameController const& game, GameError error)
 	print_error(error);
 }
 
+PieceTypeId BatchGameListener::promotePawn(GameController const& game, Square pawn)
+{
+	return PieceTypeId::QUEEN;
+}
+
+void BatchGameListener::catchError(GameController const& game, GameError error)
+{
+	this->error = error;
+}
+
 int play(int argc, char** argv)
 {
 	auto gc = GameController(make_unique<GameState>(),
@@ -308,6 +336,8 @@ int play(int argc, char** argv)
 			cout << "Choose an action:" << endl;
 			cout << "[0] Move" << endl;
 			cout << "[1] Castling" << endl;
+			cout << "[2] Undo" << endl;
+			cout << "[3] Redo" << endl;
 			cout << "[8] Load" << endl;
 			cout << "[9] Save" << endl;
 			cout << ">>> ";
@@ -332,6 +362,16 @@ int play(int argc, char** argv)
 				} else {
 					cout << "Illegal input" << endl;
 				}
+			} else if (opt == 2) {
+				if (gc.undo())
+					break;
+				else
+					cout << "Nothing to undo" << endl;
+			} else if (opt == 3) {
+				if (gc.redo())
+					break;
+				else
+					cout << "Nothing to redo" << endl;
 			} else if (opt == 8) {
 				if (load_game(gc))
 					break;
@@ -347,10 +387,149 @@ end:
 		cout << "White won!" << endl;
 	else if (phase == Phase::BLACK_WON)
 		cout << "Black won!" << endl;
+	else if (phase == Phase::DRAW)
+		cout << "Draw by " << draw_reason_name_map[g.getDrawReason()]
+		     << "!" << endl;
 
 	return 0;
 }
 
+// Print how to use the program in batch mode
+void print_usage(char const* program)
+{
+	cerr << "Usage: " << program << " [-l STATE] [-s] FILE..." << endl
+	     << endl
+	     << "Applies the move list of each FILE (- for the standard input) to a" << endl
+	     << "new game and prints its result, one line per file. Moves are written" << endl
+	     << "in coordinate notation (e2e4, e7e8q, e1h1), and pawns are promoted to" << endl
+	     << "queens unless the move says otherwise. Without arguments, the game is" << endl
+	     << "played interactively." << endl
+	     << endl
+	     << "  -l STATE  start every game from a saved game state" << endl
+	     << "  -s        print the final game state instead of the result" << endl;
+}
+
+// Get result of a game, in a few words
+string get_result(GameState const& g)
+{
+	switch (g.getPhase()) {
+	case Phase::WHITE_WON:
+		return "white won";
+	case Phase::BLACK_WON:
+		return "black won";
+	case Phase::DRAW:
+		return "draw by " + draw_reason_name_map[g.getDrawReason()];
+	default:
+		return "running";
+	}
+}
+
+// Apply move list to the game, reporting the first event that cannot be
+// applied to the standard error
+// Returns true on success
+bool apply_move_list(GameController& gc, istream& is, string const& name)
+{
+	for (auto const& text : readMoveList(is)) {
+		auto const record = parseEvent(gc.getState(), text);
+		auto status = record ? gc.updateAsync(makeEvent(*record)) : UpdateStatus::REJECTED;
+		if (status == UpdateStatus::PENDING) {
+			auto const promotion = record->promotion == PieceTypeId::NONE ?
+				PieceTypeId::QUEEN : record->promotion;
+			status = gc.resumeUpdate(promotion);
+			if (status != UpdateStatus::APPLIED)
+				gc.undo();
+		}
+		if (status != UpdateStatus::APPLIED) {
+			cerr << name << ": illegal event " << text
+			     << " at ply " << gc.getPly() + 1 << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Play the move lists given in the arguments, without prompting, and print
+// only the outcome of each game, in one buffered write at the end
+int run_batch(int argc, char** argv)
+{
+	string state_path;
+	bool print_state = false;
+	vector<string> paths;
+
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "-l" && i + 1 < argc) {
+			state_path = argv[++i];
+		} else if (arg == "-s") {
+			print_state = true;
+		} else if (arg == "-" || arg[0] != '-') {
+			paths.push_back(arg);
+		} else {
+			print_usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (paths.empty()) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	auto listener = make_shared<BatchGameListener>();
+	GameController initial(make_unique<GameState>(), listener);
+	if (!state_path.empty()) {
+		ifstream fs(state_path);
+		if (!fs || !initial.load(fs)) {
+			cerr << state_path << ": ";
+			if (listener->error)
+				print_error(*listener->error, cerr);
+			else
+				cerr << "could not open file" << endl;
+			return 1;
+		}
+		// Nothing may follow the state, or a state cut short before its
+		// halfmove clock (which older states lack) would go unnoticed
+		if (!(fs >> ws).eof()) {
+			cerr << state_path << ": unexpected text after the game state" << endl;
+			return 1;
+		}
+	}
+
+	// Nothing is shared with C stdio, and the output is only written
+	// once every game has been played
+	ios::sync_with_stdio(false);
+	cin.tie(nullptr);
+	ostringstream out;
+
+	int status = 0;
+	for (auto const& path : paths) {
+		auto gc = initial;
+		bool applied;
+		if (path == "-") {
+			applied = apply_move_list(gc, cin, "stdin");
+		} else {
+			ifstream fs(path);
+			if (!fs) {
+				cerr << path << ": could not open file" << endl;
+				status = 1;
+				break;
+			}
+			applied = apply_move_list(gc, fs, path);
+		}
+		if (!applied) {
+			status = 1;
+			break;
+		}
+		if (print_state && gc.save(out))
+			out << '\n';
+		else if (!print_state)
+			out << get_result(gc.getState()) << '\n';
+	}
+
+	cout << out.str();
+	return status;
+}
+
 int create_game_state(int argc, char** argv)
 {
 	auto g = GameState();
@@ -393,9 +572,8 @@ int create_game_state(int argc, char** argv)
 					cout << "Illegal colour!" << endl;
 					continue;
 				}
-				auto& board_piece = g.getPieceAt(*sq_opt);
-				board_piece.setType(*piece_type_id_opt);
-			    board_piece.setColour(*colour_opt);
+				g.setPiece(*sq_opt, Piece(getPieceTypeById(*piece_type_id_opt),
+				                          *colour_opt));
 				g.clearEnPassantPawn();
 			} else {
 				cout << "Illegal square!" << endl;
@@ -432,13 +610,26 @@ void init_error_message_map()
 		(GameError::IO_EN_PASSANT, "Illegal en passant")
 		(GameError::IO_PIECE_TYPE, "Illegal piece type")
 		(GameError::IO_SQUARE, "Illegal square")
+		(GameError::IO_TRUNCATED, "Truncated state")
 		(GameError::IO_TURN, "Illegal turn")
 		(GameError::IO_VERSION, "Illegal version");
 }
 
+void init_draw_reason_name_map()
+{
+	map_init(draw_reason_name_map)
+		(DrawReason::STALEMATE, "stalemate")
+		(DrawReason::FIFTY_MOVE_RULE, "the fifty-move rule")
+		(DrawReason::REPETITION, "repetition");
+}
+
 int main(int argc, char** argv)
 {
 	init_error_message_map();
+	init_draw_reason_name_map();
+
+	if (argc > 1)
+		return run_batch(argc, argv);
 
 	int opt;
 	cout << "Choose a subprogram:" << endl;
@@ -0,0 +1,99 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "error.h"
+#include "mate.h"
+#include "notation.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Print how to use the program
+static void print_usage(char const* program)
+{
+	cerr << "Usage: " << program << " [-n MOVES] [-c] [-H MB] [-N NODES] SAVE..." << endl
+	     << endl
+	     << "Looks for a forced mate by the player to move in each saved game" << endl
+	     << "state, and prints the shortest one against the longest defence," << endl
+	     << "or proves that there is none within the given number of moves." << endl
+	     << endl
+	     << "  -n MOVES  longest mate looked for, in moves (default: 5)" << endl
+	     << "  -c        only try events of the attacker that give check" << endl
+	     << "  -H MB     size of the proof table (default: 16)" << endl
+	     << "  -N NODES  positions visited per state before giving up" << endl
+	     << "            (default: no limit)" << endl;
+}
+
+// Print what the solver found in a saved game state
+static bool solve(MateSolver& solver, string const& path, unsigned int moves)
+{
+	ifstream fs(path);
+	GameState state;
+	try {
+		state.load(fs);
+	} catch (GameError) {
+		cerr << path << ": could not load game state" << endl;
+		return false;
+	}
+
+	auto const result = solver.solve(state, moves);
+	cout << path << ": ";
+	switch (result.outcome) {
+	case MateOutcome::MATE:
+		cout << "mate in " << (result.line.size() + 1) / 2 << ":";
+		for (auto const& record : result.line)
+			cout << " " << formatEvent(record);
+		break;
+	case MateOutcome::NO_MATE:
+		cout << "no mate in " << moves;
+		break;
+	default:
+		cout << "unknown";
+		break;
+	}
+	cout << " (" << result.nodes << " nodes)" << endl;
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int moves = 5;
+	MateOptions options;
+	vector<string> paths;
+
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc) {
+			moves = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		} else if (arg == "-c") {
+			options.checks_only = true;
+		} else if (arg == "-H" && i + 1 < argc) {
+			options.table_megabytes = strtoul(argv[++i], nullptr, 10);
+		} else if (arg == "-N" && i + 1 < argc) {
+			options.nodes = strtoull(argv[++i], nullptr, 10);
+		} else if (arg.size() > 1 && arg[0] == '-') {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		} else {
+			paths.push_back(arg);
+		}
+	}
+
+	if (paths.empty() || moves == 0 || moves > max_mate_moves) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// The table is kept from one state to the next, as puzzles often
+	// share positions
+	MateSolver solver(options);
+	bool ok = true;
+	for (auto const& path : paths)
+		ok = solve(solver, path, moves) && ok;
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
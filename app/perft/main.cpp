@@ -0,0 +1,142 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "notation.h"
+#include "perft.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Print how to use the program
+static void print_usage(char const* program)
+{
+	cerr << "Usage: " << program << " [-l SAVE] [-j THREADS] [-s SPLIT] [-H MB] [-d] [-b] DEPTH" << endl
+	     << endl
+	     << "Counts the leaves of the game tree of given depth, to validate" << endl
+	     << "move generation, with the first plies split over several threads." << endl
+	     << endl
+	     << "  -l SAVE     start from a saved game state (default: initial position)" << endl
+	     << "  -j THREADS  number of threads (default: one per core, 1 for sequential)" << endl
+	     << "  -s SPLIT    plies split into tasks (default: 2)" << endl
+	     << "  -H MB       size of the shared table of subtree counts (default: 64, 0 for none)" << endl
+	     << "  -d          print the count under each event of the first ply" << endl
+	     << "  -b          time the count with 1, 2, 4... threads up to THREADS" << endl;
+}
+
+static double seconds_since(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Count leaves on one thread, without tasks
+static uint64_t run_sequential(GameState const& state, unsigned int depth,
+                               PerftOptions const& options)
+{
+	GameState copy(state);
+	if (options.table_megabytes == 0)
+		return perft(copy, depth);
+	PerftTable table(options.table_megabytes);
+	return perft(copy, depth, &table);
+}
+
+int main(int argc, char** argv)
+{
+	string save_path;
+	PerftOptions options;
+	bool divide = false;
+	bool scaling = false;
+	unsigned long depth = 0;
+	bool has_depth = false;
+
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "-l" && i + 1 < argc) {
+			save_path = argv[++i];
+		} else if (arg == "-j" && i + 1 < argc) {
+			options.threads = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		} else if (arg == "-s" && i + 1 < argc) {
+			options.split_depth = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		} else if (arg == "-H" && i + 1 < argc) {
+			options.table_megabytes = strtoul(argv[++i], nullptr, 10);
+		} else if (arg == "-d") {
+			divide = true;
+		} else if (arg == "-b") {
+			scaling = true;
+		} else if (!has_depth && !arg.empty() && arg[0] != '-') {
+			depth = strtoul(arg.c_str(), nullptr, 10);
+			has_depth = true;
+		} else {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!has_depth || depth == 0 || depth > 255) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	GameState state;
+	if (!save_path.empty()) {
+		ifstream fs(save_path);
+		try {
+			state.load(fs);
+		} catch (GameError) {
+			cerr << save_path << ": could not load game state" << endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	auto const max_threads = options.threads ? options.threads :
+		max(1u, thread::hardware_concurrency());
+	auto const d = static_cast<unsigned int>(depth);
+
+	if (scaling) {
+		// Every run starts with an empty table, so runs are comparable
+		double base = 0;
+		cout << setw(8) << "threads" << setw(16) << "nodes"
+		     << setw(12) << "seconds" << setw(16) << "nodes/s"
+		     << setw(10) << "speedup" << endl;
+		for (unsigned int threads = 1; ; threads = min(threads * 2, max_threads)) {
+			options.threads = threads;
+			auto const start = chrono::steady_clock::now();
+			auto const nodes = parallelPerft(state, d, options).nodes;
+			auto const elapsed = seconds_since(start);
+			if (threads == 1)
+				base = elapsed;
+			cout << setw(8) << threads << setw(16) << nodes
+			     << setw(12) << fixed << setprecision(3) << elapsed
+			     << setw(16) << setprecision(0) << nodes / elapsed
+			     << setw(9) << setprecision(2) << base / elapsed << 'x' << endl;
+			if (threads == max_threads)
+				break;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	auto const start = chrono::steady_clock::now();
+	uint64_t nodes;
+	if (max_threads == 1 && !divide) {
+		nodes = run_sequential(state, d, options);
+	} else {
+		options.threads = max_threads;
+		auto const result = parallelPerft(state, d, options);
+		if (divide)
+			for (size_t i = 0; i < result.events.size(); ++i)
+				cout << formatEvent(result.events[i]) << ": " << result.counts[i] << endl;
+		nodes = result.nodes;
+	}
+	auto const elapsed = seconds_since(start);
+
+	cout << "depth " << d << ": " << nodes << " nodes" << endl
+	     << fixed << setprecision(3) << elapsed << " s, "
+	     << setprecision(0) << nodes / elapsed << " nodes/s, "
+	     << max_threads << (max_threads == 1 ? " thread" : " threads") << endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "controller.h"
+#include "event.h"
+#include "latency.h"
+#include "listener.h"
+#include "notation.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+namespace fs = std::filesystem;
+
+// A recorded game, ready to be replayed
+struct Game
+{
+	string name;
+	vector<shared_ptr<GameEvent>> events;
+	vector<PieceTypeId> promotions;
+};
+
+// Promotes pawns to whatever they were promoted to in the recorded game
+class ReplayGameListener : public GameListener
+{
+public:
+	PieceTypeId promotion = PieceTypeId::QUEEN;
+
+	PieceTypeId promotePawn(GameController const& gameController,
+	                        Square pawn) override
+	{
+		return promotion;
+	}
+
+	void catchError(GameController const& gameController,
+	                GameError err) override {}
+};
+
+// Name of the baseline file in the games directory, which is not a game
+static char const* const baseline_name = "baseline.txt";
+
+// Measurements, by name, as written in the baseline file
+using Metrics = map<string, double>;
+
+// Print how to use the program
+static void print_usage(char const* program)
+{
+	cerr << "Usage: " << program << " [-g DIR] [-b FILE] [-t PERCENT] [-r ROUNDS] [-s SECONDS] [-w]" << endl
+	     << endl
+	     << "Replays every recorded game (*.txt) through GameController::update" << endl
+	     << "and compares throughput and per-ply latency against a baseline." << endl
+	     << endl
+	     << "  -g DIR      directory of the games (default: " << CHESS_GAMES_DIR << ")" << endl
+	     << "  -b FILE     baseline (default: baseline.txt in the games directory)" << endl
+	     << "  -t PERCENT  tolerance before reporting a regression (default: 20)" << endl
+	     << "  -r ROUNDS   least number of times the corpus is replayed (default: 10)" << endl
+	     << "  -s SECONDS  least time spent replaying it (default: 2)" << endl
+	     << "  -w          write the measurements as the new baseline" << endl;
+}
+
+// Read game from move list, checking that every event can be applied
+static bool load_game(fs::path const& path, Game& game)
+{
+	ifstream fs(path);
+	if (!fs) {
+		cerr << path.string() << ": could not open file" << endl;
+		return false;
+	}
+
+	auto listener = make_shared<ReplayGameListener>();
+	GameController controller(make_unique<GameState>(), listener);
+	game.name = path.filename().string();
+
+	for (auto const& text : readMoveList(fs)) {
+		auto record = parseEvent(controller.getState(), text);
+		auto event = record ? makeEvent(*record) : nullptr;
+		// A pawn that reaches the last rank without a promotion letter
+		// becomes a queen, as in cmdchess
+		auto const promotion = record && record->promotion != PieceTypeId::NONE ?
+			record->promotion : PieceTypeId::QUEEN;
+		listener->promotion = promotion;
+		if (!event || !controller.update(event)) {
+			cerr << game.name << ": illegal event " << text
+			     << " at ply " << controller.getPly() + 1 << endl;
+			return false;
+		}
+		game.events.push_back(event);
+		game.promotions.push_back(promotion);
+	}
+	return true;
+}
+
+// Replay game, recording how long each update takes
+static void replay_game(Game const& game, LatencyHistogram& histogram)
+{
+	auto listener = make_shared<ReplayGameListener>();
+	GameController controller(make_unique<GameState>(), listener);
+	controller.reserveHistory(game.events.size());
+
+	for (size_t i = 0; i < game.events.size(); ++i) {
+		listener->promotion = game.promotions[i];
+		auto const start = chrono::steady_clock::now();
+		controller.update(game.events[i]);
+		auto const elapsed = chrono::steady_clock::now() - start;
+		histogram.record(static_cast<uint64_t>(
+			chrono::duration_cast<chrono::nanoseconds>(elapsed).count()));
+	}
+}
+
+// Read baseline, with one "name value" pair per line, and the build type
+// it was measured with
+static bool load_baseline(fs::path const& path, Metrics& baseline, string& build_type)
+{
+	ifstream fs(path);
+	if (!fs)
+		return false;
+	string line;
+	while (getline(fs, line)) {
+		if (line.empty() || line[0] == '#')
+			continue;
+		istringstream ss(line);
+		string name;
+		double value;
+		if (!(ss >> name))
+			continue;
+		if (name == "build_type")
+			ss >> build_type;
+		else if (ss >> value)
+			baseline[name] = value;
+	}
+	return true;
+}
+
+static bool save_baseline(fs::path const& path, Metrics const& metrics)
+{
+	ofstream fs(path);
+	fs << "# Replay benchmark baseline, written by replaybench -w" << endl;
+	fs << "build_type " << CHESS_BUILD_TYPE << endl;
+	for (auto const& [name, value] : metrics)
+		fs << name << ' ' << fixed << setprecision(0) << value << endl;
+	return bool(fs);
+}
+
+// Throughput should not go down and latencies should not go up
+// Returns true if within tolerance
+static bool compare(string const& name, double value, double base, double tolerance)
+{
+	bool const higher_is_better = name == "moves_per_second";
+	auto const change = (value - base) / base * 100.0;
+	auto const worse = higher_is_better ? -change : change;
+	bool const ok = worse <= tolerance;
+	cout << "  " << left << setw(18) << name << right
+	     << setw(12) << fixed << setprecision(0) << value
+	     << setw(12) << base
+	     << setw(9) << showpos << setprecision(1) << change << '%' << noshowpos
+	     << (ok ? "" : "  REGRESSION") << endl;
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	fs::path directory = CHESS_GAMES_DIR;
+	fs::path baseline_path;
+	double tolerance = 20.0;
+	unsigned long rounds = 10;
+	double min_seconds = 2.0;
+	bool writing = false;
+
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "-g" && i + 1 < argc) {
+			directory = argv[++i];
+		} else if (arg == "-b" && i + 1 < argc) {
+			baseline_path = argv[++i];
+		} else if (arg == "-t" && i + 1 < argc) {
+			tolerance = strtod(argv[++i], nullptr);
+		} else if (arg == "-r" && i + 1 < argc) {
+			rounds = max(1ul, strtoul(argv[++i], nullptr, 10));
+		} else if (arg == "-s" && i + 1 < argc) {
+			min_seconds = strtod(argv[++i], nullptr);
+		} else if (arg == "-w") {
+			writing = true;
+		} else {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (baseline_path.empty())
+		baseline_path = directory / baseline_name;
+
+	vector<fs::path> paths;
+	error_code ec;
+	for (auto const& entry : fs::directory_iterator(directory, ec))
+		if (entry.path().extension() == ".txt" &&
+			entry.path().filename() != baseline_name)
+			paths.push_back(entry.path());
+	sort(paths.begin(), paths.end());
+	if (paths.empty()) {
+		cerr << directory.string() << ": no games found" << endl;
+		return EXIT_FAILURE;
+	}
+
+	vector<Game> games(paths.size());
+	size_t plies = 0;
+	for (size_t i = 0; i < paths.size(); ++i) {
+		if (!load_game(paths[i], games[i]))
+			return EXIT_FAILURE;
+		plies += games[i].events.size();
+	}
+
+	// The first round only warms up caches and the allocator
+	LatencyHistogram histogram;
+	for (auto const& game : games)
+		replay_game(game, histogram);
+	histogram.reset();
+
+	// A short run is too noisy to compare, so it goes on for a while
+	auto const start = chrono::steady_clock::now();
+	double elapsed = 0.0;
+	unsigned long round = 0;
+	while (round < rounds || elapsed < min_seconds) {
+		for (auto const& game : games)
+			replay_game(game, histogram);
+		++round;
+		elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+	rounds = round;
+
+	Metrics metrics;
+	metrics["moves_per_second"] = plies * rounds / elapsed;
+	metrics["p50_ns"] = static_cast<double>(histogram.getPercentile(50.0));
+	metrics["p99_ns"] = static_cast<double>(histogram.getPercentile(99.0));
+	metrics["p999_ns"] = static_cast<double>(histogram.getPercentile(99.9));
+
+	cout << games.size() << " games, " << plies << " plies, " << rounds << " rounds" << endl
+	     << "total " << fixed << setprecision(3) << elapsed << " s, "
+	     << setprecision(0) << metrics["moves_per_second"] << " moves/s" << endl
+	     << "per ply: p50 " << histogram.getPercentile(50.0) << " ns"
+	     << ", p99 " << histogram.getPercentile(99.0) << " ns"
+	     << ", p999 " << histogram.getPercentile(99.9) << " ns"
+	     << ", max " << histogram.getMax() << " ns" << endl;
+
+	if (writing) {
+		if (!save_baseline(baseline_path, metrics)) {
+			cerr << baseline_path.string() << ": could not write baseline" << endl;
+			return EXIT_FAILURE;
+		}
+		cout << "baseline written to " << baseline_path.string() << endl;
+		return EXIT_SUCCESS;
+	}
+
+	Metrics baseline;
+	string build_type;
+	if (!load_baseline(baseline_path, baseline, build_type)) {
+		cout << "no baseline at " << baseline_path.string() << endl;
+		return EXIT_SUCCESS;
+	}
+
+	// Timings of builds optimised differently cannot be compared
+	if (build_type != CHESS_BUILD_TYPE) {
+		cerr << baseline_path.string() << ": baseline of a "
+		     << (build_type.empty() ? "default" : build_type) << " build, not of a "
+		     << (*CHESS_BUILD_TYPE ? CHESS_BUILD_TYPE : "default") << " build" << endl;
+		return EXIT_FAILURE;
+	}
+
+	cout << "against baseline (tolerance " << setprecision(1) << tolerance << "%):" << endl;
+	bool ok = true;
+	for (auto const& [name, value] : metrics) {
+		auto it = baseline.find(name);
+		if (it != baseline.end() && it->second > 0)
+			ok = compare(name, value, it->second, tolerance) && ok;
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,708 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "book.h"
+#include "controller.h"
+#include "event.h"
+#include "listener.h"
+#include "movegen.h"
+#include "notation.h"
+#include "search.h"
+#include "state.h"
+#include "trace.h"
+
+using namespace std;
+using namespace chesslib;
+
+// One of the two engines in the match
+struct EngineConfig
+{
+	SearchOptions options;
+	SearchLimits limits;
+	bool ponder = false; // on the opponent's time
+};
+
+// When a game is called before it ends by the rules
+struct Adjudication
+{
+	int win_score = 1000; // both engines agree a side is this far ahead...
+	unsigned int win_plies = 8; // ...for this many plies in a row
+	int draw_score = 10; // both engines see the game this close...
+	unsigned int draw_plies = 20; // ...for this many plies in a row...
+	unsigned int draw_start = 80; // ...from this ply on
+	unsigned int max_plies = 400; // plies after which the game is a draw
+};
+
+// Outcome of a game, for the first engine
+struct GameOutcome
+{
+	double score; // 1 for a win, 0.5 for a draw, 0 for a loss
+	unsigned int plies;
+	string reason;
+};
+
+// Promotes pawns to the piece type the engine chose
+class SelfPlayListener : public GameListener
+{
+public:
+	PieceTypeId promotion = PieceTypeId::QUEEN;
+
+	PieceTypeId promotePawn(GameController const& gameController,
+	                        Square pawn) override
+	{
+		return promotion;
+	}
+
+	void catchError(GameController const& gameController,
+	                GameError err) override {}
+};
+
+// Print how to use the program
+static void print_usage(char const* program)
+{
+	cerr << "Usage: " << program << " [-n GAMES] [-j THREADS] [-N NODES] [-t MS] [-d DEPTH]" << endl
+	     << "       [-c [MOVES/]MS[+MS]] [-p] [-o FILE] [-r PLIES] [-S SEED] [-a CONFIG] [-b CONFIG]" << endl
+	     << "       [-w SCORE,PLIES] [-D SCORE,PLIES,START] [-m PLIES] [-T FILE] [-v]" << endl
+	     << endl
+	     << "Plays games between two engine configurations, A and B, several at" << endl
+	     << "once, and reports the Elo difference of A over B with its 95% error" << endl
+	     << "bars. Every opening is played twice, with the colours swapped." << endl
+	     << endl
+	     << "  -n GAMES          number of games (default: 100)" << endl
+	     << "  -j THREADS        games played at once (default: one per core)" << endl
+	     << "  -N NODES          nodes per move (default: 20000, unless -t or -d)" << endl
+	     << "  -t MS             milliseconds per move" << endl
+	     << "  -d DEPTH          plies per move" << endl
+	     << "  -c [MOVES/]MS[+MS]  clock of each engine: milliseconds for the game" << endl
+	     << "                    (or for every MOVES moves) plus an increment per" << endl
+	     << "                    move, such as 10000+100; running out loses the game" << endl
+	     << "  -p                ponder on the opponent's time (a game then takes" << endl
+	     << "                    two threads)" << endl
+	     << "  -o FILE           openings, one move list per line (default: random)" << endl
+	     << "  -B FILE           Polyglot opening book both engines play from, after" << endl
+	     << "                    the opening, for as long as the game is in it" << endl
+	     << "  -r PLIES          plies of the random openings (default: 4, or 0" << endl
+	     << "                    with a book)" << endl
+	     << "  -S SEED           seed of the random openings (default: 1)" << endl
+	     << "  -a CONFIG         configuration of A, such as hash=16,qsearch=0" << endl
+	     << "  -b CONFIG         configuration of B (keys: hash, qsearch, history," << endl
+	     << "                    centre, pawn, nodes, time, depth, ponder)" << endl
+	     << "  -w SCORE,PLIES    call a win once both engines agree on SCORE" << endl
+	     << "                    for PLIES plies in a row (default: 1000,8; 0 for never)" << endl
+	     << "  -D SCORE,PLIES,START  call a draw once both engines see the score" << endl
+	     << "                    within SCORE for PLIES plies in a row, from ply START" << endl
+	     << "                    on (default: 10,20,80; 0 for never)" << endl
+	     << "  -m PLIES          call a draw after PLIES plies (default: 400)" << endl
+	     << "  -T FILE           write the search iterations as a Chrome trace" << endl
+	     << "                    (when built with CHESS_TRACING)" << endl
+	     << "  -v                print the outcome of every game" << endl;
+}
+
+// Parse time control such as 40/60000, 10000+100 or 40/60000+100 into
+// search limits
+static bool parse_clock(string const& text, SearchLimits& limits)
+{
+	istringstream ss(text);
+	unsigned long moves = 0, base = 0, increment = 0;
+	if (!(ss >> base))
+		return false;
+	if (ss.peek() == '/') {
+		ss.get();
+		moves = base;
+		if (!(ss >> base))
+			return false;
+	}
+	if (ss.peek() == '+') {
+		ss.get();
+		if (!(ss >> increment))
+			return false;
+	}
+	if (ss.peek() != char_traits<char>::eof() || base == 0)
+		return false;
+	limits.remaining = chrono::milliseconds(base);
+	limits.increment = chrono::milliseconds(increment);
+	limits.moves_to_go = static_cast<unsigned int>(moves);
+	return true;
+}
+
+// Parse comma-separated numbers into the given variables
+template<typename... T>
+static bool parse_numbers(string const& text, T&... values)
+{
+	istringstream ss(text);
+	bool ok = true;
+	bool first = true;
+	auto parse = [&] (auto& value) {
+		if (!first && ss.get() != ',')
+			ok = false;
+		first = false;
+		if (ok && !(ss >> value))
+			ok = false;
+	};
+	(parse(values), ...);
+	return ok && ss.peek() == char_traits<char>::eof();
+}
+
+// Apply comma-separated key=value settings to a configuration
+// Returns false if a setting is unknown or malformed
+static bool parse_config(string const& text, EngineConfig& config)
+{
+	istringstream ss(text);
+	string setting;
+	while (getline(ss, setting, ',')) {
+		auto const equals = setting.find('=');
+		if (equals == string::npos)
+			return false;
+		auto const key = setting.substr(0, equals);
+		char* end;
+		auto const value = strtol(setting.c_str() + equals + 1, &end, 10);
+		if (*end != '\0' || value < 0)
+			return false;
+
+		if (key == "hash")
+			config.options.table_megabytes = static_cast<size_t>(value);
+		else if (key == "qsearch")
+			config.options.quiescence = value != 0;
+		else if (key == "history")
+			config.options.history = value != 0;
+		else if (key == "centre")
+			config.options.centre_weight = static_cast<int>(value);
+		else if (key == "pawn")
+			config.options.pawn_weight = static_cast<int>(value);
+		else if (key == "nodes")
+			config.limits.nodes = static_cast<uint64_t>(value);
+		else if (key == "time")
+			config.limits.time = chrono::milliseconds(value);
+		else if (key == "depth")
+			config.limits.depth = static_cast<unsigned int>(value);
+		else if (key == "ponder")
+			config.ponder = value != 0;
+		else
+			return false;
+	}
+	return true;
+}
+
+// Read openings, one move list per line, checking that they can be played
+static bool load_openings(string const& path, vector<vector<EventRecord>>& openings)
+{
+	ifstream fs(path);
+	if (!fs) {
+		cerr << path << ": could not open file" << endl;
+		return false;
+	}
+
+	string line;
+	for (unsigned int number = 1; getline(fs, line); ++number) {
+		istringstream ss(line);
+		auto listener = make_shared<SelfPlayListener>();
+		GameController controller(make_unique<GameState>(), listener);
+		vector<EventRecord> opening;
+		for (auto const& text : readMoveList(ss)) {
+			auto const record = parseEvent(controller.getState(), text);
+			if (record)
+				listener->promotion = record->promotion == PieceTypeId::NONE ?
+					PieceTypeId::QUEEN : record->promotion;
+			if (!record || !controller.update(makeEvent(*record))) {
+				cerr << path << ":" << number << ": illegal event " << text << endl;
+				return false;
+			}
+			opening.push_back(*record);
+		}
+		if (!opening.empty())
+			openings.push_back(move(opening));
+	}
+
+	if (openings.empty()) {
+		cerr << path << ": no openings" << endl;
+		return false;
+	}
+	return true;
+}
+
+// Pick random opening of given length, the same for both games of a pair
+static vector<EventRecord> random_opening(unsigned int plies, uint64_t seed)
+{
+	mt19937_64 rng(seed);
+	GameState state;
+	vector<EventRecord> opening;
+	vector<EventRecord> events;
+	for (unsigned int ply = 0; ply < plies; ++ply) {
+		auto const info = getCheckInfo(state);
+		LegalMoves moves;
+		generateLegalMoves(state, info, moves);
+		getLegalEvents(moves, events);
+		if (events.empty())
+			break;
+		auto const record = events[rng() % events.size()];
+		UndoRecord undo;
+		applyEvent(state, record, undo);
+		opening.push_back(record);
+	}
+	return opening;
+}
+
+// Search an engine runs on the opponent's time, in the position after
+// the event it expects the opponent to play
+// It runs on a thread of its own, started with the first search and kept
+// for the ones after it (of any game the engine plays)
+class PonderSearch
+{
+public:
+	explicit PonderSearch(SearchEngine& engine) :
+		m_engine(engine), m_expected(0), m_queued(false), m_busy(false), m_quit(false) {}
+
+	PonderSearch(PonderSearch const&) = delete;
+	PonderSearch& operator=(PonderSearch const&) = delete;
+
+	~PonderSearch()
+	{
+		if (!m_thread.joinable())
+			return;
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_quit = true;
+			if (m_busy)
+				m_engine.stop();
+		}
+		m_ready.notify_all();
+		m_thread.join();
+	}
+
+	// Start pondering, given the line the engine found for its move
+	// (which was just played) and the hashes of the positions before
+	// the one on the board
+	void start(GameState const& state, SearchLimits limits,
+	           vector<EventRecord> const& pv, vector<uint64_t> history)
+	{
+		if (pv.size() < 2)
+			return;
+		GameState next(state);
+		history.push_back(next.getHash());
+		UndoRecord undo;
+		applyEvent(next, pv[1], undo);
+		limits.ponder = true;
+
+		if (!m_thread.joinable())
+			m_thread = thread([this] { run(); });
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_expected = packMove(pv[1]);
+			m_state = next;
+			m_limits = limits;
+			m_history = move(history);
+			m_queued = true;
+			m_busy = true;
+		}
+		m_ready.notify_all();
+	}
+
+	// Finish pondering, given the event the opponent played
+	// Returns true if it was the one expected, in which case the search
+	// went on until it reached its limits, and its result is given
+	bool finish(EventRecord const& played, SearchResult& result)
+	{
+		unique_lock<mutex> lock(m_mutex);
+		if (!m_busy)
+			return false;
+		bool const hit = packMove(played) == m_expected;
+		if (hit)
+			m_engine.ponderHit();
+		else
+			m_engine.stop();
+		m_done.wait(lock, [this] { return !m_busy; });
+		if (hit)
+			result = m_result;
+		return hit;
+	}
+
+	// Stop pondering, when the engine plays without searching
+	void stop()
+	{
+		unique_lock<mutex> lock(m_mutex);
+		if (!m_busy)
+			return;
+		m_engine.stop();
+		m_done.wait(lock, [this] { return !m_busy; });
+	}
+private:
+	// Run the searches handed to the thread, one at a time
+	void run()
+	{
+		setTraceThreadName("ponder");
+		unique_lock<mutex> lock(m_mutex);
+		while (true) {
+			m_ready.wait(lock, [this] { return m_queued || m_quit; });
+			if (m_quit)
+				return;
+			m_queued = false;
+			lock.unlock();
+			auto result = m_engine.search(m_state, m_limits, m_history);
+			lock.lock();
+			m_result = move(result);
+			m_busy = false;
+			m_done.notify_all();
+		}
+	}
+
+	SearchEngine& m_engine;
+	uint16_t m_expected;
+	GameState m_state; // position searched, with its limits and history
+	SearchLimits m_limits;
+	vector<uint64_t> m_history;
+	SearchResult m_result;
+	bool m_queued; // search handed to the thread, but not started
+	bool m_busy; // search handed to the thread, but not finished
+	bool m_quit;
+	mutex m_mutex;
+	condition_variable m_ready; // of a search to run, or of quitting
+	condition_variable m_done; // of a search finished
+	thread m_thread;
+};
+
+// Play game from an opening, then from the book (picking its moves with
+// the given seed), with the first engine as white or black
+static GameOutcome play_game(vector<EventRecord> const& opening,
+                             OpeningBook const& book, uint64_t book_seed,
+                             SearchEngine& first, PonderSearch& first_ponder,
+                             EngineConfig const& first_config,
+                             SearchEngine& second, PonderSearch& second_ponder,
+                             EngineConfig const& second_config,
+                             bool first_is_white, Adjudication const& rules)
+{
+	auto listener = make_shared<SelfPlayListener>();
+	GameController controller(make_unique<GameState>(), listener);
+	controller.reserveHistory(rules.max_plies + opening.size());
+	vector<uint64_t> history;
+	EventRecord last_played{ GameEventId::MOVE, SQ_CNT, SQ_CNT, PieceTypeId::NONE };
+
+	auto const play = [&] (EventRecord const& record) {
+		history.push_back(controller.getState().getHash());
+		last_played = record;
+		listener->promotion = record.promotion == PieceTypeId::NONE ?
+			PieceTypeId::QUEEN : record.promotion;
+		return controller.update(makeEvent(record));
+	};
+
+	for (auto const& record : opening)
+		play(record);
+
+	first.clear();
+	second.clear();
+
+	// Clocks of the engines (first, then second), if they play on one
+	SearchLimits clocks[2] = { first_config.limits, second_config.limits };
+	unsigned int win_streak = 0;
+	unsigned int draw_streak = 0;
+	int last_sign = 0;
+	mt19937_64 book_rng(book_seed);
+	bool in_book = book.isOpen();
+
+	auto const& state = controller.getState();
+	while (state.getPhase() == Phase::RUNNING) {
+		if (controller.getPly() >= rules.max_plies)
+			return GameOutcome{ 0.5, static_cast<unsigned int>(controller.getPly()), "ply limit" };
+
+		bool const white = state.getTurn() == Colour::WHITE;
+		bool const first_to_move = white == first_is_white;
+		auto& engine = first_to_move ? first : second;
+		auto& limits = clocks[first_to_move ? 0 : 1];
+		auto& ponder = first_to_move ? first_ponder : second_ponder;
+		auto const& config = first_to_move ? first_config : second_config;
+
+		// Book moves are played without searching, and take no time
+		if (in_book) {
+			auto const record = book.pick(state, book_rng);
+			in_book = record && controller.canUpdate(makeEvent(*record));
+			if (in_book) {
+				ponder.stop();
+				play(*record);
+				continue;
+			}
+		}
+
+		// The clock runs from the ponder hit on, as the search did not
+		// have to start over
+		auto const start = chrono::steady_clock::now();
+		SearchResult result;
+		if (!ponder.finish(last_played, result))
+			result = engine.search(state, limits, history);
+		if (limits.remaining.count() > 0) {
+			auto const spent = chrono::duration_cast<chrono::milliseconds>(
+				chrono::steady_clock::now() - start);
+			if (spent >= limits.remaining)
+				return GameOutcome{ first_to_move ? 0.0 : 1.0,
+				                    static_cast<unsigned int>(controller.getPly()), "time forfeit" };
+			limits.remaining += limits.increment - spent;
+			if (config.limits.moves_to_go > 0 && --limits.moves_to_go == 0) {
+				limits.remaining += config.limits.remaining;
+				limits.moves_to_go = config.limits.moves_to_go;
+			}
+		}
+		if (result.pv.empty() || !play(result.pv.front()))
+			return GameOutcome{ first_to_move ? 0.0 : 1.0,
+			                    static_cast<unsigned int>(controller.getPly()), "illegal event" };
+		if (config.ponder && state.getPhase() == Phase::RUNNING)
+			ponder.start(state, limits, result.pv, history);
+
+		// Scores of both engines are compared from the point of view of
+		// the first engine
+		auto const score = first_to_move ? result.score : -result.score;
+
+		auto const sign = score >= rules.win_score ? 1 : score <= -rules.win_score ? -1 : 0;
+		win_streak = (sign != 0 && sign == last_sign) ? win_streak + 1 : (sign != 0);
+		last_sign = sign;
+		if (rules.win_score > 0 && win_streak >= rules.win_plies)
+			return GameOutcome{ sign > 0 ? 1.0 : 0.0,
+			                    static_cast<unsigned int>(controller.getPly()), "adjudicated win" };
+
+		draw_streak = (controller.getPly() >= rules.draw_start && abs(score) <= rules.draw_score) ?
+			draw_streak + 1 : 0;
+		if (rules.draw_plies > 0 && draw_streak >= rules.draw_plies)
+			return GameOutcome{ 0.5, static_cast<unsigned int>(controller.getPly()), "adjudicated draw" };
+	}
+
+	auto const plies = static_cast<unsigned int>(controller.getPly());
+	switch (state.getPhase()) {
+	case Phase::WHITE_WON:
+		return GameOutcome{ first_is_white ? 1.0 : 0.0, plies, "checkmate" };
+	case Phase::BLACK_WON:
+		return GameOutcome{ first_is_white ? 0.0 : 1.0, plies, "checkmate" };
+	default:
+		switch (state.getDrawReason()) {
+		case DrawReason::STALEMATE:
+			return GameOutcome{ 0.5, plies, "stalemate" };
+		case DrawReason::FIFTY_MOVE_RULE:
+			return GameOutcome{ 0.5, plies, "fifty-move rule" };
+		default:
+			return GameOutcome{ 0.5, plies, "repetition" };
+		}
+	}
+}
+
+// Get Elo difference that a score (between 0 and 1, excluded) stands for
+static double get_elo(double score)
+{
+	return -400.0 * log10(1.0 / score - 1.0);
+}
+
+// Print Elo difference, or how it cannot be told
+static void print_elo(ostream& os, double score)
+{
+	if (score <= 0.0)
+		os << "-inf";
+	else if (score >= 1.0)
+		os << "+inf";
+	else
+	{
+		// Even scores would otherwise print as -0.0
+		auto const elo = get_elo(score);
+		os << showpos << fixed << setprecision(1) << (elo == 0.0 ? 0.0 : elo) << noshowpos;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned long games = 100;
+	unsigned int threads = 0;
+	string openings_path;
+	string book_path;
+	string trace_path;
+	unsigned int random_plies = 4;
+	bool random_plies_set = false;
+	uint64_t seed = 1;
+	bool verbose = false;
+	Adjudication rules;
+	SearchLimits limits;
+	bool limited = false;
+	bool ponder = false;
+	string configs[2];
+
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		bool ok = true;
+		if (arg == "-n" && i + 1 < argc) {
+			games = strtoul(argv[++i], nullptr, 10);
+		} else if (arg == "-j" && i + 1 < argc) {
+			threads = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		} else if (arg == "-N" && i + 1 < argc) {
+			limits.nodes = strtoull(argv[++i], nullptr, 10);
+			limited = true;
+		} else if (arg == "-t" && i + 1 < argc) {
+			limits.time = chrono::milliseconds(strtoul(argv[++i], nullptr, 10));
+			limited = true;
+		} else if (arg == "-d" && i + 1 < argc) {
+			limits.depth = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+			limited = true;
+		} else if (arg == "-c" && i + 1 < argc) {
+			ok = parse_clock(argv[++i], limits);
+			limited = true;
+		} else if (arg == "-p") {
+			ponder = true;
+		} else if (arg == "-o" && i + 1 < argc) {
+			openings_path = argv[++i];
+		} else if (arg == "-B" && i + 1 < argc) {
+			book_path = argv[++i];
+		} else if (arg == "-r" && i + 1 < argc) {
+			random_plies = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+			random_plies_set = true;
+		} else if (arg == "-S" && i + 1 < argc) {
+			seed = strtoull(argv[++i], nullptr, 10);
+		} else if (arg == "-a" && i + 1 < argc) {
+			configs[0] = argv[++i];
+		} else if (arg == "-b" && i + 1 < argc) {
+			configs[1] = argv[++i];
+		} else if (arg == "-w" && i + 1 < argc) {
+			ok = parse_numbers(argv[++i], rules.win_score, rules.win_plies);
+		} else if (arg == "-D" && i + 1 < argc) {
+			ok = parse_numbers(argv[++i], rules.draw_score, rules.draw_plies, rules.draw_start);
+		} else if (arg == "-m" && i + 1 < argc) {
+			rules.max_plies = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		} else if (arg == "-T" && i + 1 < argc) {
+			trace_path = argv[++i];
+		} else if (arg == "-v") {
+			verbose = true;
+		} else {
+			ok = false;
+		}
+		if (!ok) {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!limited)
+		limits.nodes = 20000;
+
+	EngineConfig engines[2];
+	for (int e = 0; e < 2; ++e) {
+		engines[e].limits = limits;
+		engines[e].ponder = ponder;
+		if (!parse_config(configs[e], engines[e])) {
+			cerr << "invalid configuration: " << configs[e] << endl;
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	vector<vector<EventRecord>> openings;
+	if (!openings_path.empty() && !load_openings(openings_path, openings))
+		return EXIT_FAILURE;
+
+	OpeningBook book;
+	if (!book_path.empty()) {
+		if (!book.open(book_path)) {
+			cerr << book_path << ": could not open book" << endl;
+			return EXIT_FAILURE;
+		}
+		if (!random_plies_set)
+			random_plies = 0;
+	}
+
+	if (threads == 0)
+		threads = max(1u, thread::hardware_concurrency());
+	threads = static_cast<unsigned int>(min<unsigned long>(threads, max(1ul, games)));
+
+	// Games are handed out in order, so that both games of a pair are
+	// played at about the same time
+	atomic<unsigned long> next_game(0);
+	mutex report_mutex;
+	unsigned long wins = 0, draws = 0, losses = 0;
+	uint64_t plies = 0;
+
+	auto const start = chrono::steady_clock::now();
+	auto const work = [&] {
+		setTraceThreadName("selfplay");
+		SearchEngine a(engines[0].options);
+		SearchEngine b(engines[1].options);
+		PonderSearch a_ponder(a);
+		PonderSearch b_ponder(b);
+		while (true) {
+			auto const game = next_game.fetch_add(1, memory_order_relaxed);
+			if (game >= games)
+				break;
+			auto const pair = game / 2;
+			bool const a_is_white = game % 2 == 0;
+			auto const opening = openings.empty() ?
+				random_opening(random_plies, seed + pair) :
+				openings[pair % openings.size()];
+
+			auto const outcome = play_game(opening, book, seed + pair,
+			                               a, a_ponder, engines[0],
+			                               b, b_ponder, engines[1],
+			                               a_is_white, rules);
+
+			// Searches on the opponent's time are of no use once the
+			// game is over, and the engines are cleared for the next one
+			a_ponder.stop();
+			b_ponder.stop();
+
+			lock_guard<mutex> lock(report_mutex);
+			if (outcome.score == 1.0)
+				++wins;
+			else if (outcome.score == 0.0)
+				++losses;
+			else
+				++draws;
+			plies += outcome.plies;
+			if (verbose)
+				cout << "game " << game + 1 << ": A " << (a_is_white ? "white" : "black")
+				     << ", " << (outcome.score == 1.0 ? "1-0" : outcome.score == 0.0 ? "0-1" : "1/2")
+				     << " for A by " << outcome.reason << " in " << outcome.plies
+				     << " plies" << endl;
+		}
+	};
+
+	vector<thread> pool;
+	for (unsigned int worker = 1; worker < threads; ++worker)
+		pool.emplace_back(work);
+	work();
+	for (auto& t : pool)
+		t.join();
+	auto const elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	if (!trace_path.empty()) {
+		ofstream fs(trace_path);
+		writeTrace(fs);
+		if (!fs)
+			cerr << trace_path << ": could not write trace" << endl;
+	}
+
+	// The error bars come from the spread of the score of a game around
+	// the mean, with the normal approximation
+	auto const played = static_cast<double>(wins + draws + losses);
+	if (played == 0) {
+		cout << "no games played" << endl;
+		return EXIT_SUCCESS;
+	}
+	auto const mean = (wins + 0.5 * draws) / played;
+	auto const variance = (wins * pow(1.0 - mean, 2) + draws * pow(0.5 - mean, 2) +
+	                       losses * pow(0.0 - mean, 2)) / played;
+	auto const margin = 1.96 * sqrt(variance / played);
+
+	cout << "games " << wins + draws + losses << ": A +" << wins << " =" << draws
+	     << " -" << losses << ", score " << fixed << setprecision(3) << mean << endl;
+	cout << "elo A-B ";
+	print_elo(cout, mean);
+	cout << " [";
+	print_elo(cout, mean - margin);
+	cout << ", ";
+	print_elo(cout, mean + margin);
+	cout << "] (95%)" << endl;
+	cout << fixed << setprecision(2) << played / elapsed << " games/s, "
+	     << setprecision(0) << plies / elapsed << " plies/s, "
+	     << threads << (threads == 1 ? " thread" : " threads") << endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "state.h"
+#include "tablebase.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Print how to use the program
+static void print_usage(char const* program)
+{
+	cerr << "Usage: " << program << " [-d DIR] [-j THREADS] MATERIAL..." << endl
+	     << "       " << program << " [-d DIR] -p SAVE..." << endl
+	     << endl
+	     << "Generates the endgame tables of each material signature" << endl
+	     << "(e.g. KQvK, KRvK, KPvK, KBNvK) and the ones they depend on," << endl
+	     << "or, with -p, probes the tables with saved game states." << endl
+	     << endl
+	     << "  -d DIR      directory of the tables (default: tables)" << endl
+	     << "  -j THREADS  number of threads (default: one per core)" << endl;
+}
+
+// Print what the tablebase knows about a saved game state
+static bool probe(Tablebase const& tablebase, string const& path)
+{
+	ifstream fs(path);
+	GameState state;
+	try {
+		state.load(fs);
+	} catch (GameError) {
+		cerr << path << ": could not load game state" << endl;
+		return false;
+	}
+
+	cout << path << ": ";
+	auto result = tablebase.probe(state);
+	if (!result)
+		cout << "not found";
+	else if (result->outcome == Outcome::DRAW)
+		cout << "draw";
+	else
+		cout << (result->outcome == Outcome::WIN ? "win" : "loss")
+		     << " in " << result->dtm << " plies";
+	cout << endl;
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	string directory = "tables";
+	unsigned int threads = 0;
+	bool probing = false;
+	vector<string> args;
+
+	for (int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if (arg == "-d" && i + 1 < argc) {
+			directory = argv[++i];
+		} else if (arg == "-j" && i + 1 < argc) {
+			threads = static_cast<unsigned int>(strtoul(argv[++i], nullptr, 10));
+		} else if (arg == "-p") {
+			probing = true;
+		} else if (arg.size() > 1 && arg[0] == '-') {
+			print_usage(argv[0]);
+			return EXIT_FAILURE;
+		} else {
+			args.push_back(arg);
+		}
+	}
+
+	if (args.empty()) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	bool ok = true;
+	if (probing) {
+		Tablebase tablebase;
+		if (!tablebase.load(directory))
+			cerr << directory << ": some tables could not be loaded" << endl;
+		for (auto const& path : args)
+			ok = probe(tablebase, path) && ok;
+	} else {
+		for (auto const& material : args)
+			ok = generateTablebase(material, directory, threads, &cout) && ok;
+	}
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
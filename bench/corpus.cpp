@@ -0,0 +1,104 @@
+#include "corpus.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+#include "listener.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Number of midgame positions and the range of their plies
+static const size_t midgame_cnt = 32;
+static const size_t midgame_min_plies = 16;
+static const size_t midgame_max_plies = 60;
+
+class BenchGameListener : public GameListener
+{
+	PieceTypeId promotePawn(GameController const& gameController,
+	                        Square pawn) override
+	{
+		return PieceTypeId::QUEEN;
+	}
+
+	void catchError(GameController const& gameController,
+	                GameError err) override {}
+};
+
+GameController makeController(GameState const& state)
+{
+	static const auto listener = make_shared<BenchGameListener>();
+	return GameController(make_unique<GameState>(state), listener);
+}
+
+vector<shared_ptr<GameEvent>> getLegalEvents(GameController const& controller)
+{
+	vector<shared_ptr<GameEvent>> events;
+	for (Square origin = SQ_A1; origin < SQ_CNT; ++origin) {
+		for (Square dest = SQ_A1; dest < SQ_CNT; ++dest) {
+			auto move = make_shared<Move>(origin, dest);
+			if (controller.canUpdate(move))
+				events.push_back(move);
+		}
+	}
+	for (auto rook : { SQ_A1, SQ_H1, SQ_A8, SQ_H8 }) {
+		auto castling = make_shared<Castling>(rook);
+		if (controller.canUpdate(castling))
+			events.push_back(castling);
+	}
+	return events;
+}
+
+static void addPosition(vector<CorpusPosition>& corpus, string const& name,
+                        GameState const& state)
+{
+	auto controller = makeController(state);
+	corpus.push_back(CorpusPosition{ name, state, getLegalEvents(controller) });
+}
+
+static vector<CorpusPosition> makeCorpus()
+{
+	vector<CorpusPosition> corpus;
+
+	vector<filesystem::path> saves;
+	for (auto const& entry : filesystem::directory_iterator(CHESS_SAVES_DIR))
+		if (entry.path().extension() == ".dat")
+			saves.push_back(entry.path());
+	sort(saves.begin(), saves.end());
+	for (auto const& path : saves) {
+		ifstream fs(path);
+		GameState state;
+		try {
+			state.load(fs);
+		} catch (GameError) {
+			continue;
+		}
+		addPosition(corpus, "saves/" + path.filename().string(), state);
+	}
+
+	mt19937_64 rng(20240229);
+	uniform_int_distribution<size_t> plies(midgame_min_plies, midgame_max_plies);
+	while (corpus.size() < saves.size() + midgame_cnt) {
+		auto controller = makeController(GameState());
+		auto const target = plies(rng);
+		for (size_t ply = 0; ply < target; ++ply) {
+			auto events = getLegalEvents(controller);
+			if (events.empty())
+				break;
+			controller.update(events[rng() % events.size()]);
+		}
+		if (controller.getState().getPhase() == Phase::RUNNING)
+			addPosition(corpus, "midgame/" + to_string(corpus.size() - saves.size()),
+			            controller.getState());
+	}
+
+	return corpus;
+}
+
+vector<CorpusPosition> const& getCorpus()
+{
+	static const auto corpus = makeCorpus();
+	return corpus;
+}
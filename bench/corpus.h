@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory> // std::shared_ptr
+#include <string> // std::string
+#include <vector> // std::vector
+
+#include "controller.h" // GameController
+#include "event.h" // GameEvent
+#include "state.h" // GameState
+
+// A position of the benchmark corpus, along with its legal events
+struct CorpusPosition
+{
+	std::string name;
+	chesslib::GameState state;
+	std::vector<std::shared_ptr<chesslib::GameEvent>> events;
+};
+
+// Get the benchmark corpus: the game states in the saves directory and
+// midgame positions reached by random games (always the same ones)
+std::vector<CorpusPosition> const& getCorpus();
+
+// Create a controller for a copy of the game state, which promotes
+// pawns to queens
+chesslib::GameController makeController(chesslib::GameState const& state);
+
+// Get the legal events of the player whose turn it is
+std::vector<std::shared_ptr<chesslib::GameEvent>>
+getLegalEvents(chesslib::GameController const& controller);
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "batch.h"
+#include "board.h"
+#include "corpus.h"
+#include "legality.h"
+#include "movegen.h"
+#include "statistics.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Every benchmark cycles through the corpus, one operation per iteration,
+// so that the time per iteration is the time per operation on average
+
+// Report what the rules engine counted per operation, if anything
+static void reportStatistics(benchmark::State& state)
+{
+	if (!statistics_enabled)
+		return;
+	auto const statistics = getStatistics();
+	for (auto c = Counter::UPDATE; c < Counter::MAX;
+	     c = static_cast<Counter>(static_cast<int>(c) + 1))
+		state.counters[getCounterName(c)] = benchmark::Counter(
+			static_cast<double>(statistics.get(c)),
+			benchmark::Counter::kAvgIterations);
+}
+
+// Controllers for every position of the corpus
+static vector<GameController> makeControllers()
+{
+	vector<GameController> controllers;
+	for (auto const& position : getCorpus())
+		controllers.push_back(makeController(position.state));
+	return controllers;
+}
+
+// Every legal event of every position of the corpus
+static vector<pair<size_t, shared_ptr<GameEvent>>> getCorpusEvents()
+{
+	vector<pair<size_t, shared_ptr<GameEvent>>> events;
+	auto const& corpus = getCorpus();
+	for (size_t i = 0; i < corpus.size(); ++i)
+		for (auto const& event : corpus[i].events)
+			events.emplace_back(i, event);
+	return events;
+}
+
+static void BM_Update(benchmark::State& state)
+{
+	auto controllers = makeControllers();
+	auto const events = getCorpusEvents();
+	size_t i = 0;
+	resetStatistics();
+	for (auto _ : state) {
+		auto& controller = controllers[events[i].first];
+		controller.update(events[i].second);
+		controller.undo();
+		i = (i + 1) % events.size();
+	}
+	reportStatistics(state);
+	state.SetLabel("with undo");
+}
+BENCHMARK(BM_Update);
+
+// A controller only decides the first event asked about in a position
+// from scratch, and answers the others from its cache of legal moves, so
+// every iteration gets a controller that has not been asked anything yet
+static void BM_CanUpdate(benchmark::State& state)
+{
+	auto const& corpus = getCorpus();
+	auto const events = getCorpusEvents();
+	optional<GameController> controller;
+	size_t i = 0;
+	resetStatistics();
+	for (auto _ : state) {
+		state.PauseTiming();
+		controller.emplace(makeController(corpus[events[i].first].state));
+		state.ResumeTiming();
+		benchmark::DoNotOptimize(controller->canUpdate(events[i].second));
+		i = (i + 1) % events.size();
+	}
+	reportStatistics(state);
+	state.SetLabel("uncached");
+}
+BENCHMARK(BM_CanUpdate);
+
+// The check test GameController makes when its cache is empty
+static void BM_IsInCheck(benchmark::State& state)
+{
+	auto const& corpus = getCorpus();
+	size_t i = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(getCheckInfo(corpus[i].state).checkers != 0);
+		i = (i + 1) % corpus.size();
+	}
+}
+BENCHMARK(BM_IsInCheck);
+
+// The scan GameController makes after every update to find checkmates,
+// which generates the legal moves of the new position
+static void BM_HasLegalMoves(benchmark::State& state)
+{
+	auto const& corpus = getCorpus();
+	LegalMoves moves;
+	size_t i = 0;
+	for (auto _ : state) {
+		auto const& game = corpus[i].state;
+		generateLegalMoves(game, getCheckInfo(game), moves);
+		benchmark::DoNotOptimize(any_of(moves.destinations.begin(), moves.destinations.end(),
+		                                [] (Bitboard dests) { return dests != 0; }));
+		i = (i + 1) % corpus.size();
+	}
+}
+BENCHMARK(BM_HasLegalMoves);
+
+static void BM_BoardCopy(benchmark::State& state)
+{
+	auto const& corpus = getCorpus();
+	size_t i = 0;
+	for (auto _ : state) {
+		Board board(corpus[i].state.getBoard());
+		benchmark::DoNotOptimize(board);
+		i = (i + 1) % corpus.size();
+	}
+}
+BENCHMARK(BM_BoardCopy);
+
+static void BM_GameStateLoad(benchmark::State& state)
+{
+	vector<string> saved;
+	for (auto const& position : getCorpus()) {
+		ostringstream os;
+		position.state.save(os);
+		saved.push_back(os.str());
+	}
+	GameState game;
+	size_t i = 0;
+	for (auto _ : state) {
+		istringstream is(saved[i]);
+		game.load(is);
+		i = (i + 1) % saved.size();
+	}
+}
+BENCHMARK(BM_GameStateLoad);
+
+static void BM_GameStateSave(benchmark::State& state)
+{
+	auto const& corpus = getCorpus();
+	size_t i = 0;
+	for (auto _ : state) {
+		ostringstream os;
+		corpus[i].state.save(os);
+		benchmark::DoNotOptimize(os);
+		i = (i + 1) % corpus.size();
+	}
+}
+BENCHMARK(BM_GameStateSave);
+
+// Every destination square for every piece of the given type
+static void BM_CanApply(benchmark::State& state, PieceTypeId id)
+{
+	auto const& corpus = getCorpus();
+	vector<pair<size_t, Move>> moves;
+	for (size_t i = 0; i < corpus.size(); ++i)
+		for (Square origin = SQ_A1; origin < SQ_CNT; ++origin)
+			if (corpus[i].state.getPieceAt(origin).getType()->getId() == id)
+				for (Square dest = SQ_A1; dest < SQ_CNT; ++dest)
+					if (dest != origin)
+						moves.emplace_back(i, Move(origin, dest));
+
+	auto const type = getPieceTypeById(id);
+	size_t i = 0;
+	for (auto _ : state) {
+		auto const& [position, move] = moves[i];
+		benchmark::DoNotOptimize(type->canApply(corpus[position].state, move));
+		i = (i + 1) % moves.size();
+	}
+}
+BENCHMARK_CAPTURE(BM_CanApply, pawn, PieceTypeId::PAWN);
+BENCHMARK_CAPTURE(BM_CanApply, king, PieceTypeId::KING);
+BENCHMARK_CAPTURE(BM_CanApply, queen, PieceTypeId::QUEEN);
+BENCHMARK_CAPTURE(BM_CanApply, bishop, PieceTypeId::BISHOP);
+BENCHMARK_CAPTURE(BM_CanApply, knight, PieceTypeId::KNIGHT);
+BENCHMARK_CAPTURE(BM_CanApply, rook, PieceTypeId::ROOK);
+
+// Batch kernels go over the whole corpus in every iteration, so their
+// time per position is given by the items processed per second
+
+static PositionBatch makeBatch()
+{
+	PositionBatch batch;
+	auto const& corpus = getCorpus();
+	batch.reserve(corpus.size());
+	for (auto const& position : corpus)
+		batch.push(position.state);
+	return batch;
+}
+
+static void BM_BatchInCheck(benchmark::State& state)
+{
+	auto const batch = makeBatch();
+	vector<uint8_t> checks;
+	for (auto _ : state) {
+		inCheck(batch, checks);
+		benchmark::DoNotOptimize(checks.data());
+	}
+	state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_BatchInCheck);
+
+static void BM_BatchMaterialBalance(benchmark::State& state)
+{
+	auto const batch = makeBatch();
+	vector<int32_t> balances;
+	for (auto _ : state) {
+		materialBalance(batch, balances);
+		benchmark::DoNotOptimize(balances.data());
+	}
+	state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_BatchMaterialBalance);
+
+static void BM_BatchAttackCounts(benchmark::State& state)
+{
+	auto const batch = makeBatch();
+	vector<uint8_t> counts;
+	for (auto _ : state) {
+		attackCounts(batch, Colour::WHITE, counts);
+		benchmark::DoNotOptimize(counts.data());
+	}
+	state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_BatchAttackCounts);
+
+int main(int argc, char** argv)
+{
+	// Results are written in JSON unless another format is asked for,
+	// so that they can be compared across releases
+	vector<char*> args(argv, argv + argc);
+	char json[] = "--benchmark_format=json";
+	if (none_of(args.begin(), args.end(), [] (char const* arg) {
+		return strncmp(arg, "--benchmark_format", 18) == 0;
+	}))
+		args.push_back(json);
+
+	int count = static_cast<int>(args.size());
+	benchmark::Initialize(&count, args.data());
+	if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+		return 1;
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,261 @@
+#include "batch.h"
+
+#include "movegen.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+namespace
+{
+	constexpr Bitboard not_file_a = 0xfefefefefefefefeull;
+	constexpr Bitboard not_file_h = 0x7f7f7f7f7f7f7f7full;
+
+	size_t getIndex(PieceTypeId id)
+	{
+		return static_cast<size_t>(id) - 1;
+	}
+
+	// Count squares with plain arithmetic, which compilers inline and
+	// vectorise, unlike the library call __builtin_popcountll turns into
+	// when the target has no population count instruction
+	int countBits(Bitboard bb)
+	{
+		bb -= (bb >> 1) & 0x5555555555555555ull;
+		bb = (bb & 0x3333333333333333ull) + ((bb >> 2) & 0x3333333333333333ull);
+		bb = (bb + (bb >> 4)) & 0x0f0f0f0f0f0f0f0full;
+		return static_cast<int>((bb * 0x0101010101010101ull) >> 56);
+	}
+
+	template<int Step>
+	constexpr Bitboard shift(Bitboard bb)
+	{
+		return Step > 0 ? bb << Step : bb >> -Step;
+	}
+
+	// Get squares a slider reaches from any of the given squares in one
+	// direction, up to and including the first occupied square, by
+	// filling the empty squares in steps of 1, 2 and 4 squares at once
+	// (Kogge-Stone), which takes no branches and no table lookups
+	template<int Step, Bitboard Mask>
+	Bitboard slide(Bitboard sliders, Bitboard empty)
+	{
+		empty &= Mask;
+		sliders |= empty & shift<Step>(sliders);
+		empty &= shift<Step>(empty);
+		sliders |= empty & shift<2 * Step>(sliders);
+		empty &= shift<2 * Step>(empty);
+		sliders |= empty & shift<4 * Step>(sliders);
+		return shift<Step>(sliders) & Mask;
+	}
+
+	// Pieces of one colour in one position, as far as attacks go
+	struct Attackers
+	{
+		Bitboard pawns;
+		Bitboard knights;
+		Bitboard kings;
+		Bitboard diagonal; // bishops and queens
+		Bitboard straight; // rooks and queens
+	};
+
+	// Get squares attacked by the pieces, given the occupied squares.
+	// Pawns capture by square index, so they wrap around the edges of
+	// the board like Pawn::canApply lets them, and kings only move
+	// orthogonally. Knights are looked up, as they jump along a line
+	// that no shift follows.
+	Bitboard getAttacked(Attackers const& a, Colour c, Bitboard occupied)
+	{
+		auto const empty = ~occupied;
+		Bitboard attacked;
+		if (c == Colour::WHITE)
+			attacked = shift<7>(a.pawns) | shift<9>(a.pawns);
+		else
+			attacked = shift<-7>(a.pawns) | shift<-9>(a.pawns);
+
+		attacked |= shift<8>(a.kings) | shift<-8>(a.kings) |
+		            (shift<1>(a.kings) & not_file_a) |
+		            (shift<-1>(a.kings) & not_file_h);
+
+		attacked |= slide<8, ~Bitboard(0)>(a.straight, empty) |
+		            slide<-8, ~Bitboard(0)>(a.straight, empty) |
+		            slide<1, not_file_a>(a.straight, empty) |
+		            slide<-1, not_file_h>(a.straight, empty);
+
+		attacked |= slide<9, not_file_a>(a.diagonal, empty) |
+		            slide<7, not_file_h>(a.diagonal, empty) |
+		            slide<-7, not_file_a>(a.diagonal, empty) |
+		            slide<-9, not_file_h>(a.diagonal, empty);
+
+		for (auto knights = a.knights; knights; )
+			attacked |= getKnightMoves(popFirstSquare(knights));
+
+		return attacked;
+	}
+
+	// Gathers the pieces of a position from the arrays of a batch
+	class BatchReader
+	{
+	public:
+		explicit BatchReader(PositionBatch const& batch)
+		{
+			for (size_t c = 0; c < colour_cnt; ++c)
+				for (size_t t = 0; t < piece_type_cnt; ++t)
+					m_pieces[c][t] = batch.getPieces(static_cast<Colour>(c),
+					                                 static_cast<PieceTypeId>(t + 1));
+		}
+
+		Bitboard getPieces(size_t i, size_t c, PieceTypeId id) const
+		{
+			return m_pieces[c][getIndex(id)][i];
+		}
+
+		Bitboard getOccupied(size_t i) const
+		{
+			Bitboard occupied = 0;
+			for (size_t c = 0; c < colour_cnt; ++c)
+				for (size_t t = 0; t < piece_type_cnt; ++t)
+					occupied |= m_pieces[c][t][i];
+			return occupied;
+		}
+
+		Attackers getAttackers(size_t i, size_t c) const
+		{
+			auto const queens = getPieces(i, c, PieceTypeId::QUEEN);
+			return Attackers{
+				getPieces(i, c, PieceTypeId::PAWN),
+				getPieces(i, c, PieceTypeId::KNIGHT),
+				getPieces(i, c, PieceTypeId::KING),
+				getPieces(i, c, PieceTypeId::BISHOP) | queens,
+				getPieces(i, c, PieceTypeId::ROOK) | queens,
+			};
+		}
+	private:
+		Bitboard const* m_pieces[colour_cnt][piece_type_cnt];
+	};
+}
+
+void PositionBatch::reserve(size_t positions)
+{
+	for (auto& colour : m_pieces)
+		for (auto& pieces : colour)
+			pieces.reserve(positions);
+	m_turns.reserve(positions);
+	m_enpassant_pawns.reserve(positions);
+	m_castlings.reserve(positions);
+}
+
+void PositionBatch::push(GameState const& state)
+{
+	Bitboard pieces[colour_cnt][piece_type_cnt] = {};
+	for (Square sq = SQ_A1; sq < SQ_CNT; ++sq) {
+		auto const& piece = state.getPieceAt(sq);
+		auto const id = piece.getType()->getId();
+		if (id != PieceTypeId::NONE)
+			pieces[static_cast<size_t>(piece.getColour())][getIndex(id)] |= squareBit(sq);
+	}
+	for (size_t c = 0; c < colour_cnt; ++c)
+		for (size_t t = 0; t < piece_type_cnt; ++t)
+			m_pieces[c][t].push_back(pieces[c][t]);
+
+	uint8_t castlings = 0;
+	for (int corner = 0; corner < castling_corner_cnt; ++corner) {
+		auto const rook = getCastlingRook(corner);
+		auto const king = getSquareRank(rook) == RK_1 ? SQ_E1 : SQ_E8;
+		if (!state.wasSquareAltered(rook) && !state.wasSquareAltered(king))
+			castlings |= static_cast<uint8_t>(1 << corner);
+	}
+
+	m_turns.push_back(static_cast<uint8_t>(state.getTurn()));
+	m_enpassant_pawns.push_back(static_cast<uint8_t>(state.getEnPassantPawn()));
+	m_castlings.push_back(castlings);
+}
+
+void PositionBatch::clear()
+{
+	for (auto& colour : m_pieces)
+		for (auto& pieces : colour)
+			pieces.clear();
+	m_turns.clear();
+	m_enpassant_pawns.clear();
+	m_castlings.clear();
+}
+
+size_t PositionBatch::size() const
+{
+	return m_turns.size();
+}
+
+Bitboard const* PositionBatch::getPieces(Colour c, PieceTypeId id) const
+{
+	return m_pieces[static_cast<size_t>(c)][getIndex(id)].data();
+}
+
+uint8_t const* PositionBatch::getTurns() const
+{
+	return m_turns.data();
+}
+
+uint8_t const* PositionBatch::getEnPassantPawns() const
+{
+	return m_enpassant_pawns.data();
+}
+
+uint8_t const* PositionBatch::getCastlings() const
+{
+	return m_castlings.data();
+}
+
+void chesslib::inCheck(PositionBatch const& batch, vector<uint8_t>& checks)
+{
+	auto const cnt = batch.size();
+	auto const turns = batch.getTurns();
+	BatchReader reader(batch);
+	checks.resize(cnt);
+
+	for (size_t i = 0; i < cnt; ++i) {
+		auto const own = static_cast<size_t>(turns[i]);
+		auto const enemy = own ^ 1;
+		auto const kings = reader.getPieces(i, own, PieceTypeId::KING);
+		// Only the first king counts, as in getCheckInfo
+		auto const king = kings & (0 - kings);
+		auto const attacked = getAttacked(reader.getAttackers(i, enemy),
+		                                  static_cast<Colour>(enemy),
+		                                  reader.getOccupied(i));
+		checks[i] = (attacked & king) != 0;
+	}
+}
+
+void chesslib::materialBalance(PositionBatch const& batch, vector<int32_t>& balances)
+{
+	auto const cnt = batch.size();
+	balances.assign(cnt, 0);
+	auto const out = balances.data();
+
+	// One pass per piece type and colour, each a plain loop over one
+	// array, which compilers can vectorise
+	for (size_t t = 0; t < piece_type_cnt; ++t) {
+		auto const id = static_cast<PieceTypeId>(t + 1);
+		auto const value = getMaterialValue(id);
+		if (value == 0)
+			continue;
+		auto const white = batch.getPieces(Colour::WHITE, id);
+		auto const black = batch.getPieces(Colour::BLACK, id);
+		for (size_t i = 0; i < cnt; ++i)
+			out[i] += value * (countBits(white[i]) - countBits(black[i]));
+	}
+}
+
+void chesslib::attackCounts(PositionBatch const& batch, Colour c, vector<uint8_t>& counts)
+{
+	auto const cnt = batch.size();
+	BatchReader reader(batch);
+	counts.resize(cnt);
+
+	auto const colour = static_cast<size_t>(c);
+	for (size_t i = 0; i < cnt; ++i) {
+		auto const attacked = getAttacked(reader.getAttackers(i, colour), c,
+		                                  reader.getOccupied(i));
+		counts[i] = static_cast<uint8_t>(countBits(attacked));
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array> // std::array
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint8_t, std::int32_t
+#include <vector> // std::vector
+
+#include "bitboard.h" // Bitboard
+#include "types.h" // Colour, PieceTypeId, Square
+
+namespace chesslib
+{
+
+	class GameState;
+
+	// Number of piece types, besides NONE
+	constexpr std::size_t piece_type_cnt = static_cast<std::size_t>(PieceTypeId::MAX) - 1;
+
+	// Number of colours
+	constexpr std::size_t colour_cnt = static_cast<std::size_t>(Colour::MAX);
+
+	// Get material value of a piece type, in pawns (kings are worth nothing,
+	// as they are never captured)
+	inline constexpr int getMaterialValue(PieceTypeId id)
+	{
+		switch (id) {
+		case PieceTypeId::PAWN:
+			return 1;
+		case PieceTypeId::KNIGHT:
+		case PieceTypeId::BISHOP:
+			return 3;
+		case PieceTypeId::ROOK:
+			return 5;
+		case PieceTypeId::QUEEN:
+			return 9;
+		default:
+			return 0;
+		}
+	}
+
+	// Many positions stored field by field, each field in an array of its
+	// own (a bitboard per piece type and colour, the turn, the en passant
+	// square and the castling rights), so that a kernel going over the
+	// batch reads memory sequentially instead of chasing the pointers
+	// of one GameState after the other.
+	class PositionBatch
+	{
+	public:
+		// Create an empty batch
+		PositionBatch() = default;
+
+		// Reserve memory for a number of positions
+		void reserve(std::size_t positions);
+
+		// Add position of a game state
+		void push(GameState const& state);
+
+		// Remove every position
+		void clear();
+
+		// Get number of positions
+		std::size_t size() const;
+
+		// Get squares of the pieces of given colour and type, by position
+		Bitboard const* getPieces(Colour c, PieceTypeId id) const;
+
+		// Get colour of the player to move, by position
+		std::uint8_t const* getTurns() const;
+
+		// Get en passant square (SQ_CNT if none), by position
+		std::uint8_t const* getEnPassantPawns() const;
+
+		// Get castling rights, by position, with one bit per castling
+		// corner (see getCastlingRook) whose rook and king were never moved
+		std::uint8_t const* getCastlings() const;
+	private:
+		std::array<std::array<std::vector<Bitboard>, piece_type_cnt>, colour_cnt> m_pieces;
+		std::vector<std::uint8_t> m_turns;
+		std::vector<std::uint8_t> m_enpassant_pawns;
+		std::vector<std::uint8_t> m_castlings;
+	};
+
+	// The kernels below fill an array with one value per position of the
+	// batch. Attacks follow GameController to the letter, including its
+	// pawns, kings and knights, which differ from those of regular chess.
+
+	// Check whether the king of the player to move is attacked
+	void inCheck(PositionBatch const& batch, std::vector<std::uint8_t>& checks);
+
+	// Get material of white minus material of black, in pawns
+	void materialBalance(PositionBatch const& batch, std::vector<std::int32_t>& balances);
+
+	// Count squares attacked by the pieces of given colour
+	void attackCounts(PositionBatch const& batch, Colour c,
+	                  std::vector<std::uint8_t>& counts);
+
+}
@@ -0,0 +1,207 @@
+#include "bitboard.h"
+
+#include <cassert>
+
+#include "event.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+namespace
+{
+	// Directions of sliding pieces, as steps in rank and file
+	// (the first four increase the square index, the others decrease it)
+	struct RayStep { int rank, file; };
+
+	const RayStep ray_steps[] = {
+		{ 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, -1 },
+		{ -1, 0 }, { 0, -1 }, { -1, -1 }, { -1, 1 },
+	};
+
+	const int ray_cnt = 8;
+
+	// Rays 0-1 and 4-5 are straight, the others are diagonal
+	bool isStraightRay(int ray)
+	{
+		return ray_steps[ray].rank == 0 || ray_steps[ray].file == 0;
+	}
+
+	struct AttackTables
+	{
+		Bitboard king[SQ_CNT];
+		Bitboard knight[SQ_CNT];
+		Bitboard pawn_pushes[2][SQ_CNT];
+		Bitboard pawn_captures[2][SQ_CNT];
+		Bitboard rays[ray_cnt][SQ_CNT];
+		Bitboard between[SQ_CNT][SQ_CNT];
+	};
+
+	// Get game state with an empty board
+	GameState makeEmptyState()
+	{
+		GameState state;
+		for (Square sq = SQ_A1; sq < SQ_CNT; ++sq)
+			state.clearSquare(sq);
+		return state;
+	}
+
+	// Get squares a piece alone at a square could move to, according to
+	// its type, optionally with an enemy piece on the destination
+	Bitboard deriveMoves(PieceTypeId id, Colour c, Square origin, bool capture)
+	{
+		auto state = makeEmptyState();
+		auto const type = getPieceTypeById(id);
+		auto const enemy = Piece(getPieceTypeById(PieceTypeId::ROOK), getOpponent(c));
+		state.setPiece(origin, Piece(type, c));
+
+		Bitboard moves = 0;
+		for (Square dest = SQ_A1; dest < SQ_CNT; ++dest) {
+			if (dest == origin)
+				continue;
+			if (capture)
+				state.setPiece(dest, enemy);
+			if (type->canApply(state, Move(origin, dest)))
+				moves |= squareBit(dest);
+			if (capture)
+				state.clearSquare(dest);
+		}
+		return moves;
+	}
+
+	AttackTables makeAttackTables()
+	{
+		AttackTables t{};
+
+		for (Square sq = SQ_A1; sq < SQ_CNT; ++sq) {
+			t.king[sq] = deriveMoves(PieceTypeId::KING, Colour::WHITE, sq, false);
+			t.knight[sq] = deriveMoves(PieceTypeId::KNIGHT, Colour::WHITE, sq, false);
+			for (auto c : { Colour::WHITE, Colour::BLACK }) {
+				auto const i = static_cast<int>(c);
+				t.pawn_pushes[i][sq] = deriveMoves(PieceTypeId::PAWN, c, sq, false);
+				t.pawn_captures[i][sq] = deriveMoves(PieceTypeId::PAWN, c, sq, true);
+			}
+		}
+
+		for (int ray = 0; ray < ray_cnt; ++ray) {
+			auto const step = ray_steps[ray];
+			for (Square sq = SQ_A1; sq < SQ_CNT; ++sq) {
+				int rank = getSquareRank(sq) + step.rank;
+				int file = getSquareFile(sq) + step.file;
+				Bitboard between = 0;
+				while (RankCheck(static_cast<Rank>(rank)) &&
+				       FileCheck(static_cast<File>(file))) {
+					auto dest = getSquare(static_cast<Rank>(rank),
+					                      static_cast<File>(file));
+					t.rays[ray][sq] |= squareBit(dest);
+					t.between[sq][dest] = between;
+					between |= squareBit(dest);
+					rank += step.rank;
+					file += step.file;
+				}
+			}
+		}
+
+		return t;
+	}
+
+	AttackTables const& getAttackTables()
+	{
+		static const AttackTables tables = makeAttackTables();
+		return tables;
+	}
+
+	Square getLastSquare(Bitboard bb)
+	{
+		assert(bb != 0);
+#if defined(__GNUC__)
+		return static_cast<Square>(63 - __builtin_clzll(bb));
+#else
+		int sq = 63;
+		while (!((bb >> sq) & 1))
+			--sq;
+		return static_cast<Square>(sq);
+#endif
+	}
+
+	// Get the squares along a ray up to and including the first occupied one
+	Bitboard getRayMoves(AttackTables const& t, int ray, Square sq, Bitboard occupied)
+	{
+		auto const moves = t.rays[ray][sq];
+		auto const blockers = moves & occupied;
+		if (blockers == 0)
+			return moves;
+		auto const blocker = ray < 4 ? getFirstSquare(blockers) : getLastSquare(blockers);
+		return moves ^ t.rays[ray][blocker];
+	}
+
+	Bitboard getSliderMoves(Square sq, Bitboard occupied, bool straight, bool diagonal)
+	{
+		auto const& t = getAttackTables();
+		Bitboard moves = 0;
+		for (int ray = 0; ray < ray_cnt; ++ray)
+			if (isStraightRay(ray) ? straight : diagonal)
+				moves |= getRayMoves(t, ray, sq, occupied);
+		return moves;
+	}
+}
+
+Bitboard chesslib::getKingMoves(Square sq)
+{
+	return getAttackTables().king[sq];
+}
+
+Bitboard chesslib::getKnightMoves(Square sq)
+{
+	return getAttackTables().knight[sq];
+}
+
+Bitboard chesslib::getPawnPushes(Colour c, Square sq)
+{
+	return getAttackTables().pawn_pushes[static_cast<int>(c)][sq];
+}
+
+Bitboard chesslib::getPawnCaptures(Colour c, Square sq)
+{
+	return getAttackTables().pawn_captures[static_cast<int>(c)][sq];
+}
+
+Bitboard chesslib::getBishopMoves(Square sq, Bitboard occupied)
+{
+	return getSliderMoves(sq, occupied, false, true);
+}
+
+Bitboard chesslib::getRookMoves(Square sq, Bitboard occupied)
+{
+	return getSliderMoves(sq, occupied, true, false);
+}
+
+Bitboard chesslib::getQueenMoves(Square sq, Bitboard occupied)
+{
+	return getSliderMoves(sq, occupied, true, true);
+}
+
+Bitboard chesslib::getAttacks(PieceTypeId id, Colour c, Square sq, Bitboard occupied)
+{
+	switch (id) {
+	case PieceTypeId::PAWN:
+		return getPawnCaptures(c, sq);
+	case PieceTypeId::KING:
+		return getKingMoves(sq);
+	case PieceTypeId::QUEEN:
+		return getQueenMoves(sq, occupied);
+	case PieceTypeId::BISHOP:
+		return getBishopMoves(sq, occupied);
+	case PieceTypeId::KNIGHT:
+		return getKnightMoves(sq);
+	case PieceTypeId::ROOK:
+		return getRookMoves(sq, occupied);
+	default:
+		return 0;
+	}
+}
+
+Bitboard chesslib::getSquaresBetween(Square a, Square b)
+{
+	return getAttackTables().between[a][b];
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint> // std::uint64_t
+
+#include "types.h" // Square, Colour, PieceTypeId
+
+namespace chesslib
+{
+
+	// A set of squares, one bit per square (bit 0 is a1, bit 63 is h8)
+	using Bitboard = std::uint64_t;
+
+	// Get bitboard with a single square
+	inline constexpr Bitboard squareBit(Square sq)
+	{
+		return Bitboard(1) << static_cast<int>(sq);
+	}
+
+	// Check whether square is in bitboard
+	inline constexpr bool hasSquare(Bitboard bb, Square sq)
+	{
+		return (bb >> static_cast<int>(sq)) & 1;
+	}
+
+	// Count squares in bitboard
+	inline int countSquares(Bitboard bb)
+	{
+#if defined(__GNUC__)
+		return __builtin_popcountll(bb);
+#else
+		int count = 0;
+		for (; bb; bb &= bb - 1)
+			++count;
+		return count;
+#endif
+	}
+
+	// Get lowest square in a non-empty bitboard
+	inline Square getFirstSquare(Bitboard bb)
+	{
+#if defined(__GNUC__)
+		return static_cast<Square>(__builtin_ctzll(bb));
+#else
+		int sq = 0;
+		while (!((bb >> sq) & 1))
+			++sq;
+		return static_cast<Square>(sq);
+#endif
+	}
+
+	// Remove and get lowest square in a non-empty bitboard
+	inline Square popFirstSquare(Bitboard& bb)
+	{
+		auto sq = getFirstSquare(bb);
+		bb &= bb - 1;
+		return sq;
+	}
+
+	// The squares each piece type can reach are derived once from the rules
+	// themselves (PieceType::canApply), so that any code working with these
+	// bitboards agrees with GameController on what a legal move is.
+	// Sliding pieces are the exception, as their reach depends on the
+	// occupancy, which is why they are calculated ray by ray instead.
+
+	// Get squares a king at the given square can move to
+	Bitboard getKingMoves(Square sq);
+
+	// Get squares a knight at the given square can move to
+	Bitboard getKnightMoves(Square sq);
+
+	// Get empty squares a pawn of given colour at the given square can move to
+	Bitboard getPawnPushes(Colour c, Square sq);
+
+	// Get occupied squares a pawn of given colour at the given square can capture
+	Bitboard getPawnCaptures(Colour c, Square sq);
+
+	// Get squares a bishop at the given square can move to (or capture at),
+	// given the occupied squares
+	Bitboard getBishopMoves(Square sq, Bitboard occupied);
+
+	// Get squares a rook at the given square can move to (or capture at),
+	// given the occupied squares
+	Bitboard getRookMoves(Square sq, Bitboard occupied);
+
+	// Get squares a queen at the given square can move to (or capture at),
+	// given the occupied squares
+	Bitboard getQueenMoves(Square sq, Bitboard occupied);
+
+	// Get squares a piece of given type and colour at the given square can
+	// capture at, given the occupied squares
+	Bitboard getAttacks(PieceTypeId id, Colour c, Square sq, Bitboard occupied);
+
+	// Get the squares strictly between two squares on the same rank, file
+	// or diagonal (empty if they are not aligned)
+	Bitboard getSquaresBetween(Square a, Square b);
+
+}
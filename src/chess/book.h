@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint> // std::uint16_t, std::uint64_t
+#include <filesystem> // std::filesystem::path
+#include <optional> // std::optional
+#include <random> // std::mt19937_64
+#include <vector> // std::vector
+
+#include "event.h" // EventRecord
+#include "mapping.h" // MappedFile
+
+namespace chesslib
+{
+
+	class GameState;
+
+	// Calculate the Polyglot key of a game state, with the random numbers
+	// of the Polyglot book format specification
+	std::uint64_t getPolyglotKey(GameState const& state);
+
+	// A move suggested by the opening book
+	struct BookMove
+	{
+		EventRecord record;
+		std::uint16_t weight;
+	};
+
+	// Opening book in the Polyglot format: a file of 16-byte entries (key,
+	// move, weight and learning data, all big-endian) sorted by key.
+	// The file is memory mapped, so opening it is immediate and its pages
+	// are shared by all processes that use the same book.
+	//
+	// Moves are returned as written in the book, so it is up to the caller
+	// to check whether they are valid in the game state.
+	class OpeningBook
+	{
+	public:
+		// Open book file
+		// Returns true on success
+		bool open(std::filesystem::path const& path);
+
+		// Close book file
+		void close();
+
+		// Check whether a book file is open
+		bool isOpen() const;
+
+		// Get number of entries in the book
+		std::size_t size() const;
+
+		// Find all moves for the game state (empty if out of book)
+		std::vector<BookMove> find(GameState const& state) const;
+
+		// Pick one of the moves for the game state at random, with
+		// probability proportional to its weight
+		// Returns nullopt if out of book
+		std::optional<EventRecord> pick(GameState const& state,
+		                                std::mt19937_64& rng) const;
+	private:
+		// Decode entry of the book as a move in the game state
+		std::optional<EventRecord> decode(GameState const& state,
+		                                  std::uint16_t move) const;
+	private:
+		MappedFile m_file;
+	};
+
+}
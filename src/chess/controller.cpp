@@ -1,36 +1,43 @@
 #include "controller.h"
 
+#include <algorithm>
 #include <cassert>
 
 #include "error.h"
 #include "event.h"
+#include "latency.h"
 #include "listener.h"
+#include "observer.h"
 #include "state.h"
+#include "statistics.h"
+#include "trace.h"
 
 using namespace std;
 using namespace chesslib;
 
-class DummyGameListener : public GameListener
-{
-	PieceTypeId promotePawn(GameController const& gameController,
-	                        Square pawn) override
-	{
-		return PieceTypeId::QUEEN;
-	}
-
-	void catchError(GameController const& gameController,
-	                GameError err) override {}
-};
-
 GameController::GameController(unique_ptr<GameState> gameStatePtr,
                                shared_ptr<GameListener> listener) :
 	m_state(move(gameStatePtr)),
-	m_listener(listener)
-{}
+	m_listener(listener),
+	m_ply(0),
+	m_pending_record(),
+	m_pending_pawn(SQ_CNT),
+	m_legal_moves()
+{
+	clearMoveCache();
+}
 
 GameController::GameController(GameController const& other) :
 	m_state(make_unique<GameState>(*other.m_state)),
-	m_listener(m_listener)
+	m_listener(other.m_listener),
+	m_history(other.m_history),
+	m_ply(other.m_ply),
+	m_pending_record(other.m_pending_record),
+	m_pending_pawn(other.m_pending_pawn),
+	m_legal_moves(other.m_legal_moves),
+	m_legal_moves_known(other.m_legal_moves_known),
+	m_check_info(other.m_check_info),
+	m_check_info_known(other.m_check_info_known)
 {}
 
 GameState const& GameController::getState() const
@@ -38,137 +45,356 @@ GameState const& GameController::getState() const
 	return *m_state;
 }
 
-void GameController::clearListener()
+bool GameController::isInCheck() const
 {
-	m_listener = make_shared<DummyGameListener>();
+	return getCheckInfo().checkers != 0;
 }
 
-bool GameController::inCheck(Colour c) const
+CheckInfo const& GameController::getCheckInfo() const
 {
-	assert(ColourCheck(c));
-	auto king_sq = getKingSquare(c);
+	if (!m_check_info_known) {
+		CHESS_COUNT(IN_CHECK);
+		m_check_info = chesslib::getCheckInfo(*m_state);
+		m_check_info_known = true;
+	}
+	return m_check_info;
+}
 
-	for (Square attacker_sq = SQ_A1; attacker_sq < SQ_CNT; ++attacker_sq) {
-		Move attack(attacker_sq, king_sq);
-		if (attack.isValidCheck(*m_state))
-			return true;
+bool GameController::update(shared_ptr<GameEvent> e)
+{
+	CHESS_COUNT(UPDATE);
+	LatencyTimer timer(Operation::UPDATE);
+	CHESS_TRACE_SCOPE("update");
+	if (isUpdatePending() || !canUpdate(e))
+		return false;
+
+	auto record = e->getRecord();
+	beginUpdate(record);
+	record.promotion = lookForPromotion();
+	finishUpdate(record);
+	return true;
+}
+
+UpdateStatus GameController::updateAsync(shared_ptr<GameEvent> e)
+{
+	CHESS_COUNT(UPDATE);
+	LatencyTimer timer(Operation::UPDATE);
+	CHESS_TRACE_SCOPE("update");
+	if (isUpdatePending() || !canUpdate(e))
+		return UpdateStatus::REJECTED;
+
+	auto const record = e->getRecord();
+	beginUpdate(record);
+
+	auto const pawn = findPromotion();
+	if (pawn != SQ_CNT) {
+		m_pending_record = record;
+		m_pending_pawn = pawn;
+		return UpdateStatus::PENDING;
 	}
 
-	return false;
+	finishUpdate(record);
+	return UpdateStatus::APPLIED;
+}
+
+UpdateStatus GameController::resumeUpdate(PieceTypeId promotion)
+{
+	if (!isUpdatePending())
+		return UpdateStatus::REJECTED;
+
+	CHESS_COUNT(PROMOTION);
+	if (promotion == PieceTypeId::NONE ||
+		promotion == PieceTypeId::PAWN ||
+		promotion == PieceTypeId::KING ||
+		!PieceTypeIdCheck(promotion))
+	{
+		raiseError(GameError::ILLEGAL_PROMOTION);
+		return UpdateStatus::PENDING;
+	}
+
+	LatencyTimer timer(Operation::UPDATE);
+	CHESS_TRACE_SCOPE("update");
+	auto& pawn = m_state->getPieceAt(m_pending_pawn);
+	m_state->setPiece(m_pending_pawn, Piece(getPieceTypeById(promotion),
+	                                        pawn.getColour()));
+
+	auto record = m_pending_record;
+	record.promotion = promotion;
+	m_pending_pawn = SQ_CNT;
+	finishUpdate(record);
+	return UpdateStatus::APPLIED;
 }
 
-Square GameController::getKingSquare(Colour c) const
+bool GameController::isUpdatePending() const
 {
-	assert(ColourCheck(c));
-	auto king_sq_opt = m_state->getBoard().find(PieceTypeId::KING, c);
-	assert(king_sq_opt); // all kings must be on the board
-	return *king_sq_opt;
+	return m_pending_pawn != SQ_CNT;
 }
 
-bool GameController::update(shared_ptr<GameEvent> e)
+Square GameController::getPendingPromotion() const
+{
+	return m_pending_pawn;
+}
+
+void GameController::beginUpdate(EventRecord const& record)
+{
+	// Drop events that could be redone, without releasing memory
+	m_history.resize(m_ply);
+	m_history.emplace_back();
+	beginEvent(*m_state, record, m_history.back());
+	clearMoveCache();
+}
+
+void GameController::finishUpdate(EventRecord const& record)
 {
-	if (!canUpdate(e))
+	finishEvent(*m_state, record, m_history.back());
+	clearMoveCache();
+	++m_ply;
+
+	lookForCheckmate();
+	lookForDraw();
+
+	notifyEventApplied(record);
+}
+
+bool GameController::undo()
+{
+	if (isUpdatePending()) {
+		// The event was never finished, so nobody knows about it
+		auto& undo = m_history.back();
+		finishEvent(*m_state, m_pending_record, undo);
+		revertEvent(*m_state, undo);
+		m_history.pop_back();
+		m_pending_pawn = SQ_CNT;
+		clearMoveCache();
+		return true;
+	}
+
+	if (m_ply == 0)
 		return false;
 
-	const auto enpassant_before = m_state->getEnPassantPawn();
+	auto const& undo = m_history[--m_ply];
 
-	e->apply(*m_state);
+	revertEvent(*m_state, undo);
+	clearMoveCache();
 
-	if (enpassant_before == m_state->getEnPassantPawn())
-		m_state->clearEnPassantPawn();
+	notifyEventUndone(undo.event);
 
-	lookForPromotion();
+	return true;
+}
 
-	m_state->nextTurn();
+bool GameController::redo()
+{
+	if (isUpdatePending() || m_ply == m_history.size())
+		return false;
+
+	auto& undo = m_history[m_ply];
+	auto const record = undo.event;
+
+	applyEvent(*m_state, record, undo);
+	clearMoveCache();
+	++m_ply;
 
 	lookForCheckmate();
+	lookForDraw();
+
+	notifyEventApplied(record);
 
 	return true;
 }
 
-void GameController::lookForPromotion()
+size_t GameController::getPly() const
+{
+	return m_ply;
+}
+
+void GameController::reserveHistory(size_t plies)
+{
+	m_history.reserve(plies);
+}
+
+template<Colour C>
+Square GameController::findPromotion() const
 {
-	Rank last_rank = (m_state->getTurn() == Colour::WHITE) ? RK_8 : RK_1;
 	for (File f = FL_A; f < FL_CNT; ++f) {
-		Square sq = getSquare(last_rank, f);
-		auto& piece = m_state->getPieceAt(sq);
-		if (piece.getType()->getId() == PieceTypeId::PAWN) {
-			PieceTypeId new_type;
-			while(true) {
-				new_type = m_listener->promotePawn(*this, sq);
-				if (new_type == PieceTypeId::NONE ||
-					new_type == PieceTypeId::PAWN ||
-					new_type == PieceTypeId::KING)
-				{
-					raiseError(GameError::ILLEGAL_PROMOTION);
-				}
-				else
-				{
-					break;
-				}
-			}
-			piece.setType(new_type);
-			return;
+		Square sq = getSquare(ColourTraits<C>::promotion_rank, f);
+		if (m_state->getPieceAt(sq).getType()->getId() == PieceTypeId::PAWN)
+			return sq;
+	}
+	return SQ_CNT;
+}
+
+Square GameController::findPromotion() const
+{
+	if (m_state->getTurn() == Colour::WHITE)
+		return findPromotion<Colour::WHITE>();
+	else
+		return findPromotion<Colour::BLACK>();
+}
+
+PieceTypeId GameController::lookForPromotion()
+{
+	auto const sq = findPromotion();
+	if (sq == SQ_CNT)
+		return PieceTypeId::NONE;
+
+	auto& piece = m_state->getPieceAt(sq);
+	PieceTypeId new_type;
+	while(true) {
+		CHESS_COUNT(PROMOTION);
+		new_type = m_listener->promotePawn(*this, sq);
+		if (new_type == PieceTypeId::NONE ||
+			new_type == PieceTypeId::PAWN ||
+			new_type == PieceTypeId::KING)
+		{
+			raiseError(GameError::ILLEGAL_PROMOTION);
+		}
+		else
+		{
+			break;
 		}
 	}
+	m_state->setPiece(sq, Piece(getPieceTypeById(new_type),
+	                            piece.getColour()));
+	return new_type;
+}
+
+bool GameController::hasLegalMoves() const
+{
+	CHESS_COUNT(CHECKMATE_SCAN);
+	// Castling alone does not keep a player from being checkmated
+	for (auto dests : getLegalMoves().destinations)
+		if (dests != 0)
+			return true;
+	return false;
 }
 
 void GameController::lookForCheckmate()
 {
+	LatencyTimer timer(Operation::CHECKMATE_SEARCH);
+	CHESS_TRACE_SCOPE("lookForCheckmate");
+	if (hasLegalMoves())
+		return;
 	const Colour c = m_state->getTurn();
-	for (Square piece_sq = SQ_A1; piece_sq < SQ_CNT; ++piece_sq) {
-		auto const& p = m_state->getPieceAt(piece_sq);
-		if (p.getColour() != c)
-			continue;
-		for (Square dest_sq = SQ_A1; dest_sq < SQ_CNT; ++dest_sq) {
-			auto move = make_shared<Move>(piece_sq, dest_sq);
-			if (canUpdate(move))
-				return;
-		}
-	}
-	if (c == Colour::WHITE)
+	if (!isInCheck()) {
+		m_state->setPhase(Phase::DRAW);
+		m_state->setDrawReason(DrawReason::STALEMATE);
+	} else if (c == Colour::WHITE) {
 		m_state->setPhase(Phase::BLACK_WON);
-	else
+	} else {
 		m_state->setPhase(Phase::WHITE_WON);
+	}
 }
 
-bool GameController::canUpdate(shared_ptr<GameEvent> e) const
+void GameController::lookForDraw()
 {
 	if (m_state->getPhase() != Phase::RUNNING)
+		return;
+
+	auto reason = DrawReason::NONE;
+	if (m_state->getHalfmoveClock() >= 100)
+		reason = DrawReason::FIFTY_MOVE_RULE;
+	else if (countRepetitions() >= 3)
+		reason = DrawReason::REPETITION;
+
+	if (reason != DrawReason::NONE) {
+		m_state->setPhase(Phase::DRAW);
+		m_state->setDrawReason(reason);
+	}
+}
+
+unsigned int GameController::countRepetitions() const
+{
+	auto const hash = m_state->getHash();
+	auto const depth = min<size_t>(m_state->getHalfmoveClock(), m_ply);
+	unsigned int count = 1;
+	// Positions with the same player to move are two plies apart
+	for (size_t back = 2; back <= depth; back += 2)
+		if (m_history[m_ply - back].hash == hash)
+			++count;
+	return count;
+}
+
+bool GameController::canUpdate(shared_ptr<GameEvent> e) const
+{
+	CHESS_COUNT(CAN_UPDATE);
+	auto const record = e->getRecord();
+	switch (record.id) {
+	case GameEventId::MOVE:
+		if (!SquareCheck(record.origin) || !SquareCheck(record.dest))
+			return false;
+		return hasSquare(getLegalMoves().destinations[record.origin], record.dest);
+	case GameEventId::CASTLING:
+	{
+		auto const corner = getCastlingCorner(record.origin);
+		if (corner < 0)
+			return false;
+		return (getLegalMoves().castlings & (1 << corner)) != 0;
+	}
+	default:
+		return checkEvent(e);
+	}
+}
+
+LegalMoves const& GameController::getLegalMoves() const
+{
+	if (!m_legal_moves_known) {
+		CHESS_COUNT(MOVE_CACHE_MISS);
+		CHESS_TRACE_SCOPE("generateLegalMoves");
+		if (m_state->getPhase() == Phase::RUNNING && !isUpdatePending()) {
+			generateLegalMoves(*m_state, getCheckInfo(), m_legal_moves);
+		} else {
+			m_legal_moves.destinations.fill(0);
+			m_legal_moves.castlings = 0;
+		}
+		m_legal_moves_known = true;
+	}
+	return m_legal_moves;
+}
+
+Bitboard GameController::getLegalDestinations(Square origin) const
+{
+	if (!SquareCheck(origin))
+		return 0;
+	return getLegalMoves().destinations[origin];
+}
+
+bool GameController::checkEvent(shared_ptr<GameEvent> e) const
+{
+	CHESS_TRACE_SCOPE("canUpdate");
+	if (m_state->getPhase() != Phase::RUNNING || isUpdatePending())
 		return false;
 
 	if (!e->isValid(*m_state))
 		return false;
 
-	if (wouldEventCauseCheck(e))
+	if (!isKingSafeAfter(*m_state, getCheckInfo(), e->getRecord()))
 		return false;
 
 	return true;
 }
 
-bool GameController::wouldEventCauseCheck(shared_ptr<GameEvent> e) const
+void GameController::clearMoveCache()
 {
-	return simulate([e] (auto g) {
-		e->apply(*g.m_state);
-		auto turn = g.m_state->getTurn();
-		g.m_state->nextTurn();
-		return g.inCheck(turn);
-	});
-}
-
-bool GameController::simulate(simulationCallback cb) const
-{
-	auto copy = GameController(*this);
-	copy.clearListener();
-	return cb(copy);
+	m_legal_moves_known = false;
+	m_check_info_known = false;
 }
 
 bool GameController::load(istream& is)
 {
+	LatencyTimer timer(Operation::LOAD);
 	try
 	{
-		m_state->load(is);
+		// The state is read aside, so that a failed load changes nothing
+		GameState loaded;
+		loaded.load(is);
+		*m_state = loaded;
+		clearMoveCache();
+		m_history.clear();
+		m_ply = 0;
+		m_pending_pawn = SQ_CNT;
 		lookForCheckmate();
+		lookForDraw();
+		notifyStateReset();
 		return true;
 	}
 	catch (GameError err)
@@ -181,6 +407,7 @@ bool GameController::load(istream& is)
 
 bool GameController::save(ostream& os) const
 {
+	LatencyTimer timer(Operation::SAVE);
 	m_state->save(os);
 	return true;
 }
@@ -189,3 +416,33 @@ void GameController::raiseError(GameError err) const
 {
 	m_listener->catchError(*this, err);
 }
+
+void GameController::addObserver(shared_ptr<GameObserver> observer)
+{
+	m_observers.push_back(observer);
+	observer->onStateReset(*this);
+}
+
+void GameController::removeObserver(shared_ptr<GameObserver> observer)
+{
+	m_observers.erase(remove(m_observers.begin(), m_observers.end(), observer),
+	                  m_observers.end());
+}
+
+void GameController::notifyEventApplied(EventRecord const& record) const
+{
+	for (auto const& observer : m_observers)
+		observer->onEventApplied(*this, record);
+}
+
+void GameController::notifyEventUndone(EventRecord const& record) const
+{
+	for (auto const& observer : m_observers)
+		observer->onEventUndone(*this, record);
+}
+
+void GameController::notifyStateReset() const
+{
+	for (auto const& observer : m_observers)
+		observer->onStateReset(*this);
+}
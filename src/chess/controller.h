@@ -2,10 +2,15 @@
 
 #include <memory> // std::unique_ptr, std::shared_ptr
 #include <iosfwd> // std::istream, std::ostream
-#include <functional> // std::function
+#include <vector> // std::vector
 
+#include "bitboard.h" // Bitboard
 #include "error.h" // GameError
-#include "types.h" // Colour, Square
+#include "event.h" // EventRecord
+#include "history.h" // UndoRecord
+#include "legality.h" // CheckInfo
+#include "movegen.h" // LegalMoves
+#include "types.h" // Colour, Square, PieceTypeId
 
 namespace chesslib
 {
@@ -13,6 +18,15 @@ namespace chesslib
 	class GameEvent;
 	class GameState;
 	class GameListener;
+	class GameObserver;
+
+	// Outcome of an update that may wait for a promotion
+	enum class UpdateStatus
+	{
+		REJECTED, // the event is not legal (or nothing was pending)
+		APPLIED, // the event was applied
+		PENDING, // a pawn is waiting to be promoted
+	};
 
 	// This is the class responsible for controlling the chess game
 	// state behing some business logic, fed with GameEvents.
@@ -25,55 +39,153 @@ namespace chesslib
 		               std::shared_ptr<GameListener> listener);
 
 		// Copy a game controller, which copies the game state and
-		// shares the same listener
+		// shares the same listener (observers are not copied)
 		GameController(GameController const& other);
 
 		// Get current game state
 		GameState const& getState() const;
 
+		// Check whether game state can be updated with event, that is,
+		// so that the player tha makes the move doesn't put himself in check
+		// The answer is cached until the game state changes, so asking
+		// again about the same position is a lookup.
+		bool canUpdate(std::shared_ptr<GameEvent> e) const;
+
+		// Get every legal event of the player whose turn it is
+		// (cached like canUpdate)
+		LegalMoves const& getLegalMoves() const;
+
+		// Get squares the piece at the given square can legally move to
+		// (cached like canUpdate)
+		Bitboard getLegalDestinations(Square origin) const;
+
 		// Update game state with a game event
 		// Returns true on success
 		bool update(std::shared_ptr<GameEvent> event);
 
-		// Load game state from input stream
+		// Update game state with a game event, without asking the listener
+		// to promote a pawn: the update stops halfway instead, returning
+		// PENDING, and is finished by resumeUpdate whenever the piece type
+		// is known. Until then, the game state shows the pawn on the last
+		// rank, no other event can be applied and observers are not told.
+		// This way a thread is not held up while a player makes up their
+		// mind, and can go on with other games meanwhile.
+		UpdateStatus updateAsync(std::shared_ptr<GameEvent> event);
+
+		// Finish the pending update, promoting the pawn to the piece type
+		// Returns APPLIED, PENDING if the piece type cannot be promoted
+		// to (which is reported to the listener), or REJECTED if no update
+		// is pending
+		UpdateStatus resumeUpdate(PieceTypeId promotion);
+
+		// Check whether an update is waiting for a promotion
+		bool isUpdatePending() const;
+
+		// Get square of the pawn waiting to be promoted (SQ_CNT if none)
+		Square getPendingPromotion() const;
+
+		// Take back the last event applied, or the pending update
+		// Returns true on success
+		bool undo();
+
+		// Apply again the last event taken back
 		// Returns true on success
+		bool redo();
+
+		// Get number of events applied since the game state was loaded
+		// (not counting the ones that were taken back)
+		std::size_t getPly() const;
+
+		// Reserve room for the history of events, so that neither update
+		// nor redo allocate memory until this number of plies is exceeded
+		void reserveHistory(std::size_t plies);
+
+		// Check whether the player whose turn it is is in check
+		bool isInCheck() const;
+
+		// Check whether the player whose turn it is can make any move
+		bool hasLegalMoves() const;
+
+		// Load game state from input stream, which also clears the history
+		// Returns true on success, and leaves the game untouched otherwise
 		bool load(std::istream& is);
 
 		// Save game state to output stream
 		// Returns true on success
 		bool save(std::ostream& os) const;
+
+		// Attach an observer, which is immediately informed of
+		// the current game state
+		void addObserver(std::shared_ptr<GameObserver> observer);
+
+		// Detach an observer
+		void removeObserver(std::shared_ptr<GameObserver> observer);
 	private:
-		// Replace listener with a dummy one
-		void clearListener();
+		// Get checks and pins of the current game state (cached)
+		CheckInfo const& getCheckInfo() const;
+
+		// Start applying a legal event, keeping it in the history
+		void beginUpdate(EventRecord const& record);
+
+		// Finish applying an event, with its promotion, and look for
+		// the end of the game
+		void finishUpdate(EventRecord const& record);
 
-		// Check whether player of colour c is in check
-		bool inCheck(Colour c) const;
+		// Find pawn of the player to move on the last rank
+		// Returns its square, or SQ_CNT if there is none
+		Square findPromotion() const;
 
-		// Obtain square in which the king of colour c is located on
-		Square getKingSquare(Colour c) const;
+		// Find pawn of colour C, the player to move, on its last rank
+		template<Colour C>
+		Square findPromotion() const;
 
 		// Look for a pawn that should be promoted instantly
-		void lookForPromotion();
+		// Returns the piece type it was promoted to, or NONE
+		PieceTypeId lookForPromotion();
 
-		// Look for a checkmate that occurred immediately
+		// Look for a checkmate (or stalemate) that occurred immediately
 		void lookForCheckmate();
 
-		// Check whether game state can be updated with event, that is,
-		// so that the player tha makes the move doesn't put himself in check
-		bool canUpdate(std::shared_ptr<GameEvent> e) const;
+		// Look for a draw by the fifty-move rule or by repetition
+		void lookForDraw();
+
+		// Count how many times the current position has occurred, looking
+		// back in the history only up to the last irreversible event
+		unsigned int countRepetitions() const;
 
-		// Check whether after an event would cause a check
-		bool wouldEventCauseCheck(std::shared_ptr<GameEvent> e) const;
+		// Check whether game state can be updated with event, bypassing
+		// the cache of legal moves
+		bool checkEvent(std::shared_ptr<GameEvent> e) const;
+
+		// Forget the legal moves, checks and pins of the previous game state
+		void clearMoveCache();
 
 		// Raise a game error to the listener
 		void raiseError(GameError err) const;
 
-		// Simulate a predicate with a clone of this controller
-		using simulationCallback = std::function<bool(GameController&)>;
-		bool simulate(simulationCallback cb) const;
+		// Inform observers that an event was applied
+		void notifyEventApplied(EventRecord const& record) const;
+
+		// Inform observers that an event was taken back
+		void notifyEventUndone(EventRecord const& record) const;
+
+		// Inform observers that the game state was replaced
+		void notifyStateReset() const;
 	private:
 		std::unique_ptr<GameState> m_state;
 		std::shared_ptr<GameListener> m_listener;
+		std::vector<std::shared_ptr<GameObserver>> m_observers;
+		std::vector<UndoRecord> m_history; // also holds events to be redone
+		std::size_t m_ply;
+		EventRecord m_pending_record; // update waiting for a promotion
+		Square m_pending_pawn; // SQ_CNT if no update is pending
+
+		// Legal moves, checks and pins of the current game state,
+		// calculated on first use
+		mutable LegalMoves m_legal_moves;
+		mutable bool m_legal_moves_known;
+		mutable CheckInfo m_check_info;
+		mutable bool m_check_info_known;
 	};
 
 }
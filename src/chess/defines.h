@@ -3,7 +3,7 @@
 namespace chesslib
 {
 	constexpr auto major_version = 1;
-	constexpr auto minor_version = 1;
+	constexpr auto minor_version = 2;
 }
 
 #if defined(_MSC_VER)
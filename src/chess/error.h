@@ -28,6 +28,10 @@ namespace chesslib
 
 		// Invalid piece type
 		IO_PIECE_TYPE,
+
+		// State ends, or holds something that is not a number, before
+		// it is complete
+		IO_TRUNCATED,
 	};
 
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include "event.h"
 
+#include "history.h"
 #include "state.h"
 
+using namespace std;
 using namespace chesslib;
 
 Move::Move(Square origin, Square dest) :
@@ -59,40 +61,49 @@ Square Move::getDestination() const
 	return dest;
 }
 
-void Move::apply(GameState& game)
+EventRecord Move::getRecord() const
 {
-	auto destpiece = game.getPieceAt(dest);
+	return EventRecord{ GameEventId::MOVE, origin, dest, PieceTypeId::NONE };
+}
 
+void Move::apply(GameState& game)
+{
 	game.movePiece(origin, dest);
 
+	// The piece that has just moved (not the one it captured)
+	auto const& destpiece = game.getPieceAt(dest);
 	destpiece.getType()->afterApplied(game, *this);
 }
 
+// Pawns advance one square forward onto an empty square, or two
+// from their initial rank, and capture one square diagonally forward
+// (en passant included)
+template<Colour C>
+static bool canPawnApply(GameState const& g, Square orig, Square dest)
+{
+	using Traits = ColourTraits<C>;
+	Direction const dir = dest - orig;
+	auto const enpassant_sq = static_cast<Square>(g.getEnPassantPawn());
+
+	if (g.getPieceAt(dest).isClear() && enpassant_sq != dest) {
+		return dir == Traits::forward ||
+		       (getSquareRank(orig) == Traits::pawn_rank &&
+		        dir == Traits::forward * 2);
+	} else {
+		return dir == Traits::forward + DIR_EAST ||
+		       dir == Traits::forward + DIR_WEST;
+	}
+}
+
 bool Pawn::canApply(GameState const& g, Move const& m) const
 {
 	auto orig = m.getOrigin();
 	auto dest = m.getDestination();
-	Direction white_dir = dest - orig;
-	auto white_orig = orig;
-	auto const& origpiece = g.getPieceAt(orig);
-	auto const& destpiece = g.getPieceAt(dest);
-
-	if (origpiece.getColour() == Colour::BLACK) {
-		white_orig = ~white_orig;
-		white_dir = -white_dir;
-	}
 
-	auto enpassant = g.getEnPassantPawn();
-	auto enpassant_sq = static_cast<Square>(enpassant);
-
-	if (destpiece.isClear() && enpassant_sq != dest) {
-		return (getSquareRank(white_orig) == RK_2 &&
-			    white_dir == DIR_NORTH * 2) ||
-			   white_dir == DIR_NORTH;
-	} else {
-		return white_dir == DIR_NORTHEAST ||
-			   white_dir == DIR_NORTHWEST;
-	}
+	if (g.getPieceAt(orig).getColour() == Colour::WHITE)
+		return canPawnApply<Colour::WHITE>(g, orig, dest);
+	else
+		return canPawnApply<Colour::BLACK>(g, orig, dest);
 }
 
 bool King::canApply(GameState const& g, Move const& m) const
@@ -289,13 +300,8 @@ void Pawn::afterApplied(GameState& g, Move const& m) const
 	} else {
 		if (g.hasEnPassant()) {
 			Square enpassant = g.getEnPassantPawn();
-			if (enpassant == m.getDestination()) {
-				if (getSquareRank(enpassant) == RK_3)
-					enpassant += DIR_NORTH; // White pawn
-				else
-					enpassant += DIR_SOUTH; // Black pawn
-				g.clearSquare(enpassant);
-			}
+			if (enpassant == m.getDestination())
+				g.clearSquare(getEnPassantVictim(enpassant));
 		}
 	}
 }
@@ -304,6 +310,11 @@ Castling::Castling(Square rook) : rook(rook) {}
 
 Square Castling::getRookSquare() const { return rook; }
 
+EventRecord Castling::getRecord() const
+{
+	return EventRecord{ GameEventId::CASTLING, rook, SQ_CNT, PieceTypeId::NONE };
+}
+
 bool Castling::isValid(GameState const& game)
 {
 	// Rook must be in one of the four corners of the board
@@ -353,3 +364,15 @@ void Castling::apply(GameState& game)
 	Move(king, king_dest).apply(game);
 	Move(rook, rook_dest).apply(game);
 }
+
+shared_ptr<GameEvent> chesslib::makeEvent(EventRecord const& record)
+{
+	switch (record.id) {
+	case GameEventId::MOVE:
+		return make_shared<Move>(record.origin, record.dest);
+	case GameEventId::CASTLING:
+		return make_shared<Castling>(record.origin);
+	default:
+		return nullptr;
+	}
+}
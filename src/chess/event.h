@@ -1,12 +1,34 @@
 #pragma once
 
-#include "types.h" // Square
+#include <memory> // std::shared_ptr
+
+#include "types.h" // Square, PieceTypeId
 
 namespace chesslib
 {
 
 	class GameState;
 
+	// Identifies the concrete class of a game event
+	enum class GameEventId
+	{
+		MOVE,
+		CASTLING,
+		MAX
+	};
+
+	// Compact description of an event that can be stored and replayed
+	// without the original event object. For castling, the origin is the
+	// rook square and the destination is unused. The promotion is only set
+	// once the event has been applied and a pawn was promoted because of it.
+	struct EventRecord
+	{
+		GameEventId id;
+		Square origin;
+		Square dest;
+		PieceTypeId promotion;
+	};
+
 	// An event is the parent class of all the possible events that can occurr
 	// in a chess game and change the game state.
 	class GameEvent
@@ -19,6 +41,9 @@ namespace chesslib
 
 		// Apply event to game state, if and only if, the event is valid.
 		virtual void apply(GameState& gameState) = 0;
+
+		// Describe event in a compact record (without promotion)
+		virtual EventRecord getRecord() const = 0;
 	};
 
 	// A move means the displacement of a piece on the board to a different tile.
@@ -42,6 +67,9 @@ namespace chesslib
 
 		// Apply move to game state.
 		void apply(GameState& gameState) override;
+
+		// Describe move in a compact record.
+		EventRecord getRecord() const override;
 	private:
 		Square origin, dest;
 	};
@@ -64,8 +92,15 @@ namespace chesslib
 
 		// Apply castling to game state
 		void apply(GameState& gameState) override;
+
+		// Describe castling in a compact record
+		EventRecord getRecord() const override;
 	private:
 		Square rook;
 	};
 
+	// Recreate the event described by a record (ignores the promotion)
+	// Returns nullptr if the record is invalid
+	std::shared_ptr<GameEvent> makeEvent(EventRecord const& record);
+
 }
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include "feed.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "controller.h"
+#include "history.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Most chunks handed to the kernel in one vectored write
+static const size_t max_write_chunks = 64;
+
+void chesslib::encodeSnapshot(PositionSnapshot const& snapshot, vector<uint8_t>& bytes)
+{
+	auto const offset = bytes.size();
+	bytes.resize(offset + snapshot_delta_size, 0);
+	bytes[offset] = static_cast<uint8_t>(DeltaId::SNAPSHOT);
+	memcpy(bytes.data() + offset + delta_size, &snapshot, sizeof(snapshot));
+}
+
+EventFeed::EventFeed() :
+	m_enpassant(SQ_CNT),
+	m_phase(Phase::RUNNING),
+	m_draw_reason(DrawReason::NONE)
+{}
+
+void EventFeed::take(vector<uint8_t>& bytes)
+{
+	// The buffers are swapped so that both keep their memory
+	bytes.clear();
+	swap(bytes, m_bytes);
+}
+
+size_t EventFeed::size() const
+{
+	return m_bytes.size();
+}
+
+void EventFeed::onEventApplied(GameController const& gameController,
+                               EventRecord const& record)
+{
+	auto const& state = gameController.getState();
+	auto const origin = static_cast<uint8_t>(record.origin);
+	auto const dest = static_cast<uint8_t>(record.dest);
+
+	if (record.id == GameEventId::CASTLING) {
+		push(DeltaId::CASTLING, origin);
+	} else if (record.promotion != PieceTypeId::NONE) {
+		push(DeltaId::PROMOTION, origin, dest, static_cast<uint8_t>(record.promotion));
+	} else if (record.dest == m_enpassant &&
+	           state.getPieceAt(record.dest).getType()->getId() == PieceTypeId::PAWN) {
+		push(DeltaId::EN_PASSANT, origin, dest,
+		     static_cast<uint8_t>(getEnPassantVictim(m_enpassant)));
+	} else {
+		push(DeltaId::MOVE, origin, dest);
+	}
+
+	if (state.getPhase() != m_phase || state.getDrawReason() != m_draw_reason)
+		push(DeltaId::PHASE, static_cast<uint8_t>(state.getPhase()),
+		     static_cast<uint8_t>(state.getDrawReason()));
+
+	track(state);
+}
+
+void EventFeed::onEventUndone(GameController const& gameController,
+                              EventRecord const& record)
+{
+	pushSnapshot(gameController);
+}
+
+void EventFeed::onStateReset(GameController const& gameController)
+{
+	pushSnapshot(gameController);
+}
+
+void EventFeed::push(DeltaId id, uint8_t a, uint8_t b, uint8_t c)
+{
+	uint8_t const delta[delta_size] = { static_cast<uint8_t>(id), a, b, c };
+	m_bytes.insert(m_bytes.end(), begin(delta), end(delta));
+}
+
+void EventFeed::pushSnapshot(GameController const& gameController)
+{
+	encodeSnapshot(makeSnapshot(gameController), m_bytes);
+	track(gameController.getState());
+}
+
+void EventFeed::track(GameState const& state)
+{
+	m_enpassant = state.getEnPassantPawn();
+	m_phase = state.getPhase();
+	m_draw_reason = state.getDrawReason();
+}
+
+FeedReader::FeedReader() :
+	m_ply(0),
+	m_synchronised(false)
+{}
+
+bool FeedReader::read(uint8_t const* data, size_t size)
+{
+	size_t used;
+
+	// Complete the delta cut short by the previous call first
+	if (!m_partial.empty()) {
+		auto const missing = min(size, (m_partial[0] == static_cast<uint8_t>(DeltaId::SNAPSHOT) ?
+		                                snapshot_delta_size : delta_size) - m_partial.size());
+		m_partial.insert(m_partial.end(), data, data + missing);
+		data += missing;
+		size -= missing;
+		if (!decode(m_partial.data(), m_partial.size(), used))
+			return false;
+		if (used == 0)
+			return true;
+		m_partial.clear();
+	}
+
+	while (size > 0) {
+		if (!decode(data, size, used))
+			return false;
+		if (used == 0) {
+			m_partial.assign(data, data + size);
+			break;
+		}
+		data += used;
+		size -= used;
+	}
+	return true;
+}
+
+bool FeedReader::decode(uint8_t const* data, size_t size, size_t& used)
+{
+	auto const id = static_cast<DeltaId>(data[0]);
+	auto const needed = (id == DeltaId::SNAPSHOT) ? snapshot_delta_size : delta_size;
+	used = 0;
+	if (size < needed)
+		return true;
+	used = needed;
+
+	if (id == DeltaId::SNAPSHOT) {
+		PositionSnapshot snapshot;
+		memcpy(&snapshot, data + delta_size, sizeof(snapshot));
+		restoreSnapshot(snapshot, m_state);
+		m_ply = snapshot.ply;
+		m_synchronised = true;
+		return true;
+	}
+
+	// Deltas only make sense on top of a snapshot
+	if (!m_synchronised)
+		return false;
+
+	auto const origin = static_cast<Square>(data[1]);
+	auto const dest = static_cast<Square>(data[2]);
+	EventRecord record{ GameEventId::MOVE, origin, dest, PieceTypeId::NONE };
+
+	switch (id) {
+	case DeltaId::MOVE:
+	case DeltaId::EN_PASSANT:
+		break;
+	case DeltaId::PROMOTION:
+		record.promotion = static_cast<PieceTypeId>(data[3]);
+		if (!PieceTypeIdCheck(record.promotion) || record.promotion == PieceTypeId::NONE)
+			return false;
+		break;
+	case DeltaId::CASTLING:
+		record.id = GameEventId::CASTLING;
+		record.dest = SQ_CNT;
+		if (!SquareCheck(origin))
+			return false;
+		break;
+	case DeltaId::PHASE:
+	{
+		auto const phase = static_cast<Phase>(data[1]);
+		auto const reason = static_cast<DrawReason>(data[2]);
+		if (!PhaseCheck(phase) || !DrawReasonCheck(reason))
+			return false;
+		m_state.setPhase(phase);
+		m_state.setDrawReason(reason);
+		return true;
+	}
+	default:
+		return false;
+	}
+
+	if (record.id == GameEventId::MOVE &&
+	    (!SquareCheck(origin) || !SquareCheck(dest) || m_state.getPieceAt(origin).isClear()))
+		return false;
+
+	// The event is replayed exactly like the controller applied it,
+	// en passant captures and castlings included
+	UndoRecord undo;
+	applyEvent(m_state, record, undo);
+	++m_ply;
+	return true;
+}
+
+bool FeedReader::isSynchronised() const
+{
+	return m_synchronised;
+}
+
+GameState const& FeedReader::getState() const
+{
+	return m_state;
+}
+
+size_t FeedReader::getPly() const
+{
+	return m_ply;
+}
+
+FeedFanout::FeedFanout(size_t max_backlog) :
+	m_max_backlog(max_backlog)
+{}
+
+void FeedFanout::add(int fd, vector<uint8_t> bytes)
+{
+	Subscriber subscriber{ fd, {}, 0, bytes.size() };
+	if (!bytes.empty())
+		subscriber.chunks.push_back(make_shared<vector<uint8_t> const>(move(bytes)));
+	m_subscribers.push_back(move(subscriber));
+}
+
+void FeedFanout::remove(int fd)
+{
+	m_subscribers.erase(remove_if(m_subscribers.begin(), m_subscribers.end(),
+	                              [fd] (Subscriber const& s) { return s.fd == fd; }),
+	                    m_subscribers.end());
+}
+
+size_t FeedFanout::size() const
+{
+	return m_subscribers.size();
+}
+
+void FeedFanout::push(vector<uint8_t> bytes)
+{
+	if (bytes.empty())
+		return;
+	// One copy of the bytes is shared by every subscriber
+	auto const chunk = make_shared<vector<uint8_t> const>(move(bytes));
+	for (auto& subscriber : m_subscribers) {
+		subscriber.chunks.push_back(chunk);
+		subscriber.backlog += chunk->size();
+	}
+}
+
+vector<int> FeedFanout::flush()
+{
+	vector<int> dropped;
+	for (auto& subscriber : m_subscribers)
+		if (!write(subscriber) || subscriber.backlog > m_max_backlog)
+			dropped.push_back(subscriber.fd);
+	for (auto fd : dropped)
+		remove(fd);
+	return dropped;
+}
+
+bool FeedFanout::isPending() const
+{
+	for (auto const& subscriber : m_subscribers)
+		if (subscriber.backlog > 0)
+			return true;
+	return false;
+}
+
+bool FeedFanout::write(Subscriber& subscriber)
+{
+	auto& chunks = subscriber.chunks;
+	while (!chunks.empty()) {
+#if defined(_WIN32)
+		auto const& chunk = *chunks.front();
+		auto const wanted = chunk.size() - subscriber.offset;
+		auto const n = _write(subscriber.fd, chunk.data() + subscriber.offset,
+		                      static_cast<unsigned int>(wanted));
+		if (n < 0)
+			return errno == EAGAIN;
+#else
+		iovec iov[max_write_chunks];
+		size_t cnt = 0;
+		size_t wanted = 0;
+		for (auto it = chunks.begin(); it != chunks.end() && cnt < max_write_chunks; ++it, ++cnt) {
+			auto const skip = (cnt == 0) ? subscriber.offset : 0;
+			iov[cnt].iov_base = const_cast<uint8_t*>((*it)->data() + skip);
+			iov[cnt].iov_len = (*it)->size() - skip;
+			wanted += iov[cnt].iov_len;
+		}
+		auto const n = writev(subscriber.fd, iov, static_cast<int>(cnt));
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		}
+#endif
+		subscriber.backlog -= static_cast<size_t>(n);
+		for (auto left = static_cast<size_t>(n); left > 0; ) {
+			auto const rest = chunks.front()->size() - subscriber.offset;
+			if (left < rest) {
+				subscriber.offset += left;
+				break;
+			}
+			left -= rest;
+			chunks.pop_front();
+			subscriber.offset = 0;
+		}
+
+		// The kernel took less than it was given, so it is full
+		if (static_cast<size_t>(n) < wanted)
+			return true;
+	}
+	return true;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint8_t
+#include <deque> // std::deque
+#include <memory> // std::shared_ptr
+#include <vector> // std::vector
+
+#include "observer.h" // GameObserver
+#include "snapshot.h" // PositionSnapshot
+#include "state.h" // GameState
+#include "types.h" // Square, Phase, DrawReason
+
+namespace chesslib
+{
+
+	// Kinds of deltas in an event feed
+	enum class DeltaId : std::uint8_t
+	{
+		SNAPSHOT = 1, // the whole game state, followed by a PositionSnapshot
+		MOVE, // origin, destination
+		CASTLING, // rook square
+		EN_PASSANT, // origin, destination, square of the pawn taken
+		PROMOTION, // origin, destination, piece type promoted to
+		PHASE, // phase, draw reason
+	};
+
+	// Every delta takes 4 bytes (its kind and 3 operands, unused ones
+	// being zero), except snapshots, which are followed by the snapshot
+	constexpr std::size_t delta_size = 4;
+	constexpr std::size_t snapshot_delta_size = delta_size + sizeof(PositionSnapshot);
+
+	// Append snapshot delta to bytes
+	void encodeSnapshot(PositionSnapshot const& snapshot, std::vector<std::uint8_t>& bytes);
+
+	// Compact binary stream of what happens to a game, for subscribers
+	// to follow it at a few bytes per ply instead of a whole saved game
+	// state each time. Every event applied is encoded as a delta (a move,
+	// a castling, an en passant capture or a promotion), followed by a
+	// phase delta if the game ended because of it. Events taken back and
+	// game states replaced as a whole are encoded as a snapshot, like in
+	// the journal, so subscribers never need a history of their own.
+	//
+	// The feed is fed by attaching it to a GameController as an observer,
+	// and the bytes encoded pile up until they are taken, so that they
+	// can be sent in batches.
+	class EventFeed : public GameObserver
+	{
+	public:
+		// Create an empty feed
+		EventFeed();
+
+		// Move bytes encoded since the last call into bytes (whose
+		// previous contents are lost), leaving the feed empty
+		void take(std::vector<std::uint8_t>& bytes);
+
+		// Get number of bytes encoded and not taken yet
+		std::size_t size() const;
+
+		void onEventApplied(GameController const& gameController,
+		                    EventRecord const& record) override;
+
+		void onEventUndone(GameController const& gameController,
+		                   EventRecord const& record) override;
+
+		void onStateReset(GameController const& gameController) override;
+	private:
+		// Append delta with its operands
+		void push(DeltaId id, std::uint8_t a, std::uint8_t b = 0, std::uint8_t c = 0);
+
+		// Append snapshot of the game state and keep track of it
+		void pushSnapshot(GameController const& gameController);
+
+		// Keep track of the game state deltas depend on
+		void track(GameState const& state);
+	private:
+		std::vector<std::uint8_t> m_bytes;
+		Square m_enpassant; // before the next event
+		Phase m_phase;
+		DrawReason m_draw_reason;
+	};
+
+	// Game state rebuilt from an event feed, starting from the first
+	// snapshot in it
+	class FeedReader
+	{
+	public:
+		// Create reader that waits for a snapshot
+		FeedReader();
+
+		// Decode bytes of the feed, which may end in the middle of a
+		// delta (the rest is expected in the next call)
+		// Returns false if the feed is malformed, after which the reader
+		// must be discarded
+		bool read(std::uint8_t const* data, std::size_t size);
+
+		// Check whether a snapshot was read, so that there is a game state
+		bool isSynchronised() const;
+
+		// Get game state
+		GameState const& getState() const;
+
+		// Get number of events applied, as counted by GameController::getPly
+		std::size_t getPly() const;
+	private:
+		// Decode delta at the start of the bytes, setting the number of
+		// bytes it takes (0 if it is cut short)
+		// Returns false if the delta is malformed
+		bool decode(std::uint8_t const* data, std::size_t size, std::size_t& used);
+	private:
+		GameState m_state;
+		std::vector<std::uint8_t> m_partial; // delta cut short
+		std::size_t m_ply;
+		bool m_synchronised;
+	};
+
+	// Writes the bytes of a feed to many file descriptors (local sockets
+	// or pipes) at once. Bytes are queued for every subscriber without
+	// being copied, and each flush hands all that is queued for a
+	// subscriber to the kernel in one vectored write, however many
+	// batches piled up, so a slow subscriber costs one system call per
+	// flush and never holds up the others.
+	//
+	// The descriptors should be non-blocking, and SIGPIPE ignored.
+	class FeedFanout
+	{
+	public:
+		// Create fan-out without subscribers, dropping any subscriber
+		// that falls more than the given number of bytes behind
+		explicit FeedFanout(std::size_t max_backlog = 1 << 20);
+
+		// Add subscriber, to be written the given bytes first (usually
+		// a snapshot of the game, see encodeSnapshot) and then every
+		// byte pushed from now on
+		void add(int fd, std::vector<std::uint8_t> bytes);
+
+		// Remove subscriber (the descriptor is not closed)
+		void remove(int fd);
+
+		// Get number of subscribers
+		std::size_t size() const;
+
+		// Queue bytes for every subscriber
+		void push(std::vector<std::uint8_t> bytes);
+
+		// Write as much as possible of what is queued, without blocking
+		// Returns descriptors of subscribers dropped because writing to
+		// them failed or they fell too far behind (none are closed)
+		std::vector<int> flush();
+
+		// Check whether bytes are still queued for any subscriber
+		bool isPending() const;
+	private:
+		using Chunk = std::shared_ptr<std::vector<std::uint8_t> const>;
+
+		struct Subscriber
+		{
+			int fd;
+			std::deque<Chunk> chunks;
+			std::size_t offset; // bytes of the first chunk written
+			std::size_t backlog; // bytes queued and not written
+		};
+
+		// Write what is queued for a subscriber
+		// Returns false if writing failed
+		bool write(Subscriber& subscriber);
+	private:
+		std::vector<Subscriber> m_subscribers;
+		std::size_t m_max_backlog;
+	};
+
+}
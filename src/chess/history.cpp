@@ -0,0 +1,141 @@
+#include "history.h"
+
+#include <cassert>
+
+#include "event.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Get square where the king involved in a castling is located
+static Square getCastlingKing(Square rook)
+{
+	return getSquareRank(rook) == RK_1 ? SQ_E1 : SQ_E8;
+}
+
+uint8_t chesslib::packPiece(Piece const& piece)
+{
+	return static_cast<uint8_t>(
+		static_cast<int>(piece.getType()->getId()) |
+		static_cast<int>(piece.getColour()) << 3);
+}
+
+Piece chesslib::unpackPiece(uint8_t packed)
+{
+	auto id = static_cast<PieceTypeId>(packed & 0b111);
+	auto colour = static_cast<Colour>(packed >> 3);
+	return Piece(getPieceTypeById(id), colour);
+}
+
+Square chesslib::getEnPassantVictim(Square enpassant)
+{
+	if (getSquareRank(enpassant) == ColourTraits<Colour::BLACK>::enpassant_rank)
+		return getEnPassantVictim<Colour::BLACK>(enpassant);
+	else
+		return getEnPassantVictim<Colour::WHITE>(enpassant);
+}
+
+void chesslib::beginEvent(GameState& state, EventRecord const& record,
+                          UndoRecord& undo)
+{
+	undo.hash = state.getHash();
+	undo.altered = state.getAlteredMask();
+	undo.enpassant = state.getEnPassantPawn();
+	undo.phase = state.getPhase();
+	undo.draw_reason = state.getDrawReason();
+	undo.halfmove_clock = state.getHalfmoveClock();
+	undo.captured = 0;
+	undo.victim = 0;
+
+	// Captures and pawn moves can never be undone in a game
+	bool irreversible = false;
+
+	if (record.id == GameEventId::MOVE) {
+		auto const& moved = state.getPieceAt(record.origin);
+		auto const& captured = state.getPieceAt(record.dest);
+		undo.captured = packPiece(captured);
+		irreversible = !captured.isClear() ||
+			moved.getType()->getId() == PieceTypeId::PAWN;
+	}
+
+	if (state.hasEnPassant())
+		undo.victim = packPiece(state.getPieceAt(
+			getEnPassantVictim(state.getEnPassantPawn())));
+
+	switch (record.id) {
+	case GameEventId::MOVE:
+		Move(record.origin, record.dest).apply(state);
+		break;
+	case GameEventId::CASTLING:
+		Castling(record.origin).apply(state);
+		break;
+	default:
+		assert(false);
+	}
+
+	if (undo.enpassant == state.getEnPassantPawn())
+		state.clearEnPassantPawn();
+
+	state.setHalfmoveClock(irreversible ? 0 : undo.halfmove_clock + 1);
+}
+
+void chesslib::finishEvent(GameState& state, EventRecord const& record,
+                           UndoRecord& undo)
+{
+	undo.event = record;
+	state.nextTurn();
+}
+
+void chesslib::applyEvent(GameState& state, EventRecord const& record,
+                          UndoRecord& undo)
+{
+	beginEvent(state, record, undo);
+
+	if (record.promotion != PieceTypeId::NONE) {
+		auto const& pawn = state.getPieceAt(record.dest);
+		state.setPiece(record.dest, Piece(getPieceTypeById(record.promotion),
+		                                  pawn.getColour()));
+	}
+
+	finishEvent(state, record, undo);
+}
+
+void chesslib::revertEvent(GameState& state, UndoRecord const& undo)
+{
+	auto const& record = undo.event;
+
+	if (record.id == GameEventId::MOVE) {
+		auto moved = state.getPieceAt(record.dest);
+		if (record.promotion != PieceTypeId::NONE)
+			moved.setType(PieceTypeId::PAWN);
+		state.setPiece(record.origin, moved);
+		state.setPiece(record.dest, unpackPiece(undo.captured));
+	} else {
+		Square rook = record.origin;
+		Square king = getCastlingKing(rook);
+		Direction king_dir = (king < rook) ? DIR_EAST : DIR_WEST;
+		Square king_dest = king + 2 * king_dir;
+		Square rook_dest = king_dest - king_dir;
+		state.setPiece(king, state.getPieceAt(king_dest));
+		state.setPiece(rook, state.getPieceAt(rook_dest));
+		state.clearSquare(king_dest);
+		state.clearSquare(rook_dest);
+	}
+
+	if (undo.enpassant != SQ_CNT) {
+		state.setPiece(getEnPassantVictim(undo.enpassant),
+		               unpackPiece(undo.victim));
+		state.setEnPassantPawn(undo.enpassant);
+	} else {
+		state.clearEnPassantPawn();
+	}
+
+	state.setAlteredMask(undo.altered);
+	state.setPhase(undo.phase);
+	state.setDrawReason(undo.draw_reason);
+	state.setHalfmoveClock(undo.halfmove_clock);
+	state.nextTurn();
+
+	assert(state.getHash() == undo.hash);
+}
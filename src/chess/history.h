@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint> // std::uint8_t, std::uint64_t
+
+#include "event.h" // EventRecord
+#include "types.h" // Square, Phase, DrawReason
+
+namespace chesslib
+{
+
+	class GameState;
+
+	// Everything needed to take an event back, besides the event itself.
+	// Pieces are packed in a byte each (see packPiece), so that a record
+	// is small and trivially copyable, and a history of them is just an
+	// array that never allocates once it has been reserved.
+	struct UndoRecord
+	{
+		EventRecord event;
+		std::uint64_t hash; // position hash before the event
+		std::uint64_t altered; // altered squares before the event
+		Square enpassant; // en passant pawn before the event
+		Phase phase; // game phase before the event
+		DrawReason draw_reason; // draw reason before the event
+		unsigned int halfmove_clock; // halfmove clock before the event
+		std::uint8_t captured; // piece on the destination square
+		std::uint8_t victim; // piece next to the en passant square
+	};
+
+	// Pack piece in a byte
+	std::uint8_t packPiece(Piece const& piece);
+
+	// Unpack piece from a byte
+	Piece unpackPiece(std::uint8_t packed);
+
+	// Get square of the pawn a pawn of colour C takes by moving to the
+	// en passant square
+	template<Colour C>
+	constexpr Square getEnPassantVictim(Square enpassant)
+	{
+		return enpassant - ColourTraits<C>::forward;
+	}
+
+	// Get square of the pawn that can be taken en passant, telling the
+	// colour of the pawns by the rank of the en passant square
+	Square getEnPassantVictim(Square enpassant);
+
+	// Start applying an event to the game state, filling the undo record
+	// What is left for the caller is to promote a pawn, if there is one
+	// on the last rank, and then to finish the event.
+	void beginEvent(GameState& state, EventRecord const& record, UndoRecord& undo);
+
+	// Finish applying an event to the game state, after the promotion
+	// (stored in the record) has been taken care of
+	void finishEvent(GameState& state, EventRecord const& record, UndoRecord& undo);
+
+	// Apply a valid event to the game state, including the promotion
+	// stored in the record, and fill the undo record. This is the same as
+	// GameController::update without the validation, the listener and the
+	// lookout for the end of the game.
+	void applyEvent(GameState& state, EventRecord const& record, UndoRecord& undo);
+
+	// Take back the event described by the undo record, which must be
+	// the last one applied to the game state
+	void revertEvent(GameState& state, UndoRecord const& undo);
+
+}
@@ -0,0 +1,403 @@
+#include "journal.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "controller.h"
+#include "listener.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+namespace fs = std::filesystem;
+
+// Journal file header
+static const char journal_magic[4] = { 'C', 'H', 'S', 'J' };
+static const uint32_t journal_version = 1;
+static const long journal_header_size = 8;
+
+// Record framing: kind (1 byte) + payload size (4 bytes) + payload + crc (4 bytes)
+static const long record_header_size = 5;
+static const long record_trailer_size = 4;
+
+// Upper bound on payload size, so that a corrupted size field
+// is never trusted to allocate memory
+static const uint32_t max_payload_size = 1 << 20;
+
+// Computes the CRC-32 (IEEE 802.3) of a sequence of bytes
+static uint32_t crc32(char const* data, size_t size, uint32_t crc = 0)
+{
+	static const auto table = [] {
+		array<uint32_t, 256> t{};
+		for (uint32_t i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; ++k)
+				c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+			t[i] = c;
+		}
+		return t;
+	}();
+	crc = ~crc;
+	for (size_t i = 0; i < size; ++i)
+		crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+// Saves a game state as text
+static string saveState(GameState const& state)
+{
+	ostringstream os;
+	state.save(os);
+	return os.str();
+}
+
+// Cuts a file to a size
+// Returns true on success
+static bool truncateFile(FILE* file, long size)
+{
+#if defined(_WIN32)
+	return _chsize(_fileno(file), size) == 0;
+#else
+	return ftruncate(fileno(file), size) == 0;
+#endif
+}
+
+// Encodes a 32-bit unsigned integer in little-endian
+static void putUint32(char* out, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i)
+		out[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+}
+
+// Decodes a 32-bit unsigned integer in little-endian
+static uint32_t getUint32(char const* in)
+{
+	uint32_t value = 0;
+	for (int i = 0; i < 4; ++i)
+		value |= static_cast<uint32_t>(static_cast<uint8_t>(in[i])) << (8 * i);
+	return value;
+}
+
+// Answers promotions with the choices stored in the journal
+class chesslib::ReplayGameListener : public GameListener
+{
+public:
+	PieceTypeId promotePawn(GameController const& gameController,
+	                        Square pawn) override
+	{
+		return promotion;
+	}
+
+	void catchError(GameController const& gameController,
+	                GameError err) override {}
+
+	PieceTypeId promotion = PieceTypeId::QUEEN;
+};
+
+GameJournal::GameJournal(size_t snapshotInterval) :
+	m_file(nullptr),
+	m_durable(true),
+	m_resumable(false),
+	m_failed(false),
+	m_ply_base(0),
+	m_snapshot_interval(max<size_t>(snapshotInterval, 1))
+{}
+
+GameJournal::~GameJournal()
+{
+	close();
+}
+
+bool GameJournal::open(fs::path const& path)
+{
+	close();
+
+	error_code ec;
+	if (fs::exists(path, ec) && fs::file_size(path, ec) > 0) {
+		m_file = fopen(path.string().c_str(), "rb");
+		if (m_file == nullptr)
+			return false;
+		auto end = scan();
+		fclose(m_file);
+		m_file = nullptr;
+		if (end < 0)
+			return false;
+		if (static_cast<uintmax_t>(end) < fs::file_size(path, ec)) {
+			fs::resize_file(path, end, ec);
+			if (ec)
+				return false;
+		}
+		m_file = fopen(path.string().c_str(), "r+b");
+		if (m_file == nullptr)
+			return false;
+		m_resumable = !m_snapshots.empty();
+	} else {
+		m_file = fopen(path.string().c_str(), "w+b");
+		if (m_file == nullptr)
+			return false;
+		char header[journal_header_size];
+		memcpy(header, journal_magic, sizeof(journal_magic));
+		putUint32(header + 4, journal_version);
+		if (fwrite(header, 1, sizeof(header), m_file) != sizeof(header)) {
+			close();
+			return false;
+		}
+		fflush(m_file);
+	}
+
+	return true;
+}
+
+void GameJournal::close()
+{
+	if (m_file != nullptr) {
+		fclose(m_file);
+		m_file = nullptr;
+	}
+	m_events.clear();
+	m_snapshots.clear();
+	m_resumable = false;
+	m_failed = false;
+	m_ply_base = 0;
+}
+
+bool GameJournal::isOpen() const
+{
+	return m_file != nullptr;
+}
+
+void GameJournal::setDurable(bool durable)
+{
+	m_durable = durable;
+}
+
+bool GameJournal::hasFailed() const
+{
+	return m_failed;
+}
+
+size_t GameJournal::getPlyCount() const
+{
+	return m_events.size();
+}
+
+long GameJournal::scan()
+{
+	char header[journal_header_size];
+	if (fread(header, 1, sizeof(header), m_file) != sizeof(header) ||
+		memcmp(header, journal_magic, sizeof(journal_magic)) != 0 ||
+		getUint32(header + 4) != journal_version)
+		return -1;
+
+	long offset = journal_header_size;
+	vector<char> payload;
+	while (true) {
+		char frame[record_header_size];
+		if (fread(frame, 1, sizeof(frame), m_file) != sizeof(frame))
+			break;
+		auto kind = static_cast<RecordKind>(frame[0]);
+		auto size = getUint32(frame + 1);
+		if ((kind != RecordKind::EVENT && kind != RecordKind::SNAPSHOT) ||
+			size > max_payload_size)
+			break;
+		payload.resize(size + record_trailer_size);
+		if (fread(payload.data(), 1, payload.size(), m_file) != payload.size())
+			break;
+		auto crc = crc32(frame, sizeof(frame));
+		crc = crc32(payload.data(), size, crc);
+		if (crc != getUint32(payload.data() + size))
+			break;
+		if (kind == RecordKind::SNAPSHOT && size < 4)
+			break;
+		auto snapshot_ply = kind == RecordKind::SNAPSHOT ?
+			getUint32(payload.data()) : 0;
+		index(kind, offset, snapshot_ply);
+		offset += record_header_size + size + record_trailer_size;
+	}
+	return offset;
+}
+
+void GameJournal::index(RecordKind kind, long offset, size_t snapshot_ply)
+{
+	if (kind == RecordKind::EVENT) {
+		m_events.push_back(offset);
+	} else {
+		// A snapshot supersedes every event and snapshot from its ply on
+		m_events.resize(snapshot_ply, -1);
+		while (!m_snapshots.empty() && m_snapshots.back().ply >= snapshot_ply)
+			m_snapshots.pop_back();
+		m_snapshots.push_back(SnapshotEntry{ snapshot_ply, offset });
+	}
+}
+
+bool GameJournal::read(long offset, RecordKind kind, vector<char>& payload) const
+{
+	char frame[record_header_size];
+	if (offset < 0 ||
+		fseek(m_file, offset, SEEK_SET) != 0 ||
+		fread(frame, 1, sizeof(frame), m_file) != sizeof(frame) ||
+		static_cast<RecordKind>(frame[0]) != kind)
+		return false;
+	auto size = getUint32(frame + 1);
+	if (size > max_payload_size)
+		return false;
+	payload.resize(size);
+	return fread(payload.data(), 1, size, m_file) == size;
+}
+
+void GameJournal::append(RecordKind kind, vector<char> const& payload)
+{
+	if (!isOpen() || m_failed)
+		return;
+
+	vector<char> record(record_header_size + payload.size() + record_trailer_size);
+	record[0] = static_cast<char>(kind);
+	putUint32(record.data() + 1, static_cast<uint32_t>(payload.size()));
+	copy(payload.begin(), payload.end(), record.begin() + record_header_size);
+	auto crc = crc32(record.data(), record_header_size + payload.size());
+	putUint32(record.data() + record_header_size + payload.size(), crc);
+
+	fseek(m_file, 0, SEEK_END);
+	long offset = ftell(m_file);
+	if (offset < 0 ||
+		fwrite(record.data(), 1, record.size(), m_file) != record.size() ||
+		fflush(m_file) != 0) {
+		// Records appended after a torn one would be discarded along with
+		// it when the journal is reopened, and the journal misses a record
+		// anyway, so it takes no more; the torn record is cut off, if it
+		// can be, or else discarded when the journal is reopened
+		m_failed = true;
+		clearerr(m_file);
+		if (offset >= 0)
+			truncateFile(m_file, offset);
+		return;
+	}
+
+	if (m_durable) {
+#if defined(_WIN32)
+		_commit(_fileno(m_file));
+#else
+		fsync(fileno(m_file));
+#endif
+	}
+
+	auto snapshot_ply = kind == RecordKind::SNAPSHOT ?
+		getUint32(payload.data()) : 0;
+	index(kind, offset, snapshot_ply);
+}
+
+void GameJournal::appendSnapshot(GameState const& state, size_t ply)
+{
+	auto text = saveState(state);
+	vector<char> payload(4 + text.size());
+	putUint32(payload.data(), static_cast<uint32_t>(ply));
+	copy(text.begin(), text.end(), payload.begin() + 4);
+	append(RecordKind::SNAPSHOT, payload);
+}
+
+void GameJournal::onEventApplied(GameController const& gameController,
+                                 EventRecord const& record)
+{
+	vector<char> payload = {
+		static_cast<char>(record.id),
+		static_cast<char>(record.origin),
+		static_cast<char>(record.dest),
+		static_cast<char>(record.promotion),
+	};
+	append(RecordKind::EVENT, payload);
+
+	if (getPlyCount() % m_snapshot_interval == 0)
+		appendSnapshot(gameController.getState(), getPlyCount());
+}
+
+void GameJournal::onEventUndone(GameController const& gameController,
+                                EventRecord const& record)
+{
+	appendSnapshot(gameController.getState(), m_ply_base + gameController.getPly());
+}
+
+void GameJournal::onStateReset(GameController const& gameController)
+{
+	// A reopened journal goes on from its last ply if the game stands
+	// there, as a snapshot would otherwise supersede what it holds
+	if (m_resumable) {
+		m_resumable = false;
+		GameState last;
+		if (gameController.getPly() <= getPlyCount() &&
+			seek(getPlyCount(), last) &&
+			saveState(last) == saveState(gameController.getState())) {
+			m_ply_base = getPlyCount() - gameController.getPly();
+			return;
+		}
+	}
+	appendSnapshot(gameController.getState(), m_ply_base + gameController.getPly());
+}
+
+bool GameJournal::seek(size_t ply, GameState& state) const
+{
+	if (!isOpen() || ply > getPlyCount())
+		return false;
+
+	auto listener = make_shared<ReplayGameListener>();
+	auto gc = GameController(make_unique<GameState>(), listener);
+	if (!replay(ply, ply, gc, *listener))
+		return false;
+
+	// Repetitions can only be detected if the history reaches back
+	// to the last irreversible event, so replay from further back
+	auto clock = gc.getState().getHalfmoveClock();
+	if (gc.getPly() < clock && gc.getPly() < ply)
+		if (!replay(ply - min<size_t>(clock, ply), ply, gc, *listener))
+			return false;
+
+	state = gc.getState();
+	return true;
+}
+
+bool GameJournal::replay(size_t from, size_t ply, GameController& gc,
+                         ReplayGameListener& listener) const
+{
+	auto snapshot = upper_bound(m_snapshots.begin(), m_snapshots.end(), from,
+		[] (size_t p, SnapshotEntry const& e) { return p < e.ply; });
+	if (snapshot == m_snapshots.begin())
+		return false;
+	--snapshot;
+
+	vector<char> payload;
+	if (!read(snapshot->offset, RecordKind::SNAPSHOT, payload))
+		return false;
+
+	istringstream is(string(payload.begin() + 4, payload.end()));
+	if (!gc.load(is))
+		return false;
+
+	for (auto p = snapshot->ply; p < ply; ++p) {
+		if (!read(m_events[p], RecordKind::EVENT, payload) || payload.size() != 4)
+			return false;
+		auto record = EventRecord{
+			static_cast<GameEventId>(payload[0]),
+			static_cast<Square>(payload[1]),
+			static_cast<Square>(payload[2]),
+			static_cast<PieceTypeId>(payload[3]),
+		};
+		auto event = makeEvent(record);
+		if (!event)
+			return false;
+		listener.promotion = record.promotion;
+		if (!gc.update(event))
+			return false;
+	}
+
+	return true;
+}
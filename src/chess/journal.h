@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdio> // std::FILE
+#include <cstdint> // std::uint32_t
+#include <filesystem> // std::filesystem::path
+#include <vector> // std::vector
+
+#include "observer.h" // GameObserver
+#include "event.h" // EventRecord
+
+namespace chesslib
+{
+
+	class GameState;
+	class ReplayGameListener;
+
+	// Append-only binary journal of the events applied to a game, as
+	// described in docs/event-based-game.md. Every few plies, and whenever
+	// the game state is replaced, a snapshot of the game state is written,
+	// so that any ply can be reconstructed by loading the closest snapshot
+	// and replaying at most 'snapshotInterval' events.
+	//
+	// Every record is checksummed. When a journal is reopened, a record that
+	// was only partially written (e.g. the process crashed mid-append) and
+	// everything after it is discarded, so the journal always ends on the
+	// last event that was fully appended. Should an append fail, the journal
+	// takes no more records, as it would no longer follow the game.
+	//
+	// The journal is fed by attaching it to a GameController as an observer.
+	// A reopened journal attached to a game that stands where the journal
+	// ends (e.g. as reconstructed by seek) goes on from its last ply, with
+	// the game's plies counted from there.
+	class GameJournal : public GameObserver
+	{
+	public:
+		// Create a closed journal that takes a snapshot of the game state
+		// every 'snapshotInterval' plies
+		explicit GameJournal(std::size_t snapshotInterval = 32);
+
+		// Close journal
+		~GameJournal();
+
+		// A journal owns a file handle and cannot be copied
+		GameJournal(GameJournal const&) = delete;
+		GameJournal& operator=(GameJournal const&) = delete;
+
+		// Open journal file, creating it if it doesn't exist
+		// Returns true on success
+		bool open(std::filesystem::path const& path);
+
+		// Close journal file
+		void close();
+
+		// Check whether the journal file is open
+		bool isOpen() const;
+
+		// Make every append wait until the record reaches the disk
+		// (enabled by default)
+		void setDurable(bool durable);
+
+		// Check whether an append failed, after which the journal takes
+		// no more records
+		bool hasFailed() const;
+
+		// Get number of plies in the journal
+		std::size_t getPlyCount() const;
+
+		// Reconstruct the game state right after the given ply, counted
+		// from the start of the journal
+		// Returns true on success
+		bool seek(std::size_t ply, GameState& state) const;
+
+		// Append event applied to the game state
+		void onEventApplied(GameController const& gameController,
+		                    EventRecord const& record) override;
+
+		// Append snapshot of the game state after the event was taken back
+		// which supersedes the event in the journal
+		void onEventUndone(GameController const& gameController,
+		                   EventRecord const& record) override;
+
+		// Append snapshot of the replaced game state, unless the journal
+		// was reopened and the game stands where it ends
+		void onStateReset(GameController const& gameController) override;
+	private:
+		// Kinds of records stored in the journal file
+		enum class RecordKind : std::uint8_t
+		{
+			EVENT = 1,
+			SNAPSHOT = 2,
+		};
+
+		// Location of a snapshot in the journal file
+		struct SnapshotEntry
+		{
+			std::size_t ply;
+			long offset;
+		};
+
+		// Scan records from file, indexing the intact ones
+		// Returns the offset right after the last intact record
+		long scan();
+
+		// Index a record found at offset
+		void index(RecordKind kind, long offset, std::size_t snapshot_ply);
+
+		// Read record payload at offset
+		// Returns true on success
+		bool read(long offset, RecordKind kind,
+		          std::vector<char>& payload) const;
+
+		// Replay events up to the given ply on the game controller, starting
+		// from the last snapshot taken at or before ply 'from'
+		// Returns true on success
+		bool replay(std::size_t from, std::size_t ply, GameController& gc,
+		            ReplayGameListener& listener) const;
+
+		// Append record to file
+		void append(RecordKind kind, std::vector<char> const& payload);
+
+		// Append snapshot of game state at ply
+		void appendSnapshot(GameState const& state, std::size_t ply);
+	private:
+		std::FILE* m_file;
+		bool m_durable;
+		bool m_resumable; // reopened, and not yet attached
+		bool m_failed; // an append failed
+		std::size_t m_ply_base; // ply of the journal the game's ply 0 stands for
+		std::size_t m_snapshot_interval;
+		std::vector<long> m_events; // offset of the event of each ply
+		std::vector<SnapshotEntry> m_snapshots; // sorted by ply
+	};
+
+}
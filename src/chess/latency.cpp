@@ -0,0 +1,204 @@
+#include "latency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+using namespace std;
+using namespace chesslib;
+
+static const size_t operation_cnt = static_cast<size_t>(Operation::MAX);
+
+static char const* const operation_names[] = {
+	"update",
+	"load",
+	"save",
+	"checkmateSearch",
+};
+
+static_assert(size(operation_names) == operation_cnt, "every operation needs a name");
+
+namespace
+{
+	unsigned int getHighestBit(uint64_t value)
+	{
+#if defined(__GNUC__)
+		return 63 - __builtin_clzll(value);
+#else
+		unsigned int bit = 0;
+		while (value >>= 1)
+			++bit;
+		return bit;
+#endif
+	}
+
+	// Values below 2 * sub_bucket_cnt have a bucket each; above that,
+	// a value is shifted until it has as many bits as those, and the
+	// shift says which power of two it is in
+	size_t getBucket(uint64_t value)
+	{
+		auto const bits = LatencyHistogram::sub_bucket_bits;
+		auto const shift = value < (uint64_t(2) << bits) ?
+			0 : getHighestBit(value) - bits;
+		return shift * LatencyHistogram::sub_bucket_cnt + (value >> shift);
+	}
+
+	// Get highest value that falls in bucket
+	uint64_t getBucketEnd(size_t bucket)
+	{
+		auto const cnt = LatencyHistogram::sub_bucket_cnt;
+		if (bucket < 2 * cnt)
+			return bucket;
+		auto const shift = bucket / cnt - 1;
+		auto const sub_bucket = bucket % cnt + cnt;
+		// For the very last bucket, this wraps around to UINT64_MAX
+		return ((sub_bucket + 1) << shift) - 1;
+	}
+
+	void updateMax(atomic<uint64_t>& max, uint64_t value)
+	{
+		auto current = max.load(memory_order_relaxed);
+		while (value > current &&
+		       !max.compare_exchange_weak(current, value, memory_order_relaxed))
+			;
+	}
+
+	atomic<bool> tracking{ false };
+
+	LatencyHistogram& getHistogram(Operation operation)
+	{
+		static LatencyHistogram histograms[operation_cnt];
+		return histograms[static_cast<size_t>(operation)];
+	}
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+	m_buckets[getBucket(nanoseconds)].fetch_add(1, memory_order_relaxed);
+	m_count.fetch_add(1, memory_order_relaxed);
+	updateMax(m_max, nanoseconds);
+}
+
+void LatencyHistogram::merge(LatencyHistogram const& other)
+{
+	for (size_t i = 0; i < bucket_cnt; ++i) {
+		auto const n = other.m_buckets[i].load(memory_order_relaxed);
+		if (n != 0)
+			m_buckets[i].fetch_add(n, memory_order_relaxed);
+	}
+	m_count.fetch_add(other.getCount(), memory_order_relaxed);
+	updateMax(m_max, other.getMax());
+}
+
+void LatencyHistogram::reset()
+{
+	for (auto& bucket : m_buckets)
+		bucket.store(0, memory_order_relaxed);
+	m_count.store(0, memory_order_relaxed);
+	m_max.store(0, memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getCount() const
+{
+	return m_count.load(memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getMax() const
+{
+	return m_max.load(memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getPercentile(double percentile) const
+{
+	// Count again instead of trusting m_count, which might
+	// not agree with the buckets while others are recording
+	uint64_t total = 0;
+	for (auto const& bucket : m_buckets)
+		total += bucket.load(memory_order_relaxed);
+	if (total == 0)
+		return 0;
+
+	auto rank = static_cast<uint64_t>(ceil(percentile / 100.0 * total));
+	if (rank == 0)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < bucket_cnt; ++i) {
+		seen += m_buckets[i].load(memory_order_relaxed);
+		if (seen >= rank)
+			return min(getBucketEnd(i), getMax());
+	}
+	return getMax();
+}
+
+void chesslib::setLatencyTracking(bool enabled)
+{
+	tracking.store(enabled, memory_order_relaxed);
+}
+
+bool chesslib::isLatencyTracking()
+{
+	return tracking.load(memory_order_relaxed);
+}
+
+LatencyHistogram const& chesslib::getLatencyHistogram(Operation operation)
+{
+	return getHistogram(operation);
+}
+
+LatencySummary chesslib::getLatencySummary(Operation operation)
+{
+	auto const& histogram = getHistogram(operation);
+	return LatencySummary{
+		histogram.getCount(),
+		histogram.getPercentile(50.0),
+		histogram.getPercentile(99.0),
+		histogram.getPercentile(99.9),
+		histogram.getMax(),
+	};
+}
+
+void chesslib::resetLatency()
+{
+	for (size_t i = 0; i < operation_cnt; ++i)
+		getHistogram(static_cast<Operation>(i)).reset();
+}
+
+char const* chesslib::getOperationName(Operation operation)
+{
+	return operation_names[static_cast<size_t>(operation)];
+}
+
+void chesslib::dumpLatency(ostream& os)
+{
+	for (size_t i = 0; i < operation_cnt; ++i) {
+		auto const s = getLatencySummary(static_cast<Operation>(i));
+		os << operation_names[i] << ' ' << s.count
+		   << " p50=" << s.p50 << "ns"
+		   << " p99=" << s.p99 << "ns"
+		   << " p999=" << s.p999 << "ns"
+		   << " max=" << s.max << "ns" << endl;
+	}
+}
+
+LatencyTimer::LatencyTimer(Operation operation) :
+	m_operation(operation),
+	m_enabled(isLatencyTracking())
+{
+	if (m_enabled)
+		m_start = chrono::steady_clock::now();
+}
+
+LatencyTimer::~LatencyTimer()
+{
+	if (!m_enabled)
+		return;
+	auto const elapsed = chrono::steady_clock::now() - m_start;
+	auto const ns = chrono::duration_cast<chrono::nanoseconds>(elapsed).count();
+	getHistogram(m_operation).record(static_cast<uint64_t>(ns));
+}
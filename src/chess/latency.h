@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array> // std::array
+#include <atomic> // std::atomic
+#include <chrono> // std::chrono::steady_clock
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <iosfwd> // std::ostream
+
+namespace chesslib
+{
+
+	// Distribution of durations, in nanoseconds, in log-linear buckets:
+	// every power of two is split into 32 buckets of equal width, so any
+	// value is known within about 3% of its magnitude, from one nanosecond
+	// to the age of the universe, in a fixed amount of memory.
+	//
+	// Recording is lock-free (a couple of relaxed atomic operations), so
+	// a histogram can be shared by any number of threads. Reading while
+	// others record gives a slightly blurred but consistent picture.
+	class LatencyHistogram
+	{
+	public:
+		static constexpr unsigned int sub_bucket_bits = 5;
+		static constexpr std::size_t sub_bucket_cnt = std::size_t(1) << sub_bucket_bits;
+		static constexpr std::size_t bucket_cnt = (64 - sub_bucket_bits + 1) * sub_bucket_cnt;
+
+		// Create an empty histogram
+		LatencyHistogram();
+
+		// Add a duration
+		void record(std::uint64_t nanoseconds);
+
+		// Add every duration of another histogram
+		void merge(LatencyHistogram const& other);
+
+		// Remove all durations
+		void reset();
+
+		// Get number of durations
+		std::uint64_t getCount() const;
+
+		// Get longest duration
+		std::uint64_t getMax() const;
+
+		// Get duration that the given percentage of all durations
+		// do not exceed (rounded up to the end of its bucket)
+		std::uint64_t getPercentile(double percentile) const;
+	private:
+		std::array<std::atomic<std::uint64_t>, bucket_cnt> m_buckets;
+		std::atomic<std::uint64_t> m_count;
+		std::atomic<std::uint64_t> m_max;
+	};
+
+	// What the rules engine times, when latency tracking is enabled
+	enum class Operation
+	{
+		UPDATE, // GameController::update, checkmate search included
+		LOAD, // GameController::load
+		SAVE, // GameController::save
+		CHECKMATE_SEARCH, // search for a legal move after an update
+		MAX
+	};
+
+	// Readout of a histogram, in nanoseconds
+	struct LatencySummary
+	{
+		std::uint64_t count;
+		std::uint64_t p50;
+		std::uint64_t p99;
+		std::uint64_t p999;
+		std::uint64_t max;
+	};
+
+	// Enable or disable latency tracking (disabled by default)
+	// While disabled, timing an operation costs a single relaxed load.
+	void setLatencyTracking(bool enabled);
+
+	// Check whether latency tracking is enabled
+	bool isLatencyTracking();
+
+	// Get histogram of an operation
+	LatencyHistogram const& getLatencyHistogram(Operation operation);
+
+	// Get readout of the histogram of an operation
+	LatencySummary getLatencySummary(Operation operation);
+
+	// Empty the histograms of all operations
+	void resetLatency();
+
+	// Get name of operation, as printed by dumpLatency
+	char const* getOperationName(Operation operation);
+
+	// Print readout of every operation, one per line
+	void dumpLatency(std::ostream& os);
+
+	// Times the scope it lives in on the monotonic clock and records the
+	// duration in the histogram of the operation
+	class LatencyTimer
+	{
+	public:
+		explicit LatencyTimer(Operation operation);
+		~LatencyTimer();
+
+		LatencyTimer(LatencyTimer const&) = delete;
+		LatencyTimer& operator=(LatencyTimer const&) = delete;
+	private:
+		Operation m_operation;
+		bool m_enabled;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+}
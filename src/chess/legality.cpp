@@ -0,0 +1,165 @@
+#include "legality.h"
+
+#include <cassert>
+
+#include "history.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+namespace
+{
+	bool isSlider(PieceTypeId id)
+	{
+		return id == PieceTypeId::BISHOP ||
+		       id == PieceTypeId::ROOK ||
+		       id == PieceTypeId::QUEEN;
+	}
+
+	// Check whether any of the attackers, of given colour, attacks the
+	// target square on a board with the given occupancy
+	bool isAttacked(Square target, Bitboard occupied, Bitboard attackers,
+	                array<PieceTypeId, SQ_CNT> const& types, Colour colour)
+	{
+		while (attackers) {
+			auto const sq = popFirstSquare(attackers);
+			if (hasSquare(getAttacks(types[sq], colour, sq, occupied), target))
+				return true;
+		}
+		return false;
+	}
+}
+
+CheckInfo chesslib::getCheckInfo(GameState const& state)
+{
+	CheckInfo info;
+	info.turn = state.getTurn();
+	info.occupied = 0;
+	info.enemies = 0;
+	info.checkers = 0;
+	info.pinned = 0;
+
+	bool has_king = false;
+	for (Square sq = SQ_A1; sq < SQ_CNT; ++sq) {
+		auto const& piece = state.getPieceAt(sq);
+		auto const id = piece.getType()->getId();
+		info.types[sq] = id;
+		if (id == PieceTypeId::NONE)
+			continue;
+		info.occupied |= squareBit(sq);
+		if (piece.getColour() != info.turn) {
+			info.enemies |= squareBit(sq);
+		} else if (id == PieceTypeId::KING && !has_king) {
+			info.king = sq;
+			has_king = true;
+		}
+	}
+	assert(has_king); // all kings must be on the board
+	if (!has_king) {
+		info.king = SQ_CNT;
+		info.evasions = ~Bitboard(0);
+		return info;
+	}
+
+	auto const enemy = getOpponent(info.turn);
+	auto const straight = getRookMoves(info.king, 0);
+	auto const diagonal = getBishopMoves(info.king, 0);
+	Bitboard blocked_evasions = 0;
+
+	for (auto enemies = info.enemies; enemies; ) {
+		auto const sq = popFirstSquare(enemies);
+		auto const id = info.types[sq];
+
+		if (!isSlider(id)) {
+			if (hasSquare(getAttacks(id, enemy, sq, info.occupied), info.king)) {
+				info.checkers |= squareBit(sq);
+				blocked_evasions |= squareBit(sq);
+			}
+			continue;
+		}
+
+		// A slider that is lined up with the king either gives check
+		// or pins a piece of the king if that is all there is in between
+		bool const aligned =
+			(id != PieceTypeId::BISHOP && hasSquare(straight, sq)) ||
+			(id != PieceTypeId::ROOK && hasSquare(diagonal, sq));
+		if (!aligned)
+			continue;
+
+		auto const between = getSquaresBetween(info.king, sq);
+		auto const blockers = between & info.occupied;
+		if (blockers == 0) {
+			info.checkers |= squareBit(sq);
+			blocked_evasions |= between | squareBit(sq);
+		} else if ((blockers & (blockers - 1)) == 0 && !(blockers & info.enemies)) {
+			auto const pinned = getFirstSquare(blockers);
+			info.pinned |= blockers;
+			info.pin_lines[pinned] = between | squareBit(sq);
+		}
+	}
+
+	info.evasions = info.checkers ? blocked_evasions : ~Bitboard(0);
+	return info;
+}
+
+bool chesslib::isKingSafeAfter(GameState const& state, CheckInfo const& info,
+                               EventRecord const& record)
+{
+	auto const enemy = getOpponent(info.turn);
+
+	if (record.id == GameEventId::CASTLING) {
+		auto const rook = record.origin;
+		bool const white_rook = state.getPieceAt(rook).getColour() == Colour::WHITE;
+		Square const king = white_rook ? SQ_E1 : SQ_E8;
+		Direction const king_dir = (king < rook) ? DIR_EAST : DIR_WEST;
+		Square const king_dest = king + 2 * king_dir;
+		Square const rook_dest = king_dest - king_dir;
+		auto const occupied = (info.occupied & ~squareBit(king) & ~squareBit(rook)) |
+		                      squareBit(king_dest) | squareBit(rook_dest);
+
+		if ((white_rook ? Colour::WHITE : Colour::BLACK) == info.turn)
+			return !isAttacked(king_dest, occupied, info.enemies, info.types, enemy);
+
+		// Castling is not bound to the turn, so the pieces that
+		// move might as well be those of the opponent
+		auto types = info.types;
+		types[king_dest] = types[king];
+		types[rook_dest] = types[rook];
+		auto const enemies = (info.enemies & ~squareBit(king) & ~squareBit(rook)) |
+		                     squareBit(king_dest) | squareBit(rook_dest);
+		return !isAttacked(info.king, occupied, enemies, types, enemy);
+	}
+
+	auto const origin = record.origin;
+	auto const dest = record.dest;
+	auto const moved = info.types[origin];
+
+	if (moved == PieceTypeId::KING) {
+		auto const occupied = (info.occupied & ~squareBit(origin)) | squareBit(dest);
+		auto const enemies = info.enemies & ~squareBit(dest);
+		return !isAttacked(dest, occupied, enemies, info.types, enemy);
+	}
+
+	if (moved == PieceTypeId::PAWN && state.hasEnPassant() &&
+		state.getEnPassantPawn() == dest) {
+		// The captured pawn is not on the destination square
+		auto const captured = getEnPassantVictim(dest);
+		auto const occupied = (info.occupied & ~squareBit(origin) & ~squareBit(captured)) |
+		                      squareBit(dest);
+		auto const enemies = info.enemies & ~squareBit(captured) & ~squareBit(dest);
+		return !isAttacked(info.king, occupied, enemies, info.types, enemy);
+	}
+
+	// Two checks at once can only be escaped by moving the king
+	if (info.checkers & (info.checkers - 1))
+		return false;
+
+	if (!hasSquare(info.evasions, dest))
+		return false;
+
+	if (hasSquare(info.pinned, origin) && !hasSquare(info.pin_lines[origin], dest))
+		return false;
+
+	return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array> // std::array
+
+#include "bitboard.h" // Bitboard
+#include "event.h" // EventRecord
+#include "types.h" // Square, Colour, PieceTypeId
+
+namespace chesslib
+{
+
+	class GameState;
+
+	// What the king of the player to move is exposed to, which is all it
+	// takes to tell whether a move leaves it in check without applying it
+	struct CheckInfo
+	{
+		Colour turn;
+		Square king;
+		Bitboard occupied;
+		Bitboard enemies; // squares of the pieces of the opponent
+		Bitboard checkers; // enemy pieces that attack the king
+		Bitboard evasions; // where a piece other than the king must go
+		Bitboard pinned; // pieces that shield the king from a slider
+		std::array<Bitboard, SQ_CNT> pin_lines; // where pinned pieces may go
+		std::array<PieceTypeId, SQ_CNT> types;
+	};
+
+	// Find checks and pins against the king of the player to move
+	CheckInfo getCheckInfo(GameState const& state);
+
+	// Check whether an event that is valid in the game state (according
+	// to GameEvent::isValid) leaves the king of the player to move safe.
+	// Most moves are decided by a few bit tests; king moves, en passant
+	// and castling are decided by looking for attacks on the board as
+	// it would be after the event.
+	bool isKingSafeAfter(GameState const& state, CheckInfo const& info,
+	                     EventRecord const& record);
+
+}
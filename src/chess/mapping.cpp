@@ -0,0 +1,138 @@
+#include "mapping.h"
+
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace chesslib;
+
+MappedFile::MappedFile() :
+	m_data(nullptr),
+	m_size(0)
+#if defined(_WIN32)
+	, m_file(nullptr)
+	, m_mapping(nullptr)
+#endif
+{}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+	MappedFile()
+{
+	*this = move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other) {
+		close();
+		swap(m_data, other.m_data);
+		swap(m_size, other.m_size);
+#if defined(_WIN32)
+		swap(m_file, other.m_file);
+		swap(m_mapping, other.m_mapping);
+#endif
+	}
+	return *this;
+}
+
+bool MappedFile::open(filesystem::path const& path)
+{
+	close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+	                          nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+	                          nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY,
+	                                    0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	m_file = file;
+	m_mapping = mapping;
+	m_data = data;
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+	                  MAP_SHARED, fd, 0);
+	::close(fd); // the mapping keeps the file referenced
+	if (data == MAP_FAILED)
+		return false;
+	madvise(data, static_cast<size_t>(st.st_size), MADV_RANDOM);
+	m_data = data;
+	m_size = static_cast<size_t>(st.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data == nullptr)
+		return;
+
+#if defined(_WIN32)
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mapping);
+	CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	munmap(const_cast<void*>(m_data), m_size);
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+	return m_data != nullptr;
+}
+
+unsigned char const* MappedFile::data() const
+{
+	return static_cast<unsigned char const*>(m_data);
+}
+
+size_t MappedFile::size() const
+{
+	return m_size;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef> // std::size_t
+#include <filesystem> // std::filesystem::path
+
+namespace chesslib
+{
+
+	// Read-only memory mapping of a whole file. The operating system loads
+	// pages lazily as they are touched and shares them between processes
+	// that map the same file, so opening large tables costs nothing upfront.
+	class MappedFile
+	{
+	public:
+		// Create an empty mapping
+		MappedFile();
+
+		// Unmap file
+		~MappedFile();
+
+		// A mapping cannot be copied, only moved
+		MappedFile(MappedFile const&) = delete;
+		MappedFile& operator=(MappedFile const&) = delete;
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		// Map file into memory
+		// Returns true on success
+		bool open(std::filesystem::path const& path);
+
+		// Unmap file
+		void close();
+
+		// Check whether a file is mapped
+		bool isOpen() const;
+
+		// Get mapped bytes
+		unsigned char const* data() const;
+
+		// Get number of mapped bytes
+		std::size_t size() const;
+	private:
+		void const* m_data;
+		std::size_t m_size;
+#if defined(_WIN32)
+		void* m_file;
+		void* m_mapping;
+#endif
+	};
+
+}
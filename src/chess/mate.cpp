@@ -0,0 +1,413 @@
+#include "mate.h"
+
+#include <algorithm>
+
+#include "history.h"
+#include "legality.h"
+#include "movegen.h"
+#include "state.h"
+#include "trace.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Proof or disproof number of a position that cannot be proved or
+// disproved, respectively (sums saturate at it)
+static const uint32_t infinity = 1u << 30;
+
+// Depth of the positions whose outcome does not depend on the plies left
+static const unsigned int any_depth = 255;
+
+// Mixed into the hashes of the table when black is the attacker, as the
+// same position is proved for one player and disproved for the other
+static const uint64_t black_attacker_key = 0x9e3779b97f4a7c15;
+
+// Piece types a pawn can be promoted to
+static const PieceTypeId promotions[] = {
+	PieceTypeId::QUEEN,
+	PieceTypeId::ROOK,
+	PieceTypeId::BISHOP,
+	PieceTypeId::KNIGHT,
+};
+
+static uint32_t addNumbers(uint32_t a, uint32_t b)
+{
+	return min(a + b, infinity);
+}
+
+MateTable::MateTable(size_t megabytes)
+{
+	size_t entries = 2;
+	while (entries * 2 * sizeof(Entry) <= megabytes * 1024 * 1024)
+		entries *= 2;
+	m_entries = make_unique<Entry[]>(entries);
+	m_mask = entries - 1;
+	clear();
+}
+
+MateTable::Entry const* MateTable::probe(uint64_t hash) const
+{
+	auto const slot = hash & m_mask & ~size_t(1);
+	for (size_t i = slot; i <= slot + 1; ++i)
+		if (m_entries[i].key == hash && m_entries[i].proof + m_entries[i].disproof != 0)
+			return &m_entries[i];
+	return nullptr;
+}
+
+void MateTable::store(Entry const& entry)
+{
+	auto const slot = entry.key & m_mask & ~size_t(1);
+	auto const isEmpty = [] (Entry const& e) { return e.proof + e.disproof == 0; };
+	auto const isSolved = [] (Entry const& e) { return e.proof == 0 || e.disproof == 0; };
+	auto& first = m_entries[slot];
+	auto& second = m_entries[slot + 1];
+	if (first.key == entry.key || isEmpty(first))
+		first = entry;
+	else if (second.key == entry.key || isEmpty(second))
+		second = entry;
+	else if (isSolved(first) && !isSolved(second))
+		second = entry;
+	else
+		first = entry;
+}
+
+void MateTable::clear()
+{
+	// An entry with both numbers at 0 is an empty slot
+	fill(m_entries.get(), m_entries.get() + m_mask + 1, Entry{ 0, 0, 0, 0, 0 });
+}
+
+MateSolver::MateSolver(MateOptions const& options) :
+	m_options(options),
+	m_table(max<size_t>(1, options.table_megabytes)),
+	m_children(2 * max_mate_moves + 1),
+	m_events(2 * max_mate_moves + 1),
+	m_stop(false),
+	m_attacker_key(0),
+	m_nodes(0),
+	m_node_limit(0),
+	m_aborted(false)
+{
+	for (auto& children : m_children)
+		children.reserve(256);
+	for (auto& events : m_events)
+		events.reserve(256);
+}
+
+MateResult MateSolver::solve(GameState const& state, unsigned int moves)
+{
+	CHESS_TRACE_SCOPE("solveMate");
+	m_nodes = 0;
+	m_node_limit = m_options.nodes;
+	m_aborted = false;
+	m_path.clear();
+	m_attacker_key = state.getTurn() == Colour::WHITE ? 0 : black_attacker_key;
+
+	GameState root(state);
+	MateResult result{ MateOutcome::NO_MATE, {}, 0 };
+	if (moves == 0) {
+		m_stop.store(false, memory_order_relaxed);
+		return result;
+	}
+
+	// Mates are searched again with fewer moves until there is none, but
+	// every search is quicker than the previous one, as the table keeps
+	// the proofs of the positions that are mated soon enough
+	auto depth = 2 * min(moves, max_mate_moves) - 1;
+	unsigned int distance = 0;
+	while (true) {
+		auto const numbers = solveNode(root, depth, true, 0);
+		if (m_aborted) {
+			if (distance == 0)
+				result.outcome = MateOutcome::UNKNOWN;
+			break;
+		}
+		if (numbers.proof != 0)
+			break;
+		distance = numbers.distance;
+		if (distance < 3)
+			break;
+		depth = distance - 2;
+	}
+
+	if (distance > 0) {
+		// The line is built from proofs already in the table, searching
+		// again only those that were overwritten, whatever the budget
+		result.outcome = MateOutcome::MATE;
+		m_node_limit = 0;
+		m_aborted = false;
+		buildLine(root, distance, result.line);
+	}
+
+	m_stop.store(false, memory_order_relaxed);
+	result.nodes = m_nodes;
+	return result;
+}
+
+void MateSolver::stop()
+{
+	m_stop.store(true, memory_order_relaxed);
+}
+
+void MateSolver::clear()
+{
+	m_table.clear();
+}
+
+MateOptions const& MateSolver::getOptions() const
+{
+	return m_options;
+}
+
+MateSolver::Numbers MateSolver::searchNode(GameState& state, unsigned int depth, bool attacker,
+                                           uint32_t proof_threshold, uint32_t disproof_threshold,
+                                           unsigned int ply)
+{
+	auto const hash = state.getHash();
+	auto const solved = [&] (bool proved, unsigned int distance, unsigned int valid_depth) {
+		Numbers const numbers{ proved ? 0 : infinity, proved ? infinity : 0, distance };
+		m_table.store(MateTable::Entry{ hash ^ m_attacker_key, numbers.proof, numbers.disproof,
+		                                static_cast<uint8_t>(valid_depth),
+		                                static_cast<uint8_t>(distance) });
+		return numbers;
+	};
+
+	if (isOutOfBudget())
+		return Numbers{ 1, 1, 0 };
+	++m_nodes;
+
+	// The game ends as GameController::lookForCheckmate says, before
+	// anything else is looked at
+	auto const info = getCheckInfo(state);
+	LegalMoves legal;
+	generateLegalMoves(state, info, legal);
+	bool const has_moves = any_of(legal.destinations.begin(), legal.destinations.end(),
+	                              [] (Bitboard dests) { return dests != 0; });
+	if (!has_moves)
+		return solved(!attacker && info.checkers != 0, 0, any_depth);
+	if (depth == 0)
+		return solved(false, 0, 0);
+	if (state.getHalfmoveClock() >= 100)
+		return Numbers{ infinity, 0, 0 };
+
+	// The clock is not part of the hash, so a position whose plies left
+	// may reach the fifty-move rule is only stored once proved, as the
+	// draw can only disprove it
+	bool const clock_free = state.getHalfmoveClock() + depth < 100;
+
+	// Children start from what the table knows about them, or else from
+	// the fewest positions that could prove or disprove them
+	auto& children = m_children[ply];
+	auto& events = m_events[ply];
+	children.clear();
+	listEvents(info, legal, events);
+	m_path.push_back(hash);
+	UndoRecord undo;
+	for (auto const& record : events) {
+		applyEvent(state, record, undo);
+		bool keep = true;
+		if (attacker && m_options.checks_only)
+			keep = getCheckInfo(state).checkers != 0;
+		if (keep) {
+			auto const child = state.getHash();
+			Numbers numbers{ infinity, 0, 0 };
+			if (find(m_path.begin(), m_path.end(), child) == m_path.end())
+				numbers = lookUp(state, depth - 1);
+			children.push_back(Child{ record, numbers });
+		}
+		revertEvent(state, undo);
+	}
+	if (children.empty()) {
+		m_path.pop_back();
+		return solved(false, 0, depth);
+	}
+
+	// The attacker needs a single child proved, the defender all of them
+	Numbers numbers;
+	while (true) {
+		numbers = Numbers{ attacker ? infinity : 0, attacker ? 0 : infinity, 0 };
+		size_t best = 0;
+		uint32_t second = infinity;
+		for (size_t i = 0; i < children.size(); ++i) {
+			auto const& child = children[i].numbers;
+			auto const own = attacker ? child.proof : child.disproof;
+			auto const best_own = attacker ? children[best].numbers.proof :
+				children[best].numbers.disproof;
+			if (attacker) {
+				numbers.proof = min(numbers.proof, child.proof);
+				numbers.disproof = addNumbers(numbers.disproof, child.disproof);
+			} else {
+				numbers.proof = addNumbers(numbers.proof, child.proof);
+				numbers.disproof = min(numbers.disproof, child.disproof);
+			}
+			if (i == 0)
+				continue;
+			if (own < best_own) {
+				second = best_own;
+				best = i;
+			} else if (own < second) {
+				second = own;
+			}
+		}
+		if (numbers.proof >= proof_threshold || numbers.disproof >= disproof_threshold ||
+		    m_aborted)
+			break;
+
+		// The most promising child is searched until it is no longer the
+		// most promising one, or the position reaches its threshold
+		auto& child = children[best];
+		uint32_t child_proof, child_disproof;
+		if (attacker) {
+			child_proof = min(proof_threshold, addNumbers(second, 1));
+			child_disproof = disproof_threshold >= infinity ? infinity :
+				disproof_threshold - numbers.disproof + child.numbers.disproof;
+		} else {
+			child_proof = proof_threshold >= infinity ? infinity :
+				proof_threshold - numbers.proof + child.numbers.proof;
+			child_disproof = min(disproof_threshold, addNumbers(second, 1));
+		}
+		applyEvent(state, child.record, undo);
+		child.numbers = searchNode(state, depth - 1, !attacker, child_proof, child_disproof,
+		                           ply + 1);
+		revertEvent(state, undo);
+	}
+	m_path.pop_back();
+
+	// The attacker mates by the quickest child, the defender is mated by
+	// the slowest one
+	if (numbers.proof == 0) {
+		unsigned int distance = attacker ? any_depth : 0;
+		for (auto const& child : children)
+			if (child.numbers.proof == 0)
+				distance = attacker ? min(distance, child.numbers.distance) :
+					max(distance, child.numbers.distance);
+		numbers.distance = distance + 1;
+	}
+	if (clock_free || numbers.proof == 0)
+		m_table.store(MateTable::Entry{ hash ^ m_attacker_key, numbers.proof, numbers.disproof,
+		                                static_cast<uint8_t>(depth),
+		                                static_cast<uint8_t>(numbers.distance) });
+	return numbers;
+}
+
+MateSolver::Numbers MateSolver::solveNode(GameState& state, unsigned int depth, bool attacker,
+                                          unsigned int ply)
+{
+	return searchNode(state, depth, attacker, infinity, infinity, ply);
+}
+
+MateSolver::Numbers MateSolver::lookUp(GameState const& state, unsigned int depth) const
+{
+	auto const entry = m_table.probe(state.getHash() ^ m_attacker_key);
+	if (!entry)
+		return Numbers{ 1, 1, 0 };
+	// A mate in fewer plies is a mate in more (if it comes before the
+	// fifty-move rule), and no mate in more plies is no mate in fewer,
+	// but other numbers only hold for the same plies
+	if (entry->proof == 0 && entry->distance <= depth &&
+	    state.getHalfmoveClock() + entry->distance <= 100)
+		return Numbers{ 0, infinity, entry->distance };
+	if (entry->disproof == 0 && entry->depth >= depth)
+		return Numbers{ infinity, 0, 0 };
+	if (entry->proof != 0 && entry->disproof != 0 && entry->depth == depth)
+		return Numbers{ entry->proof, entry->disproof, 0 };
+	return Numbers{ 1, 1, 0 };
+}
+
+template<Colour C>
+void MateSolver::listEvents(CheckInfo const& info, LegalMoves const& legal,
+                            vector<EventRecord>& events)
+{
+	getLegalEvents(legal, events);
+
+	constexpr Rank last_rank = ColourTraits<C>::promotion_rank;
+	auto const cnt = events.size();
+	for (size_t i = 0; i < cnt; ++i) {
+		auto const record = events[i];
+		if (record.id != GameEventId::MOVE || info.types[record.origin] != PieceTypeId::PAWN ||
+		    getSquareRank(record.dest) != last_rank)
+			continue;
+		events[i].promotion = promotions[0];
+		for (size_t p = 1; p < size(promotions); ++p)
+			events.push_back(EventRecord{ GameEventId::MOVE, record.origin, record.dest,
+			                              promotions[p] });
+	}
+}
+
+void MateSolver::listEvents(CheckInfo const& info, LegalMoves const& legal,
+                            vector<EventRecord>& events)
+{
+	if (info.turn == Colour::WHITE)
+		listEvents<Colour::WHITE>(info, legal, events);
+	else
+		listEvents<Colour::BLACK>(info, legal, events);
+}
+
+void MateSolver::buildLine(GameState& state, unsigned int depth, vector<EventRecord>& line)
+{
+	vector<UndoRecord> undos;
+	vector<EventRecord> events;
+	bool attacker = true;
+	m_path.clear();
+
+	// Distances in the table only bound the mates from above, but the
+	// distance of the root is exact, as the search with two plies less
+	// found no mate. So is the distance of every position of the line:
+	// the attacker plays any event that mates in one ply less, and the
+	// defender one after which there is no mate in three plies less.
+	while (depth > 0) {
+		auto const info = getCheckInfo(state);
+		LegalMoves legal;
+		generateLegalMoves(state, info, legal);
+		listEvents(info, legal, events);
+		m_path.push_back(state.getHash());
+
+		// Positions whose numbers were overwritten are searched again,
+		// which takes no longer than it did the first time
+		auto const ply = static_cast<unsigned int>(line.size()) + 1;
+		auto const prove = [&] (unsigned int child_depth) {
+			auto numbers = lookUp(state, child_depth);
+			if (numbers.proof != 0 && numbers.disproof != 0)
+				numbers = solveNode(state, child_depth, !attacker, ply);
+			return numbers;
+		};
+
+		auto chosen = events.end();
+		UndoRecord undo;
+		for (auto it = events.begin(); it != events.end() && chosen == events.end(); ++it) {
+			applyEvent(state, *it, undo);
+			if (find(m_path.begin(), m_path.end(), state.getHash()) == m_path.end()) {
+				if (attacker) {
+					if ((!m_options.checks_only || getCheckInfo(state).checkers != 0) &&
+					    prove(depth - 1).proof == 0)
+						chosen = it;
+				} else if (depth < 4 || prove(depth - 3).disproof == 0) {
+					chosen = it;
+				}
+			}
+			revertEvent(state, undo);
+		}
+		if (chosen == events.end())
+			break;
+
+		undos.emplace_back();
+		applyEvent(state, *chosen, undos.back());
+		line.push_back(*chosen);
+		--depth;
+		attacker = !attacker;
+	}
+
+	while (!undos.empty()) {
+		revertEvent(state, undos.back());
+		undos.pop_back();
+	}
+}
+
+bool MateSolver::isOutOfBudget()
+{
+	if (m_aborted)
+		return true;
+	if ((m_node_limit != 0 && m_nodes >= m_node_limit) || m_stop.load(memory_order_relaxed))
+		m_aborted = true;
+	return m_aborted;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <atomic> // std::atomic
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint8_t, std::uint32_t, std::uint64_t
+#include <memory> // std::unique_ptr
+#include <vector> // std::vector
+
+#include "event.h" // EventRecord
+#include "legality.h" // CheckInfo
+#include "movegen.h" // LegalMoves
+
+namespace chesslib
+{
+
+	class GameState;
+
+	// Longest mate looked for, in moves of the attacker
+	constexpr unsigned int max_mate_moves = 100;
+
+	// How a mate is looked for
+	struct MateOptions
+	{
+		std::size_t table_megabytes = 16; // proof table
+		bool checks_only = false; // only try events of the attacker that give check
+		std::uint64_t nodes = 0; // positions visited before giving up, 0 for no limit
+	};
+
+	// What a mate search proved
+	enum class MateOutcome
+	{
+		MATE, // the attacker mates, whatever the defender does
+		NO_MATE, // the defender escapes the mate within the moves given
+		UNKNOWN, // the search ran out of nodes or was stopped
+	};
+
+	// Outcome of a mate search
+	struct MateResult
+	{
+		MateOutcome outcome;
+		std::vector<EventRecord> line; // shortest mate against the longest defence
+		std::uint64_t nodes; // positions visited
+	};
+
+	// Hash table of what the mate search learnt about positions. Entries
+	// store the proof and disproof numbers of a position, searched to a
+	// number of plies, and once it is proved, how many plies it takes to
+	// mate from it.
+	class MateTable
+	{
+	public:
+		struct Entry
+		{
+			std::uint64_t key;
+			std::uint32_t proof; // 0 once proved
+			std::uint32_t disproof; // 0 once disproved
+			std::uint8_t depth; // plies searched
+			std::uint8_t distance; // plies until the mate, once proved
+		};
+
+		// Create table of about the given size in megabytes (rounded
+		// down to a power of two entries)
+		explicit MateTable(std::size_t megabytes);
+
+		// A table cannot be copied
+		MateTable(MateTable const&) = delete;
+		MateTable& operator=(MateTable const&) = delete;
+
+		// Look up position hash
+		// Returns the entry, or nullptr if the position is not stored
+		Entry const* probe(std::uint64_t hash) const;
+
+		// Store what was found about a position hash, in whichever of its
+		// two slots holds the same position, or else the one that knows
+		// less (positions proved or disproved are kept over the others)
+		void store(Entry const& entry);
+
+		// Forget every entry
+		void clear();
+	private:
+		std::unique_ptr<Entry[]> m_entries;
+		std::size_t m_mask;
+	};
+
+	// Depth-first proof-number search (df-pn) of a forced mate by the
+	// player to move, the attacker, within a number of moves. It follows
+	// the rules of GameController: a player with no move other than
+	// castling is checkmated if in check, and stalemated otherwise (see
+	// lookForCheckmate), and the fifty-move rule ends the game as a draw.
+	//
+	// The search grows the tree towards the positions that are the
+	// easiest to prove or disprove, which finds long mates with narrow
+	// trees much sooner than alpha-beta does. Once a mate is found, the
+	// search is run again with fewer moves until none is left, so that
+	// the mate returned is the shortest one.
+	//
+	// Repeating a position of the line counts as no mate, which never
+	// makes a mate that does not exist, but, in rare positions where the
+	// table mixes up lines, may hide one.
+	//
+	// A solver is used by one thread at a time, and keeps its table from
+	// one search to the next.
+	class MateSolver
+	{
+	public:
+		// Create solver with the given options
+		explicit MateSolver(MateOptions const& options = MateOptions());
+
+		// A solver cannot be copied
+		MateSolver(MateSolver const&) = delete;
+		MateSolver& operator=(MateSolver const&) = delete;
+
+		// Look for a mate by the player to move in at most the given
+		// number of moves (at most max_mate_moves)
+		MateResult solve(GameState const& state, unsigned int moves);
+
+		// Make the search stop as soon as possible, from any thread (or
+		// the next search to start, if none is going on)
+		void stop();
+
+		// Forget what was learnt in previous searches
+		void clear();
+
+		// Get options the solver searches with
+		MateOptions const& getOptions() const;
+	private:
+		// Proof and disproof numbers of a position
+		struct Numbers
+		{
+			std::uint32_t proof;
+			std::uint32_t disproof;
+			unsigned int distance; // plies until the mate, once proved
+		};
+
+		// Position reached by an event, as known to its parent
+		struct Child
+		{
+			EventRecord record;
+			Numbers numbers;
+		};
+
+		// Search position until its proof or disproof number reaches its
+		// threshold, with the given number of plies left, the attacker or
+		// the defender to move
+		Numbers searchNode(GameState& state, unsigned int depth, bool attacker,
+		                   std::uint32_t proof_threshold, std::uint32_t disproof_threshold,
+		                   unsigned int ply);
+
+		// Search position until it is proved or disproved
+		Numbers solveNode(GameState& state, unsigned int depth, bool attacker,
+		                  unsigned int ply);
+
+		// Look up what is known about a position, searched to the given
+		// number of plies
+		Numbers lookUp(GameState const& state, unsigned int depth) const;
+
+		// List legal events of the player to move, each promotion piece
+		// as an event of its own
+		static void listEvents(CheckInfo const& info, LegalMoves const& legal,
+		                       std::vector<EventRecord>& events);
+
+		// List legal events, with colour C to move
+		template<Colour C>
+		static void listEvents(CheckInfo const& info, LegalMoves const& legal,
+		                       std::vector<EventRecord>& events);
+
+		// Follow the proof from the root, which mates in exactly the given
+		// number of plies, choosing the longest defence for the defender
+		void buildLine(GameState& state, unsigned int depth, std::vector<EventRecord>& line);
+
+		// Check whether the search ran out of nodes, or was stopped
+		bool isOutOfBudget();
+	private:
+		MateOptions m_options;
+		MateTable m_table;
+		std::vector<std::vector<Child>> m_children; // by ply
+		std::vector<std::vector<EventRecord>> m_events; // by ply
+		std::vector<std::uint64_t> m_path; // hashes of the line
+		std::atomic<bool> m_stop;
+		std::uint64_t m_attacker_key; // mixed into the hashes of the table
+		std::uint64_t m_nodes;
+		std::uint64_t m_node_limit; // 0 for no limit
+		bool m_aborted;
+	};
+
+}
@@ -0,0 +1,180 @@
+#include "movegen.h"
+
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+static const Square castling_rooks[castling_corner_cnt] = {
+	SQ_A1, SQ_H1, SQ_A8, SQ_H8,
+};
+
+Square chesslib::getCastlingRook(int corner)
+{
+	return castling_rooks[corner];
+}
+
+int chesslib::getCastlingCorner(Square rook)
+{
+	for (int corner = 0; corner < castling_corner_cnt; ++corner)
+		if (castling_rooks[corner] == rook)
+			return corner;
+	return -1;
+}
+
+namespace
+{
+	// Get bitboard with square at an offset from another, if it is on
+	// the board (pawns step by square index, so they may wrap around the
+	// edges of the board, as Pawn::canApply allows them to)
+	Bitboard getOffsetBit(Square sq, Direction dir)
+	{
+		auto const dest = static_cast<int>(sq) + static_cast<int>(dir);
+		return (dest >= 0 && dest < SQ_CNT) ? squareBit(static_cast<Square>(dest)) : 0;
+	}
+
+	template<Colour C>
+	Bitboard getPawnMoves(GameState const& state, CheckInfo const& info,
+	                      Square sq, Bitboard capturable)
+	{
+		using Traits = ColourTraits<C>;
+
+		// The en passant square counts as occupied, whether or not
+		// it is, so pawns capture on it and never advance onto it
+		Bitboard enpassant = 0;
+		if (state.hasEnPassant())
+			enpassant = squareBit(state.getEnPassantPawn());
+		auto const empty = ~info.occupied & ~enpassant;
+
+		Bitboard moves = getOffsetBit(sq, Traits::forward) & empty;
+		if (getSquareRank(sq) == Traits::pawn_rank)
+			moves |= getOffsetBit(sq, Traits::forward * 2) & empty;
+		moves |= (getOffsetBit(sq, Traits::forward + DIR_EAST) |
+		          getOffsetBit(sq, Traits::forward + DIR_WEST)) &
+		         (capturable | (enpassant & ~info.occupied));
+		return moves;
+	}
+}
+
+template<Colour C>
+void chesslib::generateLegalMoves(GameState const& state, CheckInfo const& info,
+                                  LegalMoves& moves)
+{
+	moves.destinations.fill(0);
+	moves.castlings = 0;
+
+	auto const own = info.occupied & ~info.enemies;
+
+	// Kings are never captured
+	auto capturable = info.enemies;
+	for (auto enemies = info.enemies; enemies; ) {
+		auto const sq = popFirstSquare(enemies);
+		if (info.types[sq] == PieceTypeId::KING)
+			capturable &= ~squareBit(sq);
+	}
+	auto const targets = ~info.occupied | capturable;
+
+	bool const double_check = (info.checkers & (info.checkers - 1)) != 0;
+	auto const enpassant = state.hasEnPassant() ? state.getEnPassantPawn() : SQ_CNT;
+
+	for (auto pieces = own; pieces; ) {
+		auto const sq = popFirstSquare(pieces);
+		Bitboard dests = 0;
+
+		switch (info.types[sq]) {
+		case PieceTypeId::KING:
+			// The king has to look at the board it moves into
+			for (auto candidates = getKingMoves(sq) & targets; candidates; ) {
+				auto const dest = popFirstSquare(candidates);
+				EventRecord const record{ GameEventId::MOVE, sq, dest, PieceTypeId::NONE };
+				if (isKingSafeAfter(state, info, record))
+					dests |= squareBit(dest);
+			}
+			moves.destinations[sq] = dests;
+			continue;
+		case PieceTypeId::PAWN:
+			dests = getPawnMoves<C>(state, info, sq, capturable);
+			break;
+		case PieceTypeId::KNIGHT:
+			dests = getKnightMoves(sq) & targets;
+			break;
+		case PieceTypeId::BISHOP:
+			dests = getBishopMoves(sq, info.occupied) & targets;
+			break;
+		case PieceTypeId::ROOK:
+			dests = getRookMoves(sq, info.occupied) & targets;
+			break;
+		case PieceTypeId::QUEEN:
+			dests = getQueenMoves(sq, info.occupied) & targets;
+			break;
+		default:
+			break;
+		}
+
+		// En passant removes a piece that is not on the destination
+		// square, which no mask accounts for
+		Bitboard enpassant_dest = 0;
+		if (info.types[sq] == PieceTypeId::PAWN && enpassant != SQ_CNT &&
+			hasSquare(dests, enpassant)) {
+			dests &= ~squareBit(enpassant);
+			EventRecord const record{ GameEventId::MOVE, sq, enpassant, PieceTypeId::NONE };
+			if (isKingSafeAfter(state, info, record))
+				enpassant_dest = squareBit(enpassant);
+		}
+
+		if (double_check)
+			dests = 0;
+		dests &= info.evasions;
+		if (hasSquare(info.pinned, sq))
+			dests &= info.pin_lines[sq];
+
+		moves.destinations[sq] = dests | enpassant_dest;
+	}
+
+	for (int corner = 0; corner < castling_corner_cnt; ++corner) {
+		Castling castling(castling_rooks[corner]);
+		if (castling.isValid(state) &&
+			isKingSafeAfter(state, info, castling.getRecord()))
+			moves.castlings |= static_cast<uint8_t>(1 << corner);
+	}
+}
+
+template void chesslib::generateLegalMoves<Colour::WHITE>(
+	GameState const& state, CheckInfo const& info, LegalMoves& moves);
+template void chesslib::generateLegalMoves<Colour::BLACK>(
+	GameState const& state, CheckInfo const& info, LegalMoves& moves);
+
+void chesslib::generateLegalMoves(GameState const& state, CheckInfo const& info,
+                                  LegalMoves& moves)
+{
+	if (info.turn == Colour::WHITE)
+		generateLegalMoves<Colour::WHITE>(state, info, moves);
+	else
+		generateLegalMoves<Colour::BLACK>(state, info, moves);
+}
+
+void chesslib::getLegalEvents(LegalMoves const& moves, vector<EventRecord>& events)
+{
+	events.clear();
+	for (Square origin = SQ_A1; origin < SQ_CNT; ++origin)
+		for (auto dests = moves.destinations[origin]; dests; )
+			events.push_back(EventRecord{ GameEventId::MOVE, origin,
+			                              popFirstSquare(dests),
+			                              PieceTypeId::NONE });
+	for (int corner = 0; corner < castling_corner_cnt; ++corner)
+		if (moves.castlings & (1 << corner))
+			events.push_back(EventRecord{ GameEventId::CASTLING,
+			                              castling_rooks[corner], SQ_CNT,
+			                              PieceTypeId::NONE });
+}
+
+unsigned int chesslib::countLegalMoves(LegalMoves const& moves)
+{
+	unsigned int count = 0;
+	for (auto dests : moves.destinations)
+		count += countSquares(dests);
+	for (int corner = 0; corner < castling_corner_cnt; ++corner)
+		if (moves.castlings & (1 << corner))
+			++count;
+	return count;
+}
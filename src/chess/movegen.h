@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array> // std::array
+#include <cstdint> // std::uint8_t
+#include <vector> // std::vector
+
+#include "bitboard.h" // Bitboard
+#include "event.h" // EventRecord
+#include "legality.h" // CheckInfo
+#include "types.h" // Square, Colour
+
+namespace chesslib
+{
+
+	class GameState;
+
+	// Number of corners a rook can castle from
+	constexpr int castling_corner_cnt = 4;
+
+	// Get rook square of a castling corner (a1, h1, a8 and h8, in order)
+	Square getCastlingRook(int corner);
+
+	// Get castling corner of a rook square, or -1 if it is not a corner
+	int getCastlingCorner(Square rook);
+
+	// Every event the player to move can make, as accepted by
+	// GameController::canUpdate
+	struct LegalMoves
+	{
+		std::array<Bitboard, SQ_CNT> destinations; // by origin square
+		std::uint8_t castlings; // one bit per castling corner
+	};
+
+	// Generate legal moves of the player of colour C, whose turn it is,
+	// with the directions and ranks of pawns known at compile time
+	template<Colour C>
+	void generateLegalMoves(GameState const& state, CheckInfo const& info,
+	                        LegalMoves& moves);
+
+	// Generate legal moves of the player to move, choosing the colour
+	// specialisation once per position
+	void generateLegalMoves(GameState const& state, CheckInfo const& info,
+	                        LegalMoves& moves);
+
+	// List legal moves as event records
+	void getLegalEvents(LegalMoves const& moves, std::vector<EventRecord>& events);
+
+	// Count legal moves
+	unsigned int countLegalMoves(LegalMoves const& moves);
+
+}
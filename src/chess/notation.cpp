@@ -0,0 +1,104 @@
+#include "notation.h"
+
+#include <iostream>
+#include <sstream>
+
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Letters of promotions, indexed by piece type
+static const char promotion_letters[] = "???qbnr";
+
+optional<Square> chesslib::parseSquare(string const& text)
+{
+	if (text.size() != 2)
+		return nullopt;
+	auto f = File(text[0] - 'a');
+	auto r = Rank(text[1] - '1');
+	if (!FileCheck(f) || !RankCheck(r))
+		return nullopt;
+	return getSquare(r, f);
+}
+
+optional<PieceTypeId> chesslib::parsePromotion(string const& text)
+{
+	if (text.size() != 1)
+		return nullopt;
+	switch (text[0]) {
+	case 'q':
+		return PieceTypeId::QUEEN;
+	case 'r':
+		return PieceTypeId::ROOK;
+	case 'b':
+		return PieceTypeId::BISHOP;
+	case 'n':
+		return PieceTypeId::KNIGHT;
+	default:
+		return nullopt;
+	}
+}
+
+optional<EventRecord> chesslib::parseEvent(GameState const& state,
+                                           string const& text)
+{
+	if (text.size() != 4 && text.size() != 5)
+		return nullopt;
+
+	auto origin = parseSquare(text.substr(0, 2));
+	auto dest = parseSquare(text.substr(2, 2));
+	if (!origin || !dest)
+		return nullopt;
+
+	auto promotion = PieceTypeId::NONE;
+	if (text.size() == 5) {
+		auto const letter = parsePromotion(text.substr(4));
+		if (!letter)
+			return nullopt;
+		promotion = *letter;
+	}
+
+	// A king never moves onto a piece of its own colour, but it does
+	// look like it when castling
+	auto const& moved = state.getPieceAt(*origin);
+	auto const& captured = state.getPieceAt(*dest);
+	if (moved.getType()->getId() == PieceTypeId::KING &&
+		captured.getType()->getId() == PieceTypeId::ROOK &&
+		moved.getColour() == captured.getColour()) {
+		if (promotion != PieceTypeId::NONE)
+			return nullopt;
+		return EventRecord{ GameEventId::CASTLING, *dest, SQ_CNT, PieceTypeId::NONE };
+	}
+
+	return EventRecord{ GameEventId::MOVE, *origin, *dest, promotion };
+}
+
+string chesslib::formatEvent(EventRecord const& record)
+{
+	ostringstream ss;
+	if (record.id == GameEventId::CASTLING) {
+		ss << getSquare(getSquareRank(record.origin), FL_E) << record.origin;
+	} else {
+		ss << record.origin << record.dest;
+		if (record.promotion != PieceTypeId::NONE)
+			ss << promotion_letters[static_cast<int>(record.promotion)];
+	}
+	return ss.str();
+}
+
+vector<string> chesslib::readMoveList(istream& is)
+{
+	vector<string> events;
+	string line;
+	while (getline(is, line)) {
+		auto comment = line.find('#');
+		if (comment != string::npos)
+			line.erase(comment);
+		istringstream ss(line);
+		string event;
+		while (ss >> event)
+			events.push_back(event);
+	}
+	return events;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <iosfwd> // std::istream
+#include <optional> // std::optional
+#include <string> // std::string
+#include <vector> // std::vector
+
+#include "event.h" // EventRecord
+#include "types.h" // Square, PieceTypeId
+
+namespace chesslib
+{
+
+	class GameState;
+
+	// Events are written in coordinate notation: the origin square
+	// followed by the destination square ("e2e4"), plus the letter of the
+	// piece type a pawn was promoted to, if any ("e7e8q"). Castling is
+	// written as the king square followed by the rook square ("e1h1").
+
+	// Parse square, such as "e4"
+	// Returns nullopt if the text is not a square
+	std::optional<Square> parseSquare(std::string const& text);
+
+	// Parse letter of a piece type a pawn can be promoted to ("q", "r",
+	// "b" or "n")
+	// Returns nullopt if the text is not such a letter
+	std::optional<PieceTypeId> parsePromotion(std::string const& text);
+
+	// Parse event that is about to be applied to the game state, which
+	// tells castling apart from moves
+	// Returns nullopt if the text is not an event
+	std::optional<EventRecord> parseEvent(GameState const& state,
+	                                      std::string const& text);
+
+	// Write event in coordinate notation
+	std::string formatEvent(EventRecord const& record);
+
+	// Read events of a move list, separated by spaces or new lines,
+	// skipping comments (from '#' to the end of the line)
+	std::vector<std::string> readMoveList(std::istream& is);
+
+}
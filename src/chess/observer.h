@@ -0,0 +1,33 @@
+#pragma once
+
+#include "event.h" // EventRecord
+
+namespace chesslib
+{
+
+	class GameController;
+
+	// Unlike the GameListener, which is asked for input while an event is
+	// being applied, an observer is only informed of what happened to the
+	// game state, after the fact. This is how journals, spectators and other
+	// passive consumers keep track of a game without polling it.
+	class GameObserver
+	{
+	public:
+		virtual ~GameObserver() {}
+
+		// Informs that an event was applied to the game state
+		// The record contains the promotion choice, if any.
+		virtual void onEventApplied(GameController const& gameController,
+		                            EventRecord const& record) = 0;
+
+		// Informs that the last event applied was taken back
+		virtual void onEventUndone(GameController const& gameController,
+		                           EventRecord const& record) = 0;
+
+		// Informs that the game state was replaced as a whole, which also
+		// happens when the observer is first attached to the controller
+		virtual void onStateReset(GameController const& gameController) = 0;
+	};
+
+}
@@ -0,0 +1,313 @@
+#include "perft.h"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "history.h"
+#include "legality.h"
+#include "movegen.h"
+#include "state.h"
+#include "trace.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Piece types a pawn can be promoted to
+static const PieceTypeId promotions[] = {
+	PieceTypeId::QUEEN,
+	PieceTypeId::ROOK,
+	PieceTypeId::BISHOP,
+	PieceTypeId::KNIGHT,
+};
+
+static const unsigned int promotion_cnt = static_cast<unsigned int>(size(promotions));
+
+// Check whether a move of the player to move promotes a pawn
+static bool isPromotion(CheckInfo const& info, EventRecord const& record)
+{
+	return record.id == GameEventId::MOVE &&
+	       info.types[record.origin] == PieceTypeId::PAWN &&
+	       getSquareRank(record.dest) == getPromotionRank(info.turn);
+}
+
+// List legal events of the player to move, with one event for each
+// piece type a pawn can be promoted to
+static void listEvents(GameState const& state, vector<EventRecord>& events)
+{
+	auto const info = getCheckInfo(state);
+	LegalMoves moves;
+	generateLegalMoves(state, info, moves);
+	getLegalEvents(moves, events);
+
+	auto const cnt = events.size();
+	for (size_t i = 0; i < cnt; ++i) {
+		if (!isPromotion(info, events[i]))
+			continue;
+		events[i].promotion = promotions[0];
+		for (unsigned int p = 1; p < promotion_cnt; ++p) {
+			auto record = events[i];
+			record.promotion = promotions[p];
+			events.push_back(record);
+		}
+	}
+}
+
+PerftTable::PerftTable(size_t megabytes)
+{
+	size_t entries = 1;
+	while (entries * 2 * sizeof(Entry) <= megabytes * 1024 * 1024)
+		entries *= 2;
+	m_entries = make_unique<Entry[]>(entries);
+	m_mask = entries - 1;
+	clear();
+}
+
+bool PerftTable::probe(uint64_t hash, unsigned int depth, uint64_t& count) const
+{
+	auto const& entry = m_entries[hash & m_mask];
+	auto const data = entry.data.load(memory_order_relaxed);
+	auto const key = entry.key.load(memory_order_relaxed);
+	if ((key ^ data) != hash || (data & 0xff) != depth)
+		return false;
+	count = data >> 8;
+	return true;
+}
+
+void PerftTable::store(uint64_t hash, unsigned int depth, uint64_t count)
+{
+	auto& entry = m_entries[hash & m_mask];
+	auto const data = count << 8 | depth;
+	entry.key.store(hash ^ data, memory_order_relaxed);
+	entry.data.store(data, memory_order_relaxed);
+}
+
+void PerftTable::clear()
+{
+	for (size_t i = 0; i <= m_mask; ++i) {
+		// Depth 0 is never stored, so no hash matches
+		m_entries[i].key.store(0, memory_order_relaxed);
+		m_entries[i].data.store(0, memory_order_relaxed);
+	}
+}
+
+size_t PerftTable::size() const
+{
+	return m_mask + 1;
+}
+
+uint64_t chesslib::perft(GameState& state, unsigned int depth, PerftTable* table)
+{
+	if (depth == 0)
+		return 1;
+
+	auto const hash = state.getHash();
+	uint64_t count = 0;
+	if (table && depth > 1 && table->probe(hash, depth, count))
+		return count;
+
+	auto const info = getCheckInfo(state);
+	LegalMoves moves;
+	generateLegalMoves(state, info, moves);
+
+	// The leaves are the legal events themselves
+	if (depth == 1) {
+		count = countLegalMoves(moves);
+		for (auto pawns = info.occupied & ~info.enemies; pawns; ) {
+			auto const sq = popFirstSquare(pawns);
+			if (info.types[sq] != PieceTypeId::PAWN)
+				continue;
+			for (auto dests = moves.destinations[sq]; dests; ) {
+				EventRecord const record{ GameEventId::MOVE, sq,
+				                          popFirstSquare(dests), PieceTypeId::NONE };
+				if (isPromotion(info, record))
+					count += promotion_cnt - 1;
+			}
+		}
+		return count;
+	}
+
+	vector<EventRecord> events;
+	getLegalEvents(moves, events);
+	UndoRecord undo;
+	for (auto record : events) {
+		bool const promoting = isPromotion(info, record);
+		for (unsigned int p = 0; p < (promoting ? promotion_cnt : 1); ++p) {
+			if (promoting)
+				record.promotion = promotions[p];
+			applyEvent(state, record, undo);
+			count += perft(state, depth - 1, table);
+			revertEvent(state, undo);
+		}
+	}
+
+	if (table)
+		table->store(hash, depth, count);
+	return count;
+}
+
+namespace
+{
+	// Subtree of the game tree, counted into the total of a root event
+	struct PerftTask
+	{
+		GameState state;
+		unsigned int depth; // plies left to count
+		unsigned int ply; // plies played since the root
+		size_t root; // index of the root event
+	};
+
+	// Tasks of one thread, which takes the newest ones (those most likely
+	// to be warm in its cache) while idle threads steal the oldest ones
+	// (the largest subtrees)
+	class TaskQueue
+	{
+	public:
+		void push(PerftTask&& task)
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_tasks.push_back(move(task));
+		}
+
+		bool pop(PerftTask& task)
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (m_tasks.empty())
+				return false;
+			task = move(m_tasks.back());
+			m_tasks.pop_back();
+			return true;
+		}
+
+		bool steal(PerftTask& task)
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if (m_tasks.empty())
+				return false;
+			task = move(m_tasks.front());
+			m_tasks.pop_front();
+			return true;
+		}
+	private:
+		mutex m_mutex;
+		deque<PerftTask> m_tasks;
+	};
+
+	class PerftPool
+	{
+	public:
+		PerftPool(unsigned int threads, unsigned int split_depth,
+		          PerftTable* table, vector<atomic<uint64_t>>& counts) :
+			m_queues(threads),
+			m_pending(0),
+			m_split_depth(split_depth),
+			m_table(table),
+			m_counts(counts)
+		{}
+
+		// Give task to a thread, before the pool is run
+		void push(unsigned int worker, PerftTask&& task)
+		{
+			m_pending.fetch_add(1, memory_order_relaxed);
+			m_queues[worker % m_queues.size()].push(move(task));
+		}
+
+		// Run every task, on as many threads as there are queues
+		void run()
+		{
+			vector<thread> pool;
+			for (unsigned int worker = 1; worker < m_queues.size(); ++worker)
+				pool.emplace_back(&PerftPool::work, this, worker);
+			work(0);
+			for (auto& t : pool)
+				t.join();
+		}
+	private:
+		void work(unsigned int worker)
+		{
+			PerftTask task;
+			while (m_pending.load(memory_order_acquire) > 0) {
+				if (m_queues[worker].pop(task) || steal(worker, task)) {
+					execute(worker, task);
+					m_pending.fetch_sub(1, memory_order_acq_rel);
+				} else {
+					this_thread::yield();
+				}
+			}
+		}
+
+		bool steal(unsigned int worker, PerftTask& task)
+		{
+			auto const cnt = m_queues.size();
+			for (size_t i = 1; i < cnt; ++i)
+				if (m_queues[(worker + i) % cnt].steal(task))
+					return true;
+			return false;
+		}
+
+		void execute(unsigned int worker, PerftTask& task)
+		{
+			CHESS_TRACE_SCOPE("perftTask");
+			if (task.ply >= m_split_depth || task.depth <= 1) {
+				auto const count = perft(task.state, task.depth, m_table);
+				m_counts[task.root].fetch_add(count, memory_order_relaxed);
+				return;
+			}
+
+			// Children are pushed before the task is done, so the
+			// number of pending tasks cannot drop to zero in between
+			vector<EventRecord> events;
+			listEvents(task.state, events);
+			UndoRecord undo;
+			for (auto const& record : events) {
+				PerftTask child{ task.state, task.depth - 1, task.ply + 1, task.root };
+				applyEvent(child.state, record, undo);
+				m_pending.fetch_add(1, memory_order_relaxed);
+				m_queues[worker].push(move(child));
+			}
+		}
+	private:
+		vector<TaskQueue> m_queues;
+		atomic<size_t> m_pending;
+		unsigned int m_split_depth;
+		PerftTable* m_table;
+		vector<atomic<uint64_t>>& m_counts;
+	};
+}
+
+PerftResult chesslib::parallelPerft(GameState const& state, unsigned int depth,
+                                    PerftOptions const& options)
+{
+	PerftResult result;
+	result.nodes = 1;
+	if (depth == 0)
+		return result;
+
+	listEvents(state, result.events);
+	vector<atomic<uint64_t>> counts(result.events.size());
+
+	unique_ptr<PerftTable> table;
+	if (options.table_megabytes > 0)
+		table = make_unique<PerftTable>(options.table_megabytes);
+
+	auto threads = options.threads;
+	if (threads == 0)
+		threads = max(1u, thread::hardware_concurrency());
+
+	PerftPool pool(threads, max(1u, options.split_depth), table.get(), counts);
+	UndoRecord undo;
+	for (size_t i = 0; i < result.events.size(); ++i) {
+		PerftTask task{ state, depth - 1, 1, i };
+		applyEvent(task.state, result.events[i], undo);
+		pool.push(static_cast<unsigned int>(i), move(task));
+	}
+	pool.run();
+
+	result.nodes = 0;
+	for (auto const& count : counts) {
+		result.counts.push_back(count.load(memory_order_relaxed));
+		result.nodes += result.counts.back();
+	}
+	return result;
+}
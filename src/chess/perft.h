@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic> // std::atomic
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint64_t
+#include <memory> // std::unique_ptr
+#include <vector> // std::vector
+
+#include "event.h" // EventRecord
+
+namespace chesslib
+{
+
+	class GameState;
+
+	// Hash table of leaf counts by position and depth, shared by any
+	// number of threads without locks. Every entry stores its key XORed
+	// with its data, so an entry torn by two threads writing at once no
+	// longer matches any key and is merely a miss.
+	class PerftTable
+	{
+	public:
+		// Create table of about the given size in megabytes (rounded
+		// down to a power of two entries)
+		explicit PerftTable(std::size_t megabytes);
+
+		// A table cannot be copied
+		PerftTable(PerftTable const&) = delete;
+		PerftTable& operator=(PerftTable const&) = delete;
+
+		// Look up leaf count of a position hash at given depth
+		// Returns true if found
+		bool probe(std::uint64_t hash, unsigned int depth, std::uint64_t& count) const;
+
+		// Store leaf count of a position hash at given depth
+		void store(std::uint64_t hash, unsigned int depth, std::uint64_t count);
+
+		// Forget every entry
+		void clear();
+
+		// Get number of entries
+		std::size_t size() const;
+	private:
+		struct Entry
+		{
+			std::atomic<std::uint64_t> key; // hash ^ data
+			std::atomic<std::uint64_t> data; // count << 8 | depth
+		};
+
+		std::unique_ptr<Entry[]> m_entries;
+		std::size_t m_mask;
+	};
+
+	// Count the leaves of the game tree of given depth under the game
+	// state, where each promotion piece makes a leaf of its own. The game
+	// state is changed along the way and restored before returning.
+	// Positions already counted are looked up in the table, if any.
+	std::uint64_t perft(GameState& state, unsigned int depth,
+	                    PerftTable* table = nullptr);
+
+	// How a parallel perft is run
+	struct PerftOptions
+	{
+		unsigned int threads = 0; // 0 for one per core
+		unsigned int split_depth = 2; // plies split into tasks
+		std::size_t table_megabytes = 64; // 0 for no table
+	};
+
+	// Leaf count under each event of the root position
+	struct PerftResult
+	{
+		std::vector<EventRecord> events;
+		std::vector<std::uint64_t> counts; // by event
+		std::uint64_t nodes; // sum of counts
+	};
+
+	// Count the leaves of the game tree like perft, splitting the first
+	// plies into tasks that are spread over a work-stealing pool of
+	// threads, which share one table
+	PerftResult parallelPerft(GameState const& state, unsigned int depth,
+	                          PerftOptions const& options = PerftOptions());
+
+}
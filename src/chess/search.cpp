@@ -0,0 +1,674 @@
+#include "search.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "batch.h"
+#include "history.h"
+#include "state.h"
+#include "trace.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Scores by which events are tried, best first
+static const int hash_move_order = 1 << 30;
+static const int tactical_order = 1 << 24;
+static const int killer_order = 1 << 22;
+
+// Half the width of the first window around the score of the previous
+// iteration, and the depth from which the window is used
+static const int aspiration_window = 25;
+static const unsigned int aspiration_depth = 4;
+
+// Highest history score, beyond which every score is halved
+static const int max_history = 1 << 20;
+
+// Piece types pawns are promoted to in the search (a rook or a bishop is
+// never better than a queen, but a knight attacks other squares)
+static const PieceTypeId search_promotions[] = {
+	PieceTypeId::QUEEN,
+	PieceTypeId::KNIGHT,
+};
+
+// Get number of steps from the edge of the board towards the centre
+// (0 in the corners, 6 on the four central squares)
+static int getCentralisation(Square sq)
+{
+	auto const f = static_cast<int>(getSquareFile(sq));
+	auto const r = static_cast<int>(getSquareRank(sq));
+	return 7 - (abs(2 * f - 7) + abs(2 * r - 7)) / 2;
+}
+
+// Convert score of a position at some ply to a score in the table,
+// where mates count from the position itself instead of from the root
+static int toTable(int score, int ply)
+{
+	if (score >= mate_score - max_search_ply)
+		return score + ply;
+	if (score <= -mate_score + max_search_ply)
+		return score - ply;
+	return score;
+}
+
+// Convert score in the table to a score of a position at some ply
+static int fromTable(int score, int ply)
+{
+	if (score >= mate_score - max_search_ply)
+		return score - ply;
+	if (score <= -mate_score + max_search_ply)
+		return score + ply;
+	return score;
+}
+
+uint16_t chesslib::packMove(EventRecord const& record)
+{
+	if (record.id == GameEventId::CASTLING)
+		return static_cast<uint16_t>(1 << 15 | static_cast<int>(record.origin));
+	// No move goes from a square to itself, so no move is packed as 0
+	return static_cast<uint16_t>(static_cast<int>(record.origin) |
+	                             static_cast<int>(record.dest) << 6 |
+	                             static_cast<int>(record.promotion) << 12);
+}
+
+EventRecord chesslib::unpackMove(uint16_t packed)
+{
+	if (packed & 1 << 15)
+		return EventRecord{ GameEventId::CASTLING, static_cast<Square>(packed & 63),
+		                    SQ_CNT, PieceTypeId::NONE };
+	return EventRecord{ GameEventId::MOVE, static_cast<Square>(packed & 63),
+	                    static_cast<Square>(packed >> 6 & 63),
+	                    static_cast<PieceTypeId>(packed >> 12 & 7) };
+}
+
+SearchTable::SearchTable(size_t megabytes)
+{
+	size_t entries = 1;
+	while (entries * 2 * sizeof(Entry) <= megabytes * 1024 * 1024)
+		entries *= 2;
+	m_entries = make_unique<Entry[]>(entries);
+	m_mask = entries - 1;
+	clear();
+}
+
+SearchTable::Entry const* SearchTable::probe(uint64_t hash) const
+{
+	auto const& entry = m_entries[hash & m_mask];
+	if (entry.key != hash || entry.bound == Bound::NONE)
+		return nullptr;
+	return &entry;
+}
+
+void SearchTable::store(uint64_t hash, uint16_t move, int score,
+                        unsigned int depth, Bound bound)
+{
+	auto& entry = m_entries[hash & m_mask];
+	if (entry.key == hash) {
+		if (depth < entry.depth && bound != Bound::EXACT)
+			return;
+		// A search that found no best event keeps the one found before
+		if (move == 0)
+			move = entry.move;
+	}
+	entry.key = hash;
+	entry.move = move;
+	entry.score = static_cast<int16_t>(score);
+	entry.depth = static_cast<uint8_t>(min(depth, 255u));
+	entry.bound = bound;
+}
+
+void SearchTable::clear()
+{
+	fill(m_entries.get(), m_entries.get() + m_mask + 1, Entry{ 0, 0, 0, 0, Bound::NONE });
+}
+
+SearchEngine::SearchEngine(SearchOptions const& options) :
+	m_options(options),
+	m_table(max<size_t>(1, options.table_megabytes)),
+	m_frames(max_search_ply + 1),
+	m_stop(false),
+	m_ponder_hit(false),
+	m_nodes(0),
+	m_budget_nodes(0),
+	m_aborted(false),
+	m_pondering(false)
+{
+	for (auto& frame : m_frames)
+		frame.moves.reserve(256);
+	clear();
+}
+
+SearchResult SearchEngine::search(GameState const& state, SearchLimits const& limits,
+                                  vector<uint64_t> const& history)
+{
+	return analyse(state, limits, 1, history).front();
+}
+
+vector<SearchResult> SearchEngine::analyse(GameState const& state, SearchLimits const& limits,
+                                           unsigned int line_cnt, vector<uint64_t> const& history,
+                                           AnalysisCallback const& callback)
+{
+	m_limits = limits;
+	m_time.start(limits);
+	m_nodes = 0;
+	m_budget_nodes = 0;
+	m_aborted = false;
+	m_pondering = limits.ponder;
+	m_path.assign(history.begin(), history.end());
+	m_excluded.clear();
+
+	// What was learnt in the searches of the previous moves of the game
+	// is kept, but weighs less than what this search learns
+	for (auto& row : m_history)
+		for (auto& cell : row)
+			cell /= 2;
+
+	GameState root(state);
+
+	// Should not even the first iteration complete, the events that
+	// look best at first sight are played
+	auto& frame = m_frames[0];
+	frame.info = getCheckInfo(root);
+	generateLegalMoves(root, frame.info, frame.legal);
+	if (!hasMoves(frame.legal)) {
+		finishSearch();
+		return { SearchResult{ {}, frame.info.checkers ? -mate_score : 0, 0, 0 } };
+	}
+	auto const entry = m_table.probe(root.getHash());
+	listMoves(root, frame, entry ? entry->move : 0, false);
+	line_cnt = static_cast<unsigned int>(min<size_t>(max(line_cnt, 1u), frame.moves.size()));
+	vector<SearchResult> lines;
+	for (unsigned int i = 0; i < line_cnt; ++i) {
+		pickMove(frame.moves, i);
+		lines.push_back(SearchResult{ { frame.moves[i].record }, 0, 0, 0 });
+	}
+
+	auto const max_depth = min<unsigned int>(limits.depth, max_search_ply - 1);
+	auto iteration = lines;
+	for (unsigned int depth = 1; depth <= max_depth; ++depth) {
+		CHESS_TRACE_SCOPE("searchIteration");
+
+		// Each line is searched without the first events of the lines
+		// above it, the table keeping what the searches have in common
+		m_excluded.clear();
+		for (unsigned int i = 0; i < line_cnt && !m_aborted; ++i) {
+			auto const score = searchLine(root, depth, lines[i].score, i == 0);
+			if (m_aborted)
+				break;
+			auto& line = iteration[i];
+			if (frame.pv_length > 0)
+				line.pv.assign(frame.pv.begin(), frame.pv.begin() + frame.pv_length);
+			line.score = score;
+			line.depth = depth;
+			m_excluded.push_back(packMove(line.pv.front()));
+		}
+		if (m_aborted)
+			break;
+
+		// A line further down may turn out better than one above it
+		stable_sort(iteration.begin(), iteration.end(),
+		            [] (SearchResult const& a, SearchResult const& b) { return a.score > b.score; });
+		lines = iteration;
+		for (auto& line : lines)
+			line.nodes = m_nodes;
+		m_time.onIteration(packMove(lines.front().pv.front()), lines.front().score);
+		if (callback)
+			callback(lines);
+
+		// A mate found within the depth searched cannot get any shorter
+		bool const solved = all_of(lines.begin(), lines.end(), [depth] (SearchResult const& line) {
+			return isMateScore(line.score) && mate_score - abs(line.score) <= static_cast<int>(depth);
+		});
+		if (solved || (!isPondering() && !m_time.canStartIteration()))
+			break;
+	}
+
+	finishSearch();
+	for (auto& line : lines)
+		line.nodes = m_nodes;
+	return lines;
+}
+
+int SearchEngine::searchLine(GameState& root, unsigned int depth, int expected, bool first)
+{
+	// The score is expected close to that of the previous iteration,
+	// which a narrow window proves faster, and the window is widened
+	// on the side the score falls out of until it falls within
+	int delta = aspiration_window;
+	int alpha = -mate_score;
+	int beta = mate_score;
+	if (depth >= aspiration_depth && !isMateScore(expected)) {
+		alpha = max(expected - delta, -mate_score);
+		beta = min(expected + delta, mate_score);
+	}
+
+	while (true) {
+		auto const score = searchNode(root, static_cast<int>(depth), alpha, beta, 0);
+		if (m_aborted)
+			return score;
+		if (score <= alpha && alpha > -mate_score) {
+			// Only the best line tells how much time the move needs
+			if (first)
+				m_time.onFailLow();
+			alpha = max(score - delta, -mate_score);
+		} else if (score >= beta && beta < mate_score) {
+			beta = min(score + delta, mate_score);
+		} else {
+			return score;
+		}
+		delta *= 2;
+	}
+}
+
+void SearchEngine::stop()
+{
+	{
+		lock_guard<mutex> lock(m_signal_mutex);
+		m_stop.store(true, memory_order_relaxed);
+	}
+	m_signal.notify_all();
+}
+
+void SearchEngine::ponderHit()
+{
+	{
+		lock_guard<mutex> lock(m_signal_mutex);
+		m_ponder_hit.store(true, memory_order_relaxed);
+	}
+	m_signal.notify_all();
+}
+
+void SearchEngine::clear()
+{
+	m_table.clear();
+	for (auto& row : m_history)
+		row.fill(0);
+	for (auto& frame : m_frames)
+		frame.killers.fill(EventRecord{ GameEventId::MOVE, SQ_CNT, SQ_CNT, PieceTypeId::NONE });
+}
+
+SearchOptions const& SearchEngine::getOptions() const
+{
+	return m_options;
+}
+
+int SearchEngine::searchNode(GameState& state, int depth, int alpha, int beta, int ply)
+{
+	auto& frame = m_frames[ply];
+	frame.pv_length = 0;
+
+	if (ply > 0) {
+		if (isOutOfBudget())
+			return 0;
+		if (isRepetition(state))
+			return 0;
+	}
+
+	if (depth <= 0)
+		return quiesce(state, alpha, beta, ply);
+
+	++m_nodes;
+	auto const hash = state.getHash();
+	bool const pv_node = beta - alpha > 1;
+	uint16_t hash_move = 0;
+	if (auto const entry = m_table.probe(hash)) {
+		hash_move = entry->move;
+		if (ply > 0 && !pv_node && entry->depth >= depth) {
+			auto const score = fromTable(entry->score, ply);
+			if (entry->bound == SearchTable::Bound::EXACT ||
+			    (entry->bound == SearchTable::Bound::LOWER && score >= beta) ||
+			    (entry->bound == SearchTable::Bound::UPPER && score <= alpha))
+				return score;
+		}
+	}
+
+	frame.info = getCheckInfo(state);
+	generateLegalMoves(state, frame.info, frame.legal);
+	bool const in_check = frame.info.checkers != 0;
+	if (!hasMoves(frame.legal))
+		return in_check ? -mate_score + ply : 0;
+	if (state.getHalfmoveClock() >= 100)
+		return 0;
+
+	// Checks are looked into one ply deeper, as there are few replies
+	if (in_check && ply < max_search_ply / 2)
+		++depth;
+
+	listMoves(state, frame, hash_move, false);
+	if (ply == 0 && !m_excluded.empty()) {
+		auto& moves = frame.moves;
+		moves.erase(remove_if(moves.begin(), moves.end(), [this] (ScoredMove const& move) {
+			return find(m_excluded.begin(), m_excluded.end(), packMove(move.record)) != m_excluded.end();
+		}), moves.end());
+	}
+	m_path.push_back(hash);
+
+	auto const original_alpha = alpha;
+	int best = -mate_score;
+	uint16_t best_move = 0;
+	UndoRecord undo;
+	auto const cnt = frame.moves.size();
+	for (size_t i = 0; i < cnt; ++i) {
+		pickMove(frame.moves, i);
+		auto const record = frame.moves[i].record;
+		bool const tactical = isTactical(state, frame.info, record);
+
+		applyEvent(state, record, undo);
+		int score;
+		if (i == 0) {
+			score = -searchNode(state, depth - 1, -beta, -alpha, ply + 1);
+		} else {
+			// Late quiet events are searched less deeply, and every
+			// event after the first one only to show that it is no
+			// better, unless it turns out to be
+			int const reduction = (depth >= 3 && i >= 3 && !tactical && !in_check) ? 1 : 0;
+			score = -searchNode(state, depth - 1 - reduction, -alpha - 1, -alpha, ply + 1);
+			if (score > alpha && (reduction > 0 || score < beta))
+				score = -searchNode(state, depth - 1, -beta, -alpha, ply + 1);
+		}
+		revertEvent(state, undo);
+
+		if (m_aborted) {
+			m_path.pop_back();
+			return 0;
+		}
+
+		if (score <= best)
+			continue;
+		best = score;
+		if (score <= alpha)
+			continue;
+		alpha = score;
+		best_move = packMove(record);
+
+		auto const& child = m_frames[ply + 1];
+		frame.pv[0] = record;
+		copy(child.pv.begin(), child.pv.begin() + child.pv_length, frame.pv.begin() + 1);
+		frame.pv_length = child.pv_length + 1;
+
+		if (score >= beta) {
+			if (!tactical)
+				rememberQuiet(frame, record, depth);
+			break;
+		}
+	}
+
+	m_path.pop_back();
+
+	// The root searched without some of its events is not the position
+	// the table knows it as
+	if (ply == 0 && !m_excluded.empty())
+		return best;
+
+	auto const bound = best >= beta ? SearchTable::Bound::LOWER :
+		best > original_alpha ? SearchTable::Bound::EXACT : SearchTable::Bound::UPPER;
+	m_table.store(hash, best_move, toTable(best, ply), static_cast<unsigned int>(depth), bound);
+	return best;
+}
+
+int SearchEngine::quiesce(GameState& state, int alpha, int beta, int ply)
+{
+	auto& frame = m_frames[ply];
+	frame.pv_length = 0;
+
+	if (isOutOfBudget())
+		return 0;
+	++m_nodes;
+
+	frame.info = getCheckInfo(state);
+	generateLegalMoves(state, frame.info, frame.legal);
+	bool const in_check = frame.info.checkers != 0;
+	if (!hasMoves(frame.legal))
+		return in_check ? -mate_score + ply : 0;
+	if (state.getHalfmoveClock() >= 100)
+		return 0;
+	if (ply >= max_search_ply - 1)
+		return evaluate(frame.info);
+
+	// Unless in check, the player to move may stand still instead of
+	// taking anything, so the evaluation is a lower bound
+	int best = -mate_score + ply;
+	if (!in_check) {
+		best = evaluate(frame.info);
+		if (!m_options.quiescence || best >= beta)
+			return best;
+		alpha = max(alpha, best);
+	}
+
+	listMoves(state, frame, 0, !in_check);
+
+	UndoRecord undo;
+	auto const cnt = frame.moves.size();
+	for (size_t i = 0; i < cnt; ++i) {
+		pickMove(frame.moves, i);
+		auto const record = frame.moves[i].record;
+
+		applyEvent(state, record, undo);
+		auto const score = -quiesce(state, -beta, -alpha, ply + 1);
+		revertEvent(state, undo);
+
+		if (m_aborted)
+			return 0;
+
+		if (score <= best)
+			continue;
+		best = score;
+		if (score <= alpha)
+			continue;
+		alpha = score;
+
+		auto const& child = m_frames[ply + 1];
+		frame.pv[0] = record;
+		copy(child.pv.begin(), child.pv.begin() + child.pv_length, frame.pv.begin() + 1);
+		frame.pv_length = child.pv_length + 1;
+
+		if (score >= beta)
+			break;
+	}
+	return best;
+}
+
+int SearchEngine::evaluate(CheckInfo const& info) const
+{
+	int score = 0;
+	for (auto pieces = info.occupied; pieces; ) {
+		auto const sq = popFirstSquare(pieces);
+		auto const id = info.types[sq];
+		if (id == PieceTypeId::NONE)
+			continue;
+
+		bool const own = !hasSquare(info.enemies, sq);
+		auto const colour = own ? info.turn : static_cast<Colour>(static_cast<int>(info.turn) ^ 1);
+		int value = 100 * getMaterialValue(id);
+		switch (id) {
+		case PieceTypeId::PAWN:
+		{
+			auto const rank = static_cast<int>(getSquareRank(sq));
+			auto const advance = colour == Colour::WHITE ? rank - RK_2 : RK_7 - rank;
+			value += m_options.pawn_weight * advance;
+			break;
+		}
+		case PieceTypeId::KNIGHT:
+		case PieceTypeId::BISHOP:
+			value += m_options.centre_weight * getCentralisation(sq);
+			break;
+		case PieceTypeId::QUEEN:
+			value += m_options.centre_weight * getCentralisation(sq) / 2;
+			break;
+		default:
+			break;
+		}
+		score += own ? value : -value;
+	}
+	return score;
+}
+
+template<Colour C>
+void SearchEngine::listMoves(GameState const& state, Frame& frame, uint16_t hash_move,
+                             bool tactical_only) const
+{
+	auto& moves = frame.moves;
+	auto const& info = frame.info;
+	moves.clear();
+
+	constexpr Rank last_rank = ColourTraits<C>::promotion_rank;
+	auto const enpassant = state.getEnPassantPawn();
+
+	for (Square origin = SQ_A1; origin < SQ_CNT; ++origin) {
+		auto dests = frame.legal.destinations[origin];
+		if (!dests)
+			continue;
+		auto const attacker = info.types[origin];
+		bool const pawn = attacker == PieceTypeId::PAWN;
+		while (dests) {
+			auto const dest = popFirstSquare(dests);
+			auto victim = info.types[dest];
+			if (pawn && dest == enpassant)
+				victim = PieceTypeId::PAWN;
+
+			// Most valuable victim first, taken by the least valuable attacker
+			auto const gain = 100 * getMaterialValue(victim);
+			auto const order = tactical_order + 64 * gain - getMaterialValue(attacker);
+
+			if (pawn && getSquareRank(dest) == last_rank) {
+				for (auto promotion : search_promotions)
+					moves.push_back(ScoredMove{ { GameEventId::MOVE, origin, dest, promotion },
+					                            order + 64 * 100 * getMaterialValue(promotion) });
+				continue;
+			}
+
+			EventRecord const record{ GameEventId::MOVE, origin, dest, PieceTypeId::NONE };
+			if (victim != PieceTypeId::NONE) {
+				moves.push_back(ScoredMove{ record, order });
+			} else if (!tactical_only) {
+				int score = 0;
+				if (m_options.history) {
+					if (packMove(record) == packMove(frame.killers[0]))
+						score = killer_order;
+					else if (packMove(record) == packMove(frame.killers[1]))
+						score = killer_order - 1;
+					else
+						score = m_history[origin][dest];
+				}
+				moves.push_back(ScoredMove{ record, score });
+			}
+		}
+	}
+
+	if (!tactical_only)
+		for (int corner = 0; corner < castling_corner_cnt; ++corner)
+			if (frame.legal.castlings & (1 << corner))
+				moves.push_back(ScoredMove{ { GameEventId::CASTLING, getCastlingRook(corner),
+				                              SQ_CNT, PieceTypeId::NONE }, 0 });
+
+	if (hash_move != 0)
+		for (auto& move : moves)
+			if (packMove(move.record) == hash_move)
+				move.score = hash_move_order;
+}
+
+void SearchEngine::listMoves(GameState const& state, Frame& frame, uint16_t hash_move,
+                             bool tactical_only) const
+{
+	if (frame.info.turn == Colour::WHITE)
+		listMoves<Colour::WHITE>(state, frame, hash_move, tactical_only);
+	else
+		listMoves<Colour::BLACK>(state, frame, hash_move, tactical_only);
+}
+
+void SearchEngine::pickMove(vector<ScoredMove>& moves, size_t i)
+{
+	auto best = i;
+	for (auto j = i + 1; j < moves.size(); ++j)
+		if (moves[j].score > moves[best].score)
+			best = j;
+	swap(moves[i], moves[best]);
+}
+
+bool SearchEngine::hasMoves(LegalMoves const& legal)
+{
+	for (auto dests : legal.destinations)
+		if (dests != 0)
+			return true;
+	return false;
+}
+
+bool SearchEngine::isTactical(GameState const& state, CheckInfo const& info,
+                              EventRecord const& record)
+{
+	if (record.id != GameEventId::MOVE)
+		return false;
+	return info.types[record.dest] != PieceTypeId::NONE ||
+	       record.promotion != PieceTypeId::NONE ||
+	       (info.types[record.origin] == PieceTypeId::PAWN &&
+	        record.dest == state.getEnPassantPawn());
+}
+
+bool SearchEngine::isRepetition(GameState const& state) const
+{
+	auto const hash = state.getHash();
+	auto const cnt = m_path.size();
+	auto const depth = min<size_t>(state.getHalfmoveClock(), cnt);
+	// Positions with the same player to move are two plies apart
+	for (size_t back = 2; back <= depth; back += 2)
+		if (m_path[cnt - back] == hash)
+			return true;
+	return false;
+}
+
+void SearchEngine::rememberQuiet(Frame& frame, EventRecord const& record, int depth)
+{
+	if (!m_options.history)
+		return;
+
+	if (packMove(frame.killers[0]) != packMove(record)) {
+		frame.killers[1] = frame.killers[0];
+		frame.killers[0] = record;
+	}
+
+	if (record.id != GameEventId::MOVE)
+		return;
+	auto& score = m_history[record.origin][record.dest];
+	score += depth * depth;
+	if (score > max_history)
+		for (auto& row : m_history)
+			for (auto& cell : row)
+				cell /= 2;
+}
+
+bool SearchEngine::isOutOfBudget()
+{
+	if (m_aborted)
+		return true;
+	if (m_stop.load(memory_order_relaxed))
+		m_aborted = true;
+	else if (!isPondering())
+		m_aborted = (m_limits.nodes != 0 && m_nodes - m_budget_nodes >= m_limits.nodes) ||
+		            m_time.isTimeUp(m_nodes);
+	return m_aborted;
+}
+
+bool SearchEngine::isPondering()
+{
+	if (m_pondering && m_ponder_hit.load(memory_order_relaxed)) {
+		// The budget of the move starts now, the search going on as is
+		m_pondering = false;
+		m_budget_nodes = m_nodes;
+		m_time.onPonderHit(m_nodes);
+	}
+	return m_pondering;
+}
+
+void SearchEngine::finishSearch()
+{
+	// The event found while pondering is only known to be worth playing
+	// once the opponent played the event it was pondering on
+	unique_lock<mutex> lock(m_signal_mutex);
+	if (m_pondering)
+		m_signal.wait(lock, [this] {
+			return m_ponder_hit.load(memory_order_relaxed) || m_stop.load(memory_order_relaxed);
+		});
+	m_pondering = false;
+	m_ponder_hit.store(false, memory_order_relaxed);
+	m_stop.store(false, memory_order_relaxed);
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <array> // std::array
+#include <atomic> // std::atomic
+#include <chrono> // std::chrono
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint8_t, std::int16_t, std::uint16_t, std::uint64_t
+#include <condition_variable> // std::condition_variable
+#include <functional> // std::function
+#include <memory> // std::unique_ptr
+#include <mutex> // std::mutex
+#include <vector> // std::vector
+
+#include "event.h" // EventRecord
+#include "legality.h" // CheckInfo
+#include "movegen.h" // LegalMoves
+#include "timeman.h" // TimeManager
+#include "types.h" // Square
+
+namespace chesslib
+{
+
+	class GameState;
+
+	// Scores are in centipawns, from the point of view of the player to
+	// move. Being checkmated right away scores -mate_score, and every
+	// ply until the checkmate brings a score one closer to zero.
+	constexpr int mate_score = 30000;
+
+	// Deepest the search goes, in plies from the root
+	constexpr int max_search_ply = 128;
+
+	// Check whether a score announces a checkmate, by either player
+	inline constexpr bool isMateScore(int score)
+	{
+		return score >= mate_score - max_search_ply || score <= -mate_score + max_search_ply;
+	}
+
+	// How an engine plays, which is what tells two engines apart
+	struct SearchOptions
+	{
+		std::size_t table_megabytes = 16; // transposition table
+		bool quiescence = true; // resolve captures before evaluating
+		bool history = true; // try quiet moves by killers and history
+		int centre_weight = 4; // per step towards the centre, of knights, bishops and queens
+		int pawn_weight = 6; // per rank a pawn has advanced
+	};
+
+	// When a search stops (whichever limit comes first). The time of the
+	// move is either given as is, or left to the engine to work out from
+	// the clock of the player to move (see TimeManager).
+	struct SearchLimits
+	{
+		unsigned int depth = max_search_ply; // plies
+		std::uint64_t nodes = 0; // 0 for no limit
+		std::chrono::milliseconds time{ 0 }; // for the move, 0 for no limit
+		std::chrono::milliseconds remaining{ 0 }; // on the clock, 0 for no clock
+		std::chrono::milliseconds increment{ 0 }; // added to the clock after each move
+		unsigned int moves_to_go = 0; // until more time is added, 0 for the rest of the game
+		bool ponder = false; // on the opponent's time (see SearchEngine::ponderHit)
+	};
+
+	// Outcome of a search, as of the deepest iteration completed
+	struct SearchResult
+	{
+		std::vector<EventRecord> pv; // best line, empty if the game is over
+		int score; // of the first event of the line
+		unsigned int depth; // deepest iteration completed
+		std::uint64_t nodes; // positions visited
+	};
+
+	// Called with the lines of an analysis, best first, each time an
+	// iteration completes
+	using AnalysisCallback = std::function<void(std::vector<SearchResult> const& lines)>;
+
+	// Hash table of what the search learnt about positions, for one
+	// search at a time. Entries store the best event found in the
+	// position, so that it is tried first when the position is reached
+	// again, and a bound on its score, so that the position is not
+	// searched again at all if the bound is enough.
+	class SearchTable
+	{
+	public:
+		// Kinds of bounds on the score of a position
+		enum class Bound : std::uint8_t
+		{
+			NONE,
+			UPPER, // no event reached the score
+			LOWER, // an event reached at least the score
+			EXACT,
+		};
+
+		struct Entry
+		{
+			std::uint64_t key;
+			std::uint16_t move; // see packMove
+			std::int16_t score;
+			std::uint8_t depth;
+			Bound bound;
+		};
+
+		// Create table of about the given size in megabytes (rounded
+		// down to a power of two entries)
+		explicit SearchTable(std::size_t megabytes);
+
+		// A table cannot be copied
+		SearchTable(SearchTable const&) = delete;
+		SearchTable& operator=(SearchTable const&) = delete;
+
+		// Look up position hash
+		// Returns the entry, or nullptr if the position is not stored
+		Entry const* probe(std::uint64_t hash) const;
+
+		// Store what was found about a position hash, replacing whatever
+		// is stored in its slot unless it is the same position searched
+		// deeper
+		void store(std::uint64_t hash, std::uint16_t move, int score,
+		           unsigned int depth, Bound bound);
+
+		// Forget every entry
+		void clear();
+	private:
+		std::unique_ptr<Entry[]> m_entries;
+		std::size_t m_mask;
+	};
+
+	// Pack event record in 16 bits (0 is no event)
+	std::uint16_t packMove(EventRecord const& record);
+
+	// Unpack event record from 16 bits
+	EventRecord unpackMove(std::uint16_t packed);
+
+	// Alpha-beta search of the best event for the player to move, deepened
+	// one ply at a time until a limit is reached. It follows the rules of
+	// GameController to the letter: the game ends when the player to move
+	// has no move other than castling (see lookForCheckmate), and a
+	// position is a draw when the fifty-move rule applies or when it is
+	// repeated, which is enough for the engine to avoid (or seek) the
+	// third occurrence that actually ends the game.
+	//
+	// An engine is used by one thread at a time, and keeps its table and
+	// its history of quiet events from one search to the next, so that
+	// each move of a game starts from what the previous ones learnt.
+	//
+	// An engine can also ponder: search the position after the event it
+	// expects from the opponent, while the opponent thinks. If the
+	// opponent plays that event, the search goes on as a normal one,
+	// without starting over; if not, it is stopped, and what it found
+	// is still in the table.
+	class SearchEngine
+	{
+	public:
+		// Create engine that plays with the given options
+		explicit SearchEngine(SearchOptions const& options = SearchOptions());
+
+		// An engine cannot be copied
+		SearchEngine(SearchEngine const&) = delete;
+		SearchEngine& operator=(SearchEngine const&) = delete;
+
+		// Search best event for the player to move in the game state,
+		// given the hashes of the positions of the game before it (oldest
+		// first), of which those since the last irreversible event are
+		// looked at for repetitions
+		SearchResult search(GameState const& state, SearchLimits const& limits,
+		                    std::vector<std::uint64_t> const& history = {});
+
+		// Search the given number of best events for the player to move,
+		// each with its line, as search does for the best one. Every
+		// iteration searches the lines one after the other, each without
+		// the first events of the lines above it, and all of them in the
+		// same table, so that a line costs much less than a search of its
+		// own. The callback, if any, is given the lines of every iteration
+		// that completes.
+		// Returns the lines, best first (fewer if there are fewer legal
+		// events, and one with no event if the game is over)
+		std::vector<SearchResult> analyse(GameState const& state, SearchLimits const& limits,
+		                                  unsigned int line_cnt,
+		                                  std::vector<std::uint64_t> const& history = {},
+		                                  AnalysisCallback const& callback = nullptr);
+
+		// Make the search stop as soon as possible, from any thread (or
+		// the next search to start, if none is going on)
+		void stop();
+
+		// Tell a search that ponders that the opponent played the event
+		// it was pondering on, from any thread (or the next search to
+		// start, if none is going on). The search goes on within its
+		// limits, which count from now on.
+		void ponderHit();
+
+		// Forget what was learnt in previous searches, for a new game
+		void clear();
+
+		// Get options the engine plays with
+		SearchOptions const& getOptions() const;
+	private:
+		// Event with the score it is tried by
+		struct ScoredMove
+		{
+			EventRecord record;
+			int score;
+		};
+
+		// What the search keeps at each ply
+		struct Frame
+		{
+			CheckInfo info;
+			LegalMoves legal;
+			std::vector<ScoredMove> moves;
+			std::array<EventRecord, max_search_ply> pv;
+			int pv_length;
+			std::array<EventRecord, 2> killers;
+		};
+
+		// Search root to the given depth, in a window around the score
+		// the line is expected to have (widened until the score falls
+		// within), telling the time manager if the first line fails low
+		int searchLine(GameState& root, unsigned int depth, int expected, bool first);
+
+		// Search position with a window, to the given depth
+		int searchNode(GameState& state, int depth, int alpha, int beta, int ply);
+
+		// Search captures and promotions until the position is quiet
+		int quiesce(GameState& state, int alpha, int beta, int ply);
+
+		// Evaluate position, from the point of view of the player to move
+		int evaluate(CheckInfo const& info) const;
+
+		// List legal events of the frame into its move list, scored by
+		// how promising they are (only captures and promotions if asked)
+		void listMoves(GameState const& state, Frame& frame, std::uint16_t hash_move,
+		               bool tactical_only) const;
+
+		// List legal events of the frame, with colour C to move
+		template<Colour C>
+		void listMoves(GameState const& state, Frame& frame, std::uint16_t hash_move,
+		               bool tactical_only) const;
+
+		// Move the most promising event left to position i of the list
+		static void pickMove(std::vector<ScoredMove>& moves, std::size_t i);
+
+		// Check whether the player to move has any move besides castling
+		static bool hasMoves(LegalMoves const& legal);
+
+		// Check whether an event takes a piece or promotes a pawn
+		static bool isTactical(GameState const& state, CheckInfo const& info,
+		                       EventRecord const& record);
+
+		// Check whether the position was reached before, since the last
+		// irreversible event
+		bool isRepetition(GameState const& state) const;
+
+		// Remember a quiet event that refuted a position
+		void rememberQuiet(Frame& frame, EventRecord const& record, int depth);
+
+		// Check whether the search ran out of nodes or time, or was
+		// stopped
+		bool isOutOfBudget();
+
+		// Check whether the search still ponders, turning it into a normal
+		// search if the opponent played the expected event
+		bool isPondering();
+
+		// Wait until a search that ponders is either hit or stopped, and
+		// get ready for the next search
+		void finishSearch();
+	private:
+		SearchOptions m_options;
+		SearchTable m_table;
+		std::vector<Frame> m_frames; // by ply
+		std::vector<std::uint64_t> m_path; // hashes of the game and the line
+		std::vector<std::uint16_t> m_excluded; // root events of the lines above
+		std::array<std::array<int, SQ_CNT>, SQ_CNT> m_history; // by origin and destination
+		std::atomic<bool> m_stop;
+		std::atomic<bool> m_ponder_hit;
+		std::mutex m_signal_mutex; // of stop and ponder hit, when waited for
+		std::condition_variable m_signal;
+		SearchLimits m_limits;
+		TimeManager m_time;
+		std::uint64_t m_nodes;
+		std::uint64_t m_budget_nodes; // nodes when the node limit started counting
+		bool m_aborted;
+		bool m_pondering;
+	};
+
+}
@@ -0,0 +1,119 @@
+#include "snapshot.h"
+
+#include <cstring>
+#include <type_traits>
+
+#include "controller.h"
+#include "history.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+static_assert(is_trivially_copyable<PositionSnapshot>::value,
+              "snapshots are copied word by word");
+
+PositionSnapshot chesslib::makeSnapshot(GameController const& gameController)
+{
+	auto const& state = gameController.getState();
+	PositionSnapshot snapshot{};
+	for (Square sq = SQ_A1; sq < SQ_CNT; ++sq)
+		snapshot.pieces[sq] = packPiece(state.getPieceAt(sq));
+	snapshot.hash = state.getHash();
+	snapshot.altered = state.getAlteredMask();
+	snapshot.ply = static_cast<uint32_t>(gameController.getPly());
+	snapshot.halfmove_clock = state.getHalfmoveClock();
+	snapshot.turn = state.getTurn();
+	snapshot.phase = state.getPhase();
+	snapshot.draw_reason = state.getDrawReason();
+	snapshot.enpassant = state.getEnPassantPawn();
+	return snapshot;
+}
+
+void chesslib::restoreSnapshot(PositionSnapshot const& snapshot, GameState& state)
+{
+	for (Square sq = SQ_A1; sq < SQ_CNT; ++sq)
+		state.setPiece(sq, unpackPiece(snapshot.pieces[sq]));
+	if (state.getTurn() != snapshot.turn)
+		state.nextTurn();
+	state.setEnPassantPawn(snapshot.enpassant);
+	state.setAlteredMask(snapshot.altered);
+	state.setPhase(snapshot.phase);
+	state.setDrawReason(snapshot.draw_reason);
+	state.setHalfmoveClock(snapshot.halfmove_clock);
+	state.refresh();
+}
+
+SnapshotPublisher::SnapshotPublisher() :
+	m_version(0)
+{
+	for (auto& slot : m_slots) {
+		slot.sequence.store(0, memory_order_relaxed);
+		for (auto& word : slot.words)
+			word.store(0, memory_order_relaxed);
+	}
+}
+
+void SnapshotPublisher::publish(PositionSnapshot snapshot)
+{
+	auto const version = m_version.load(memory_order_relaxed) + 1;
+	snapshot.version = version;
+
+	uint64_t words[word_cnt] = {};
+	memcpy(words, &snapshot, sizeof(snapshot));
+
+	// Readers go for the slot of the latest version, so the slot written
+	// is the one least recently published
+	auto& slot = m_slots[version % slot_cnt];
+	auto const sequence = slot.sequence.load(memory_order_relaxed);
+	slot.sequence.store(sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	for (size_t i = 0; i < word_cnt; ++i)
+		slot.words[i].store(words[i], memory_order_relaxed);
+	slot.sequence.store(sequence + 2, memory_order_release);
+
+	m_version.store(version, memory_order_release);
+}
+
+PositionSnapshot SnapshotPublisher::read() const
+{
+	uint64_t words[word_cnt];
+	while (true) {
+		auto const version = m_version.load(memory_order_acquire);
+		auto const& slot = m_slots[version % slot_cnt];
+		auto const before = slot.sequence.load(memory_order_acquire);
+		if (before & 1)
+			continue;
+		for (size_t i = 0; i < word_cnt; ++i)
+			words[i] = slot.words[i].load(memory_order_relaxed);
+		atomic_thread_fence(memory_order_acquire);
+		if (slot.sequence.load(memory_order_relaxed) == before)
+			break;
+	}
+
+	PositionSnapshot snapshot;
+	memcpy(&snapshot, words, sizeof(snapshot));
+	return snapshot;
+}
+
+uint64_t SnapshotPublisher::getVersion() const
+{
+	return m_version.load(memory_order_acquire);
+}
+
+void SnapshotPublisher::onEventApplied(GameController const& gameController,
+                                       EventRecord const& record)
+{
+	publish(makeSnapshot(gameController));
+}
+
+void SnapshotPublisher::onEventUndone(GameController const& gameController,
+                                      EventRecord const& record)
+{
+	publish(makeSnapshot(gameController));
+}
+
+void SnapshotPublisher::onStateReset(GameController const& gameController)
+{
+	publish(makeSnapshot(gameController));
+}
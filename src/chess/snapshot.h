@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array> // std::array
+#include <atomic> // std::atomic
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint8_t, std::uint32_t, std::uint64_t
+
+#include "observer.h" // GameObserver
+#include "types.h" // Colour, Phase, DrawReason, Square
+
+namespace chesslib
+{
+
+	class GameController;
+	class GameState;
+
+	// A game state, plus where the game is at, packed in a trivially
+	// copyable structure that can be copied around without allocating
+	struct PositionSnapshot
+	{
+		std::array<std::uint8_t, SQ_CNT> pieces; // see packPiece
+		std::uint64_t hash;
+		std::uint64_t altered; // altered squares as a bitmask
+		std::uint64_t version; // number of snapshots published before
+		std::uint32_t ply; // see GameController::getPly
+		std::uint32_t halfmove_clock;
+		Colour turn;
+		Phase phase;
+		DrawReason draw_reason;
+		Square enpassant;
+	};
+
+	// Take snapshot of the game state of a controller
+	PositionSnapshot makeSnapshot(GameController const& gameController);
+
+	// Copy snapshot into a game state
+	void restoreSnapshot(PositionSnapshot const& snapshot, GameState& state);
+
+	// Latest snapshot of a game, for any number of threads to read while
+	// the game goes on, without locks. Snapshots are written into a ring
+	// of slots, each guarded by a sequence number (seqlock): the writer
+	// never waits, however many readers there are or however slow they
+	// are, and readers copy a slot without taking it from anybody, only
+	// trying again in the unlikely case that the writer went around the
+	// whole ring while they were copying.
+	//
+	// As an observer, it publishes the game state after every change.
+	// Only one thread may publish at a time (which is the case of the
+	// thread updating the controller).
+	class SnapshotPublisher : public GameObserver
+	{
+	public:
+		// Create publisher of an empty snapshot, of version 0
+		SnapshotPublisher();
+
+		SnapshotPublisher(SnapshotPublisher const&) = delete;
+		SnapshotPublisher& operator=(SnapshotPublisher const&) = delete;
+
+		// Publish snapshot, setting its version
+		void publish(PositionSnapshot snapshot);
+
+		// Get latest snapshot
+		PositionSnapshot read() const;
+
+		// Get number of snapshots published, which is cheaper to poll
+		// than reading the snapshot itself
+		std::uint64_t getVersion() const;
+
+		void onEventApplied(GameController const& gameController,
+		                    EventRecord const& record) override;
+
+		void onEventUndone(GameController const& gameController,
+		                   EventRecord const& record) override;
+
+		void onStateReset(GameController const& gameController) override;
+	private:
+		static constexpr std::size_t slot_cnt = 4;
+		static constexpr std::size_t word_cnt =
+			(sizeof(PositionSnapshot) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+		// A snapshot stored as words that can be accessed atomically,
+		// so that a reader racing with the writer is well defined
+		struct Slot
+		{
+			std::atomic<std::uint64_t> sequence; // odd while written
+			std::array<std::atomic<std::uint64_t>, word_cnt> words;
+		};
+
+		std::array<Slot, slot_cnt> m_slots;
+		std::atomic<std::uint64_t> m_version;
+	};
+
+}
@@ -11,30 +11,88 @@
 using namespace std;
 using namespace chesslib;
 
+// Random keys used for Zobrist hashing, generated at compile time
+struct ZobristKeys
+{
+	uint64_t piece[static_cast<size_t>(Colour::MAX)]
+	              [static_cast<size_t>(PieceTypeId::MAX)][SQ_CNT];
+	uint64_t altered[SQ_CNT];
+	uint64_t enpassant[SQ_CNT];
+	uint64_t turn;
+};
+
+// Squares whose altered flag matters to the rules (castling)
+static constexpr uint64_t castling_squares_mask =
+	(1ULL << SQ_A1) | (1ULL << SQ_E1) | (1ULL << SQ_H1) |
+	(1ULL << SQ_A8) | (1ULL << SQ_E8) | (1ULL << SQ_H8);
+
+static constexpr ZobristKeys makeZobristKeys()
+{
+	ZobristKeys keys{};
+	uint64_t seed = 0x2545F4914F6CDD1DULL;
+	auto next = [&seed] {
+		// SplitMix64
+		uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	};
+	for (auto& colour_keys : keys.piece)
+		for (auto& type_keys : colour_keys)
+			for (auto& key : type_keys)
+				key = next();
+	for (size_t sq = 0; sq < SQ_CNT; ++sq) {
+		auto key = next();
+		keys.altered[sq] = (castling_squares_mask >> sq) & 1 ? key : 0;
+	}
+	for (auto& key : keys.enpassant)
+		key = next();
+	keys.turn = next();
+	return keys;
+}
+
+static constexpr ZobristKeys zobrist = makeZobristKeys();
+
+// Get key of the contents of a square (zero for empty tiles)
+// The altered flag only matters to the rules while there is a piece
+// on the square, so it is only hashed then.
+static inline uint64_t squareKey(Piece const& p, Square sq, bool altered)
+{
+	auto id = p.getType()->getId();
+	if (id == PieceTypeId::NONE)
+		return 0;
+	auto key = zobrist.piece[static_cast<size_t>(p.getColour())]
+	                        [static_cast<size_t>(id)][sq];
+	if (altered)
+		key ^= zobrist.altered[sq];
+	return key;
+}
+
 GameState::GameState() :
 	m_turn(Colour::WHITE),
 	m_phase(Phase::RUNNING),
-	m_enpassant_pawn(Square::SQ_CNT)
-{
-	fill(m_altered_map,
-	     m_altered_map + size(m_altered_map),
-	     false);
-}
+	m_draw_reason(DrawReason::NONE),
+	m_halfmove_clock(0),
+	m_altered_mask(0),
+	m_enpassant_pawn(Square::SQ_CNT),
+	m_hash(computeHash())
+{}
 
 GameState::GameState(GameState const& other) :
 	m_board(other.m_board),
 	m_turn(other.m_turn),
 	m_phase(other.m_phase),
-	m_enpassant_pawn(other.m_enpassant_pawn)
-{
-	copy(other.m_altered_map,
-	     other.m_altered_map + size(m_altered_map),
-	     m_altered_map);
-}
+	m_draw_reason(other.m_draw_reason),
+	m_halfmove_clock(other.m_halfmove_clock),
+	m_altered_mask(other.m_altered_mask),
+	m_enpassant_pawn(other.m_enpassant_pawn),
+	m_hash(other.m_hash)
+{}
 
 void GameState::nextTurn()
 {
 	m_turn = static_cast<Colour>(1 - static_cast<int>(m_turn));
+	m_hash ^= zobrist.turn;
 }
 
 Board& GameState::getBoard()
@@ -53,6 +111,27 @@ Phase GameState::getPhase() const
 	return m_phase;
 }
 
+void GameState::setDrawReason(DrawReason reason)
+{
+	assert(DrawReasonCheck(reason));
+	m_draw_reason = reason;
+}
+
+DrawReason GameState::getDrawReason() const
+{
+	return m_draw_reason;
+}
+
+void GameState::setHalfmoveClock(unsigned int clock)
+{
+	m_halfmove_clock = clock;
+}
+
+unsigned int GameState::getHalfmoveClock() const
+{
+	return m_halfmove_clock;
+}
+
 Board const& GameState::getBoard() const
 {
 	return m_board;
@@ -71,19 +150,63 @@ Square GameState::getEnPassantPawn() const
 void GameState::setEnPassantPawn(Square pawn)
 {
 	assert(EnPassantPawnCheck(pawn));
+	clearEnPassantPawn();
 	m_enpassant_pawn = pawn;
+	if (pawn != Square::SQ_CNT)
+		m_hash ^= zobrist.enpassant[pawn];
 }
 
 bool GameState::wasSquareAltered(Square sq) const
 {
 	assert(SquareCheck(sq));
-	return m_altered_map[static_cast<size_t>(sq)];
+	return (m_altered_mask >> sq) & 1;
 }
 
 void GameState::setSquareAltered(Square sq, bool altered)
 {
 	assert(SquareCheck(sq));
-	m_altered_map[static_cast<size_t>(sq)] = altered;
+	if (wasSquareAltered(sq) != altered) {
+		m_hash ^= squareKey(m_board[sq], sq, !altered);
+		m_altered_mask ^= 1ULL << sq;
+		m_hash ^= squareKey(m_board[sq], sq, altered);
+	}
+}
+
+void GameState::setAlteredMask(uint64_t mask)
+{
+	auto diff = (mask ^ m_altered_mask) & castling_squares_mask;
+	for (Square sq = SQ_A1; sq < SQ_CNT; ++sq)
+		if ((diff >> sq) & 1)
+			m_hash ^= squareKey(m_board[sq], sq, false) ^
+			          squareKey(m_board[sq], sq, true);
+	m_altered_mask = mask;
+}
+
+uint64_t GameState::getAlteredMask() const
+{
+	return m_altered_mask;
+}
+
+uint64_t GameState::getHash() const
+{
+	return m_hash;
+}
+
+void GameState::refresh()
+{
+	m_hash = computeHash();
+}
+
+uint64_t GameState::computeHash() const
+{
+	uint64_t hash = 0;
+	for (Square sq = SQ_A1; sq < SQ_CNT; ++sq)
+		hash ^= squareKey(m_board[sq], sq, wasSquareAltered(sq));
+	if (hasEnPassant())
+		hash ^= zobrist.enpassant[m_enpassant_pawn];
+	if (m_turn == Colour::BLACK)
+		hash ^= zobrist.turn;
+	return hash;
 }
 
 void GameState::movePiece(Square origin, Square dest)
@@ -94,11 +217,14 @@ void GameState::movePiece(Square origin, Square dest)
 	auto& origpiece = getPieceAt(origin);
 	auto& destpiece = getPieceAt(dest);
 
+	m_hash ^= squareKey(origpiece, origin, wasSquareAltered(origin));
+	m_hash ^= squareKey(destpiece, dest, wasSquareAltered(dest));
+
 	destpiece = origpiece;
 	origpiece.clear();
 
-	setSquareAltered(origin, true);
-	setSquareAltered(dest, true);
+	m_altered_mask |= (1ULL << origin) | (1ULL << dest);
+	m_hash ^= squareKey(destpiece, dest, true);
 }
 
 void GameState::save(ostream& out) const
@@ -117,35 +243,48 @@ void GameState::save(ostream& out) const
 		out << static_cast<int>(id) << " ";
 		out << altered << endl;
 	}
-	out << -1;
+	out << -1 << endl;
+	out << m_halfmove_clock;
+}
+
+// Read number of a saved game state
+// Throws IO_TRUNCATED if there is none
+template<typename T>
+static void readNumber(istream& in, T& value)
+{
+	if (!(in >> value)) {
+		in.setstate(ios::failbit);
+		throw GameError::IO_TRUNCATED;
+	}
 }
 
 void GameState::load(istream& in)
 {
 	int version;
-	in >> version;
+	readNumber(in, version);
 	if (version != chesslib::major_version) {
 		in.setstate(ios::failbit);
 		throw GameError::IO_VERSION;
 	}
 	int turn_int;
-	in >> turn_int;
+	readNumber(in, turn_int);
 	if (turn_int < 0 || turn_int > 1) {
 		in.setstate(ios::failbit);
 		throw GameError::IO_TURN;
 	}
 	m_turn = static_cast<Colour>(turn_int);
 	int enpassant_int;
-	in >> enpassant_int;
+	readNumber(in, enpassant_int);
 	auto enpassant = static_cast<Square>(enpassant_int);
 	if (!EnPassantPawnCheck(enpassant)) {
 		in.setstate(ios::failbit);
 		throw GameError::IO_EN_PASSANT;
 	}
 	m_enpassant_pawn = enpassant;
+	m_altered_mask = 0;
 	vector<bool> has_piece_map(SQ_CNT, false);
 	int square_int;
-	for (in >> square_int; square_int != -1; in >> square_int) {
+	for (readNumber(in, square_int); square_int != -1; readNumber(in, square_int)) {
 		Square square = static_cast<Square>(square_int);
 		if (!SquareCheck(square)) {
 			in.setstate(ios::failbit);
@@ -153,7 +292,7 @@ void GameState::load(istream& in)
 		}
 		has_piece_map[square_int] = true;
 		int colour_int;
-		in >> colour_int;
+		readNumber(in, colour_int);
 		if (colour_int < 0 || colour_int > 1) {
 			in.setstate(ios::failbit);
 			throw GameError::IO_COLOUR;
@@ -161,7 +300,7 @@ void GameState::load(istream& in)
 		auto& piece = m_board[square];
 		piece.setColour(static_cast<Colour>(colour_int));
 		int type_int;
-		in >> type_int;
+		readNumber(in, type_int);
 		auto type = static_cast<PieceTypeId>(type_int);
 		if (!PieceTypeIdCheck(type)) {
 			in.setstate(ios::failbit);
@@ -169,16 +308,26 @@ void GameState::load(istream& in)
 		}
 		piece.setType(type);
 		bool altered;
-		in >> altered;
+		readNumber(in, altered);
 		setSquareAltered(square, altered);
 	}
 	for (Square sq = SQ_A1; sq < SQ_CNT; ++sq)
 		if (!has_piece_map[static_cast<size_t>(sq)])
 			m_board[sq].clear();
+	// The halfmove clock was only added in version 1.2
+	if (!(in >> m_halfmove_clock)) {
+		in.clear();
+		m_halfmove_clock = 0;
+	}
+	m_phase = Phase::RUNNING;
+	m_draw_reason = DrawReason::NONE;
+	refresh();
 }
 
 void GameState::clearEnPassantPawn()
 {
+	if (hasEnPassant())
+		m_hash ^= zobrist.enpassant[m_enpassant_pawn];
 	m_enpassant_pawn = Square::SQ_CNT;
 }
 
@@ -189,7 +338,17 @@ bool GameState::hasEnPassant() const
 
 void GameState::clearSquare(Square sq)
 {
-	getPieceAt(sq).clear();
+	auto& piece = getPieceAt(sq);
+	m_hash ^= squareKey(piece, sq, wasSquareAltered(sq));
+	piece.clear();
+}
+
+void GameState::setPiece(Square sq, Piece const& piece)
+{
+	auto& square_piece = getPieceAt(sq);
+	m_hash ^= squareKey(square_piece, sq, wasSquareAltered(sq));
+	square_piece = piece;
+	m_hash ^= squareKey(square_piece, sq, wasSquareAltered(sq));
 }
 
 Piece const& GameState::getPieceAt(Square sq) const
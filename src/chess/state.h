@@ -1,9 +1,10 @@
 #pragma once
 
 #include <iosfwd> // std::istream, std::ostream
+#include <cstdint> // std::uint64_t
 
 #include "board.h" // Board
-#include "types.h" // Colour, Phase, Square
+#include "types.h" // Colour, Phase, DrawReason, Square
 #include "error.h" // GameError
 
 namespace chesslib
@@ -32,19 +33,38 @@ namespace chesslib
 		// Get game phase
 		Phase getPhase() const;
 
+		// Set reason why the game was drawn
+		void setDrawReason(DrawReason reason);
+
+		// Get reason why the game was drawn (NONE unless phase is DRAW)
+		DrawReason getDrawReason() const;
+
+		// Set number of plies since the last capture or pawn move
+		void setHalfmoveClock(unsigned int clock);
+
+		// Get number of plies since the last capture or pawn move
+		unsigned int getHalfmoveClock() const;
+
 		// Move piece
 		void movePiece(Square origin, Square dest);
 
 		// Set/Get piece at square
+		// Changing the piece through this reference bypasses the
+		// position hash, which should then be refreshed
 		Piece& getPieceAt(Square sq);
 
 		// Get piece at square
 		Piece const& getPieceAt(Square sq) const;
 
+		// Set piece at square
+		void setPiece(Square sq, Piece const& piece);
+
 		// Clear square
 		void clearSquare(Square sq);
 
 		// Set/Get board
+		// Changing the board through this reference bypasses the
+		// position hash, which should then be refreshed
 		Board& getBoard();
 
 		// Get board (const)
@@ -68,18 +88,39 @@ namespace chesslib
 		// Check whether square was altered
 		bool wasSquareAltered(Square sq) const;
 
+		// Set altered squares from a bitmask (one bit per square)
+		void setAlteredMask(std::uint64_t mask);
+
+		// Get altered squares as a bitmask (one bit per square)
+		std::uint64_t getAlteredMask() const;
+
+		// Get position hash, which is equal for game states that are
+		// indistinguishable as far as the rules are concerned (same pieces,
+		// turn, en passant and castling squares altered)
+		std::uint64_t getHash() const;
+
+		// Recalculate the position hash from scratch, which is only
+		// needed after changing the board through non-const references
+		void refresh();
+
 		// Deserialize game state
 		// Throws GameError in case of error
 		void load(std::istream& in);
 
 		// Serialize game state
 		void save(std::ostream& out) const;
+	private:
+		// Calculate position hash from scratch
+		std::uint64_t computeHash() const;
 	private:
 		Board m_board;
 		Colour m_turn;
 		Phase m_phase;
-		bool m_altered_map[SQ_CNT];
+		DrawReason m_draw_reason;
+		unsigned int m_halfmove_clock;
+		std::uint64_t m_altered_mask;
 		Square m_enpassant_pawn;
+		std::uint64_t m_hash;
 	};
 
 	inline bool EnPassantPawnCheck(Square sq)
@@ -0,0 +1,117 @@
+#include "statistics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+using namespace chesslib;
+
+static const size_t counter_cnt = static_cast<size_t>(Counter::MAX);
+
+static char const* const counter_names[] = {
+	"update",
+	"canUpdate",
+	"inCheck",
+	"checkmateScan",
+	"promotion",
+	"moveCacheMiss",
+};
+
+static_assert(size(counter_names) == counter_cnt, "every counter needs a name");
+
+namespace
+{
+	struct CounterBlock;
+
+	// Counters of all threads, plus what is left of finished threads
+	struct Registry
+	{
+		mutex lock;
+		vector<CounterBlock const*> blocks;
+		array<uint64_t, counter_cnt> retired{};
+		array<uint64_t, counter_cnt> baseline{};
+	};
+
+	// Never destroyed, as threads may finish after static destruction
+	Registry& getRegistry()
+	{
+		static auto* registry = new Registry;
+		return *registry;
+	}
+
+	// Counters of a thread, which only that thread writes to
+	struct alignas(64) CounterBlock
+	{
+		array<atomic<uint64_t>, counter_cnt> counts{};
+
+		CounterBlock()
+		{
+			auto& registry = getRegistry();
+			lock_guard<mutex> guard(registry.lock);
+			registry.blocks.push_back(this);
+		}
+
+		~CounterBlock()
+		{
+			auto& registry = getRegistry();
+			lock_guard<mutex> guard(registry.lock);
+			for (size_t i = 0; i < counter_cnt; ++i)
+				registry.retired[i] += counts[i].load(memory_order_relaxed);
+			registry.blocks.erase(find(registry.blocks.begin(),
+			                           registry.blocks.end(), this));
+		}
+	};
+
+	// Sum counters of all threads, with the registry locked
+	array<uint64_t, counter_cnt> sumCounters(Registry const& registry)
+	{
+		auto total = registry.retired;
+		for (auto const* block : registry.blocks)
+			for (size_t i = 0; i < counter_cnt; ++i)
+				total[i] += block->counts[i].load(memory_order_relaxed);
+		return total;
+	}
+}
+
+void chesslib::increment(Counter counter)
+{
+	thread_local CounterBlock block;
+	auto& c = block.counts[static_cast<size_t>(counter)];
+	// There is a single writer, so there is no need for an atomic increment
+	c.store(c.load(memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+Statistics chesslib::getStatistics()
+{
+	Statistics statistics{};
+	auto& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	auto const total = sumCounters(registry);
+	for (size_t i = 0; i < counter_cnt; ++i)
+		statistics.counts[i] = total[i] - registry.baseline[i];
+	return statistics;
+}
+
+void chesslib::resetStatistics()
+{
+	// Counters are never written to by other threads, so resetting
+	// only moves the baseline they are read against
+	auto& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	registry.baseline = sumCounters(registry);
+}
+
+char const* chesslib::getCounterName(Counter counter)
+{
+	return counter_names[static_cast<size_t>(counter)];
+}
+
+void chesslib::dumpStatistics(ostream& os)
+{
+	auto const statistics = getStatistics();
+	for (size_t i = 0; i < counter_cnt; ++i)
+		os << counter_names[i] << ' ' << statistics.counts[i] << endl;
+}
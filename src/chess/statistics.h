@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array> // std::array
+#include <cstdint> // std::uint64_t
+#include <iosfwd> // std::ostream
+
+namespace chesslib
+{
+
+	// What the rules engine counts, when built with CHESS_STATISTICS
+	enum class Counter
+	{
+		UPDATE, // calls to GameController::update
+		CAN_UPDATE, // calls to GameController::canUpdate
+		IN_CHECK, // scans of the board for checks and pins
+		CHECKMATE_SCAN, // searches for a legal move after an update
+		PROMOTION, // pawn promotions asked to the listener
+		MOVE_CACHE_MISS, // legal moves of a position generated for the cache
+		MAX
+	};
+
+	// Counters summed over all threads since the last reset
+	struct Statistics
+	{
+		std::array<std::uint64_t, static_cast<std::size_t>(Counter::MAX)> counts;
+
+		std::uint64_t get(Counter counter) const
+		{
+			return counts[static_cast<std::size_t>(counter)];
+		}
+	};
+
+#if defined(CHESS_STATISTICS)
+	constexpr bool statistics_enabled = true;
+#else
+	constexpr bool statistics_enabled = false;
+#endif
+
+	// Increment counter of the calling thread
+	// Each thread has its own counters, so counting takes no lock and
+	// shares no cache line with other threads.
+	void increment(Counter counter);
+
+	// Get counters of all threads (all zero unless statistics are enabled)
+	Statistics getStatistics();
+
+	// Start counting from zero again
+	void resetStatistics();
+
+	// Get name of counter, as printed by dumpStatistics
+	char const* getCounterName(Counter counter);
+
+	// Print counters, one per line
+	void dumpStatistics(std::ostream& os);
+
+}
+
+// Count an occurrence on the hot path, or nothing at all if statistics
+// are not compiled in
+#if defined(CHESS_STATISTICS)
+#define CHESS_COUNT(counter) ::chesslib::increment(::chesslib::Counter::counter)
+#else
+#define CHESS_COUNT(counter) ((void) 0)
+#endif
@@ -0,0 +1,1230 @@
+#include "tablebase.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <climits>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "bitboard.h"
+#include "mapping.h"
+#include "state.h"
+
+using namespace std;
+using namespace chesslib;
+
+// Values stored for each position: 1 for draws and 2 + DTM otherwise,
+// so that odd distances are wins and even distances are losses for the
+// player to move. Positions that cannot occur are only told apart while
+// generating, and are stored as whatever compresses best.
+static const uint16_t value_invalid = 0;
+static const uint16_t value_draw = 1;
+static const uint16_t value_mate = 2;
+static const uint16_t value_unknown = 0xFFFF; // only while generating
+
+// Table file layout (all integers little-endian)
+static const char file_magic[] = { 'C', 'H', 'T', 'B' };
+static const uint32_t file_version = 1;
+static const size_t file_header_size = 40;
+static const size_t file_block_size = 16;
+static const size_t file_padding = 8;
+static const uint32_t entries_per_block = 4096;
+
+// Piece types a pawn can be promoted to
+static const PieceTypeId promotions[] = {
+	PieceTypeId::QUEEN,
+	PieceTypeId::ROOK,
+	PieceTypeId::BISHOP,
+	PieceTypeId::KNIGHT,
+};
+
+static const size_t promotion_cnt = size(promotions);
+
+static bool isWin(uint16_t value)
+{
+	return value >= value_mate && value != value_unknown &&
+	       (value - value_mate) % 2 == 1;
+}
+
+static bool isLoss(uint16_t value)
+{
+	return value >= value_mate && value != value_unknown &&
+	       (value - value_mate) % 2 == 0;
+}
+
+static unsigned int getDtm(uint16_t value)
+{
+	return value - value_mate;
+}
+
+static uint64_t getLittleEndian(unsigned char const* in, size_t n)
+{
+	uint64_t value = 0;
+	for (size_t i = n; i > 0; --i)
+		value = (value << 8) | in[i - 1];
+	return value;
+}
+
+static void putLittleEndian(vector<unsigned char>& out, uint64_t value, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		out.push_back(static_cast<unsigned char>(value >> (8 * i)));
+}
+
+namespace
+{
+	// A piece of a table, whose square changes from position to position
+	struct Slot
+	{
+		PieceTypeId id;
+		Colour colour;
+	};
+
+	bool operator==(Slot const& a, Slot const& b)
+	{
+		return a.id == b.id && a.colour == b.colour;
+	}
+
+	// Order of pieces in material signatures, strongest first
+	int getPieceOrder(PieceTypeId id)
+	{
+		switch (id) {
+		case PieceTypeId::KING: return 0;
+		case PieceTypeId::QUEEN: return 1;
+		case PieceTypeId::ROOK: return 2;
+		case PieceTypeId::BISHOP: return 3;
+		case PieceTypeId::KNIGHT: return 4;
+		default: return 5;
+		}
+	}
+
+	char getPieceLetter(PieceTypeId id)
+	{
+		return "?PKQBNR"[static_cast<int>(id)];
+	}
+
+	// Tables lay pieces out as the white king, the black king, and then
+	// the other white pieces and the other black pieces, strongest first
+	bool comesBefore(Slot const& a, Slot const& b)
+	{
+		bool a_king = a.id == PieceTypeId::KING;
+		bool b_king = b.id == PieceTypeId::KING;
+		if (a_king != b_king)
+			return a_king;
+		if (a.colour != b.colour)
+			return a.colour == Colour::WHITE;
+		return getPieceOrder(a.id) < getPieceOrder(b.id);
+	}
+
+	// Parse material signature, such as "KRPvK"
+	bool parseMaterial(string const& material, vector<Slot>& slots)
+	{
+		slots.clear();
+		auto colour = Colour::WHITE;
+		for (char c : material) {
+			if ((c == 'v' || c == 'V') && colour == Colour::WHITE) {
+				colour = Colour::BLACK;
+				continue;
+			}
+			auto id = PieceTypeId::NONE;
+			for (auto i = PieceTypeId::PAWN; i < PieceTypeId::MAX;
+			     i = static_cast<PieceTypeId>(static_cast<int>(i) + 1))
+				if (toupper(static_cast<unsigned char>(c)) == getPieceLetter(i))
+					id = i;
+			if (id == PieceTypeId::NONE)
+				return false;
+			slots.push_back(Slot{ id, colour });
+		}
+		if (colour != Colour::BLACK || slots.size() > tablebase_max_pieces)
+			return false;
+		for (auto c : { Colour::WHITE, Colour::BLACK })
+			if (count(slots.begin(), slots.end(), Slot{ PieceTypeId::KING, c }) != 1)
+				return false;
+		stable_sort(slots.begin(), slots.end(), comesBefore);
+		return true;
+	}
+
+	string getMaterialName(vector<Slot> const& slots)
+	{
+		auto sorted = slots;
+		stable_sort(sorted.begin(), sorted.end(), comesBefore);
+		string white, black;
+		for (auto const& slot : sorted)
+			(slot.colour == Colour::WHITE ? white : black) += getPieceLetter(slot.id);
+		return white + "v" + black;
+	}
+
+	// Board symmetries that preserve the rules for a set of pieces
+	// NONE means no symmetry, MIRROR means left-right and FULL means
+	// the 8 symmetries of the square.
+	enum class Symmetry : uint8_t
+	{
+		NONE,
+		MIRROR,
+		FULL,
+		MAX
+	};
+
+	// Transform square by flipping files (t & 1), flipping ranks (t & 2)
+	// and then by swapping ranks with files (t & 4)
+	Square transformSquare(Square sq, int t)
+	{
+		int rank = getSquareRank(sq);
+		int file = getSquareFile(sq);
+		if (t & 1)
+			file = FL_H - file;
+		if (t & 2)
+			rank = RK_8 - rank;
+		if (t & 4)
+			swap(rank, file);
+		return getSquare(static_cast<Rank>(rank), static_cast<File>(file));
+	}
+
+	Bitboard transformBitboard(Bitboard bb, int t)
+	{
+		Bitboard transformed = 0;
+		while (bb)
+			transformed |= squareBit(transformSquare(popFirstSquare(bb), t));
+		return transformed;
+	}
+
+	// Check whether the moves of a piece look the same once transformed
+	// The moves of sliding pieces are geometric, so they always do.
+	bool isSymmetric(Slot const& slot, int t)
+	{
+		for (Square sq = SQ_A1; sq < SQ_CNT; ++sq) {
+			auto const tsq = transformSquare(sq, t);
+			switch (slot.id) {
+			case PieceTypeId::KING:
+				if (transformBitboard(getKingMoves(sq), t) != getKingMoves(tsq))
+					return false;
+				break;
+			case PieceTypeId::KNIGHT:
+				if (transformBitboard(getKnightMoves(sq), t) != getKnightMoves(tsq))
+					return false;
+				break;
+			case PieceTypeId::PAWN:
+				if (transformBitboard(getPawnPushes(slot.colour, sq), t) !=
+				    getPawnPushes(slot.colour, tsq) ||
+				    transformBitboard(getPawnCaptures(slot.colour, sq), t) !=
+				    getPawnCaptures(slot.colour, tsq))
+					return false;
+				break;
+			default:
+				break;
+			}
+		}
+		return true;
+	}
+
+	Symmetry getSymmetry(vector<Slot> const& slots)
+	{
+		auto symmetric = [&slots] (int t) {
+			return all_of(slots.begin(), slots.end(),
+			              [t] (Slot const& slot) { return isSymmetric(slot, t); });
+		};
+		if (symmetric(1) && symmetric(2) && symmetric(4))
+			return Symmetry::FULL;
+		if (symmetric(1))
+			return Symmetry::MIRROR;
+		return Symmetry::NONE;
+	}
+
+	// A position of a table: the square of every piece (SQ_CNT for pieces
+	// that were captured) and the player to move
+	struct Position
+	{
+		Square squares[tablebase_max_pieces]{};
+		Colour turn;
+	};
+
+	// Maps positions of a set of pieces to indices and back. The white
+	// king is brought to a fundamental domain of the board symmetries
+	// (10 squares for FULL, half of the board for MIRROR), and pieces
+	// of the same kind are sorted, so that each position has one index.
+	class TableLayout
+	{
+	public:
+		TableLayout() : m_symmetry(Symmetry::NONE), m_size(0) {}
+
+		TableLayout(vector<Slot> const& slots, Symmetry symmetry) :
+			m_slots(slots),
+			m_symmetry(symmetry)
+		{
+			m_king_index.fill(-1);
+			for (Square sq = SQ_A1; sq < SQ_CNT; ++sq) {
+				if (getCanonicalTransform(sq) != 0)
+					continue;
+				m_king_index[sq] = static_cast<int>(m_king_squares.size());
+				m_king_squares.push_back(sq);
+			}
+			m_size = m_king_squares.size() * 2;
+			for (size_t i = 1; i < m_slots.size(); ++i)
+				m_size *= SQ_CNT;
+		}
+
+		size_t getPieceCount() const { return m_slots.size(); }
+		Slot const& getSlot(size_t i) const { return m_slots[i]; }
+		vector<Slot> const& getSlots() const { return m_slots; }
+		Symmetry getSymmetry() const { return m_symmetry; }
+		uint64_t size() const { return m_size; }
+
+		// Get index of position (with no captured pieces)
+		uint64_t getIndex(Position const& pos) const
+		{
+			Square squares[tablebase_max_pieces]{};
+			transform(pos, getCanonicalTransform(pos.squares[0]), squares);
+
+			// With the white king on the diagonal, the position mirrored
+			// along the diagonal is in the domain too, so the smallest of
+			// the two is taken
+			if (m_symmetry == Symmetry::FULL &&
+			    static_cast<int>(getSquareRank(squares[0])) ==
+			    static_cast<int>(getSquareFile(squares[0]))) {
+				Position mirrored;
+				copy(squares, squares + m_slots.size(), mirrored.squares);
+				Square other[tablebase_max_pieces];
+				transform(mirrored, 4, other);
+				if (lexicographical_compare(other, other + m_slots.size(),
+				                            squares, squares + m_slots.size()))
+					copy(other, other + m_slots.size(), squares);
+			}
+
+			uint64_t index = m_king_index[squares[0]];
+			for (size_t i = 1; i < m_slots.size(); ++i)
+				index = index * SQ_CNT + squares[i];
+			return index * 2 + static_cast<int>(pos.turn);
+		}
+
+		// Get position at index
+		Position getPosition(uint64_t index) const
+		{
+			Position pos;
+			pos.turn = static_cast<Colour>(index & 1);
+			index >>= 1;
+			for (size_t i = m_slots.size() - 1; i > 0; --i) {
+				pos.squares[i] = static_cast<Square>(index % SQ_CNT);
+				index /= SQ_CNT;
+			}
+			pos.squares[0] = m_king_squares[index];
+			return pos;
+		}
+
+	private:
+		// Transform the squares of a position, and sort the ones of pieces
+		// of the same kind
+		void transform(Position const& pos, int t, Square* squares) const
+		{
+			for (size_t i = 0; i < m_slots.size(); ++i)
+				squares[i] = transformSquare(pos.squares[i], t);
+			for (size_t i = 3; i < m_slots.size(); ++i)
+				for (size_t j = i; j > 2 && m_slots[j - 1] == m_slots[j] &&
+				     squares[j - 1] > squares[j]; --j)
+					swap(squares[j - 1], squares[j]);
+		}
+
+		// Get transformation that brings the white king to the domain
+		int getCanonicalTransform(Square king) const
+		{
+			int t = 0;
+			if (m_symmetry == Symmetry::NONE)
+				return t;
+			if (getSquareFile(king) > FL_D)
+				t |= 1;
+			if (m_symmetry == Symmetry::MIRROR)
+				return t;
+			if (getSquareRank(king) > RK_4)
+				t |= 2;
+			auto sq = transformSquare(king, t);
+			if (static_cast<int>(getSquareRank(sq)) > static_cast<int>(getSquareFile(sq)))
+				t |= 4;
+			return t;
+		}
+	private:
+		vector<Slot> m_slots;
+		Symmetry m_symmetry;
+		array<int, SQ_CNT> m_king_index;
+		vector<Square> m_king_squares;
+		uint64_t m_size;
+	};
+
+	Square getKingSquare(Position const& pos, Colour c)
+	{
+		return pos.squares[c == Colour::WHITE ? 0 : 1];
+	}
+
+	Bitboard getOccupancy(TableLayout const& layout, Position const& pos, Colour c)
+	{
+		Bitboard occupied = 0;
+		for (size_t i = 0; i < layout.getPieceCount(); ++i)
+			if (layout.getSlot(i).colour == c && pos.squares[i] != SQ_CNT)
+				occupied |= squareBit(pos.squares[i]);
+		return occupied;
+	}
+
+	// Check whether a piece of the given colour can capture at the target
+	bool isAttacked(TableLayout const& layout, Position const& pos,
+	                Square target, Colour by, Bitboard occupied)
+	{
+		for (size_t i = 0; i < layout.getPieceCount(); ++i) {
+			auto const& slot = layout.getSlot(i);
+			auto const sq = pos.squares[i];
+			if (slot.colour == by && sq != SQ_CNT &&
+			    hasSquare(getAttacks(slot.id, by, sq, occupied), target))
+				return true;
+		}
+		return false;
+	}
+
+	// Check whether position can occur in a game, that is, whether pieces
+	// are on different squares, pawns are not on the first or last ranks
+	// and the player who has just moved is not in check
+	bool isValidPosition(TableLayout const& layout, Position const& pos)
+	{
+		Bitboard occupied = 0;
+		for (size_t i = 0; i < layout.getPieceCount(); ++i) {
+			auto const sq = pos.squares[i];
+			if (hasSquare(occupied, sq))
+				return false;
+			occupied |= squareBit(sq);
+			auto const rank = getSquareRank(sq);
+			if (layout.getSlot(i).id == PieceTypeId::PAWN &&
+			    (rank == RK_1 || rank == RK_8))
+				return false;
+		}
+		auto const opponent = getOpponent(pos.turn);
+		return !isAttacked(layout, pos, getKingSquare(pos, opponent),
+		                   pos.turn, occupied);
+	}
+
+	bool isInCheck(TableLayout const& layout, Position const& pos)
+	{
+		auto const occupied = getOccupancy(layout, pos, Colour::WHITE) |
+		                      getOccupancy(layout, pos, Colour::BLACK);
+		return isAttacked(layout, pos, getKingSquare(pos, pos.turn),
+		                  getOpponent(pos.turn), occupied);
+	}
+
+	// A legal move from a position of a table
+	struct TableMove
+	{
+		Position next; // position after the move
+		int captured; // slot of captured piece, or -1
+		int promoted; // slot of promoted pawn, or -1
+		size_t promotion; // index in 'promotions', if promoted
+	};
+
+	// Call function for every legal move of the player to move, with
+	// the same rules as GameController (without castling, which tables
+	// don't have, and en passant, which cannot happen in them)
+	template<class F>
+	void forEachMove(TableLayout const& layout, Position const& pos, F&& fn)
+	{
+		auto const us = pos.turn;
+		auto const them = getOpponent(us);
+		auto const own = getOccupancy(layout, pos, us);
+		auto const enemy = getOccupancy(layout, pos, them);
+		auto const occupied = own | enemy;
+		auto const forbidden = own | squareBit(getKingSquare(pos, them));
+
+		for (size_t i = 0; i < layout.getPieceCount(); ++i) {
+			auto const& slot = layout.getSlot(i);
+			auto const origin = pos.squares[i];
+			if (slot.colour != us || origin == SQ_CNT)
+				continue;
+
+			Bitboard dests;
+			if (slot.id == PieceTypeId::PAWN)
+				dests = (getPawnPushes(us, origin) & ~occupied) |
+				        (getPawnCaptures(us, origin) & enemy);
+			else
+				dests = getAttacks(slot.id, us, origin, occupied);
+			dests &= ~forbidden;
+
+			while (dests) {
+				auto const dest = popFirstSquare(dests);
+				TableMove move{ pos, -1, -1, 0 };
+				move.next.squares[i] = dest;
+				move.next.turn = them;
+				if (hasSquare(enemy, dest)) {
+					for (size_t j = 0; j < layout.getPieceCount(); ++j)
+						if (j != i && pos.squares[j] == dest)
+							move.captured = static_cast<int>(j);
+					move.next.squares[move.captured] = SQ_CNT;
+				}
+
+				auto const after = (occupied & ~squareBit(origin)) | squareBit(dest);
+				if (isAttacked(layout, move.next, getKingSquare(move.next, us),
+				               them, after))
+					continue;
+
+				if (slot.id == PieceTypeId::PAWN && getSquareRank(dest) == getPromotionRank(us)) {
+					move.promoted = static_cast<int>(i);
+					for (move.promotion = 0; move.promotion < promotion_cnt; ++move.promotion)
+						fn(move);
+				} else {
+					fn(move);
+				}
+			}
+		}
+	}
+
+	// Reverse of the moves each piece type makes without capturing, that
+	// is, the squares a piece could have come from to land on a square
+	struct RetroTables
+	{
+		Bitboard king[SQ_CNT];
+		Bitboard knight[SQ_CNT];
+		Bitboard pawn_pushes[2][SQ_CNT];
+	};
+
+	RetroTables makeRetroTables()
+	{
+		RetroTables t{};
+		for (Square from = SQ_A1; from < SQ_CNT; ++from) {
+			for (Bitboard bb = getKingMoves(from); bb; )
+				t.king[popFirstSquare(bb)] |= squareBit(from);
+			for (Bitboard bb = getKnightMoves(from); bb; )
+				t.knight[popFirstSquare(bb)] |= squareBit(from);
+			for (auto c : { Colour::WHITE, Colour::BLACK })
+				for (Bitboard bb = getPawnPushes(c, from); bb; )
+					t.pawn_pushes[static_cast<int>(c)][popFirstSquare(bb)] |= squareBit(from);
+		}
+		return t;
+	}
+
+	RetroTables const& getRetroTables()
+	{
+		static const RetroTables tables = makeRetroTables();
+		return tables;
+	}
+
+	// Get squares a piece could have come from to land on a square, in
+	// a move that didn't capture anything
+	Bitboard getRetroMoves(Slot const& slot, Square sq, Bitboard occupied)
+	{
+		auto const& t = getRetroTables();
+		switch (slot.id) {
+		case PieceTypeId::PAWN:
+			return t.pawn_pushes[static_cast<int>(slot.colour)][sq] & ~occupied;
+		case PieceTypeId::KING:
+			return t.king[sq] & ~occupied;
+		case PieceTypeId::KNIGHT:
+			return t.knight[sq] & ~occupied;
+		default:
+			// Sliding moves are reversible
+			return getAttacks(slot.id, slot.colour, sq, occupied) & ~occupied;
+		}
+	}
+
+	// Get pieces left after a capture and a promotion (-1 for none)
+	vector<Slot> getChildSlots(vector<Slot> const& slots, int captured,
+	                           int promoted, size_t promotion)
+	{
+		vector<Slot> child;
+		for (size_t i = 0; i < slots.size(); ++i) {
+			auto slot = slots[i];
+			if (static_cast<int>(i) == captured)
+				continue;
+			if (static_cast<int>(i) == promoted)
+				slot.id = promotions[promotion];
+			child.push_back(slot);
+		}
+		return child;
+	}
+
+	// Call function for every table reached by a capture, a promotion
+	// or both, with the slots of the captured and promoted pieces
+	template<class F>
+	void forEachChild(vector<Slot> const& slots, F&& fn)
+	{
+		int const count = static_cast<int>(slots.size());
+		for (int captured = -1; captured < count; ++captured) {
+			if (captured >= 0 && slots[captured].id == PieceTypeId::KING)
+				continue;
+			for (int promoted = -1; promoted < count; ++promoted) {
+				if (promoted == captured || (promoted < 0 && captured < 0) ||
+				    (promoted >= 0 && slots[promoted].id != PieceTypeId::PAWN))
+					continue;
+				for (size_t p = 0; p < (promoted < 0 ? 1 : promotion_cnt); ++p)
+					fn(captured, promoted, p, getChildSlots(slots, captured, promoted, p));
+			}
+		}
+	}
+
+	filesystem::path getTablePath(filesystem::path const& directory,
+	                              vector<Slot> const& slots)
+	{
+		return directory / (getMaterialName(slots) + ".ctb");
+	}
+
+	// Run function over [0, count) in chunks, on several threads
+	void runParallel(uint64_t count, unsigned int threads,
+	                 function<void(uint64_t, uint64_t, unsigned int)> const& fn)
+	{
+		atomic<uint64_t> next(0);
+		uint64_t const chunk = max<uint64_t>(1, min<uint64_t>(1 << 14, count / (threads * 16)));
+		auto work = [&] (unsigned int worker) {
+			while (true) {
+				auto begin = next.fetch_add(chunk);
+				if (begin >= count)
+					break;
+				fn(begin, min(count, begin + chunk), worker);
+			}
+		};
+		vector<thread> pool;
+		for (unsigned int worker = 1; worker < threads; ++worker)
+			pool.emplace_back(work, worker);
+		work(0);
+		for (auto& t : pool)
+			t.join();
+	}
+}
+
+namespace chesslib
+{
+	// Table file mapped into memory. Values are split into blocks, each
+	// stored as the offsets from the smallest value in the block, packed
+	// with as many bits as the largest offset needs. Blocks where all
+	// positions have the same value (or cannot occur) take no space.
+	class TablebaseFile
+	{
+	public:
+		TablebaseFile() = default;
+
+		// Map table file and check its header
+		// Returns true on success
+		bool open(filesystem::path const& path)
+		{
+			if (!m_file.open(path))
+				return false;
+			if (!readHeader()) {
+				m_file.close();
+				return false;
+			}
+			return true;
+		}
+
+		TableLayout const& getLayout() const { return m_layout; }
+
+		string getMaterialName() const { return ::getMaterialName(m_layout.getSlots()); }
+
+		// Get value stored for a position index
+		uint16_t getValue(uint64_t index) const
+		{
+			auto const* block = m_blocks + (index / entries_per_block) * file_block_size;
+			auto const offset = getLittleEndian(block, 8);
+			auto const base = static_cast<uint16_t>(getLittleEndian(block + 8, 2));
+			auto const width = block[10];
+			if (width == 0)
+				return base;
+			auto const bit = offset + (index % entries_per_block) * width;
+			auto const word = getLittleEndian(m_data + bit / 8, 4);
+			return static_cast<uint16_t>(base + ((word >> (bit % 8)) & ((1u << width) - 1)));
+		}
+
+		// Get value of a valid position of any table with the same pieces
+		uint16_t getValue(TableLayout const& layout, Position const& pos,
+		                  int promoted, PieceTypeId promotion) const
+		{
+			Position mine;
+			mine.turn = pos.turn;
+			bool used[tablebase_max_pieces] = {};
+			for (size_t i = 0; i < m_layout.getPieceCount(); ++i) {
+				auto const& slot = m_layout.getSlot(i);
+				for (size_t j = 0; j < layout.getPieceCount(); ++j) {
+					auto id = static_cast<int>(j) == promoted ? promotion : layout.getSlot(j).id;
+					if (!used[j] && pos.squares[j] != SQ_CNT &&
+					    id == slot.id && layout.getSlot(j).colour == slot.colour) {
+						used[j] = true;
+						mine.squares[i] = pos.squares[j];
+						break;
+					}
+				}
+			}
+			return getValue(m_layout.getIndex(mine));
+		}
+
+		// Write values to a table file
+		// Returns true on success
+		static bool write(filesystem::path const& path, TableLayout const& layout,
+		                  vector<atomic<uint16_t>> const& values)
+		{
+			auto const block_cnt = (layout.size() + entries_per_block - 1) / entries_per_block;
+			vector<unsigned char> header, blocks, data;
+
+			header.insert(header.end(), begin(file_magic), end(file_magic));
+			putLittleEndian(header, file_version, 4);
+			putLittleEndian(header, layout.getPieceCount(), 1);
+			putLittleEndian(header, static_cast<uint8_t>(layout.getSymmetry()), 1);
+			putLittleEndian(header, 0, 2);
+			for (size_t i = 0; i < 8; ++i) {
+				uint8_t packed = 0;
+				if (i < layout.getPieceCount()) {
+					auto const& slot = layout.getSlot(i);
+					packed = static_cast<uint8_t>(static_cast<int>(slot.id) |
+					                              static_cast<int>(slot.colour) << 3);
+				}
+				putLittleEndian(header, packed, 1);
+			}
+			putLittleEndian(header, entries_per_block, 4);
+			putLittleEndian(header, layout.size(), 8);
+			putLittleEndian(header, block_cnt, 8);
+			assert(header.size() == file_header_size);
+
+			uint64_t bit = 0, pending = 0;
+			int pending_bits = 0;
+			for (uint64_t block = 0; block < block_cnt; ++block) {
+				auto const first = block * entries_per_block;
+				auto const last = min<uint64_t>(first + entries_per_block, layout.size());
+
+				uint16_t lo = UINT16_MAX, hi = 0;
+				for (auto i = first; i < last; ++i) {
+					auto value = values[i].load(memory_order_relaxed);
+					if (value == value_invalid)
+						continue;
+					lo = min(lo, value);
+					hi = max(hi, value);
+				}
+				if (lo > hi)
+					lo = hi = value_draw;
+				int width = 0;
+				while ((hi - lo) >> width)
+					++width;
+
+				putLittleEndian(blocks, bit, 8);
+				putLittleEndian(blocks, lo, 2);
+				putLittleEndian(blocks, width, 1);
+				putLittleEndian(blocks, 0, 5);
+				if (width == 0)
+					continue;
+
+				for (auto i = first; i < last; ++i) {
+					auto value = values[i].load(memory_order_relaxed);
+					if (value == value_invalid)
+						value = lo;
+					pending |= static_cast<uint64_t>(value - lo) << pending_bits;
+					pending_bits += width;
+					bit += width;
+					while (pending_bits >= 8) {
+						data.push_back(static_cast<unsigned char>(pending));
+						pending >>= 8;
+						pending_bits -= 8;
+					}
+				}
+			}
+			if (pending_bits > 0)
+				data.push_back(static_cast<unsigned char>(pending));
+			data.insert(data.end(), file_padding, 0);
+
+			// Write to a temporary file first, so that a table is either
+			// complete or not there at all
+			auto temp = path;
+			temp += ".tmp";
+			{
+				ofstream out(temp, ios::binary | ios::trunc);
+				out.write(reinterpret_cast<char const*>(header.data()), header.size());
+				out.write(reinterpret_cast<char const*>(blocks.data()), blocks.size());
+				out.write(reinterpret_cast<char const*>(data.data()), data.size());
+				if (!out)
+					return false;
+			}
+			error_code ec;
+			filesystem::rename(temp, path, ec);
+			return !ec;
+		}
+	private:
+		bool readHeader()
+		{
+			auto const* in = m_file.data();
+			auto const size = m_file.size();
+			if (size < file_header_size ||
+			    !equal(begin(file_magic), end(file_magic), in) ||
+			    getLittleEndian(in + 4, 4) != file_version)
+				return false;
+
+			auto const count = in[8];
+			auto const symmetry = static_cast<Symmetry>(in[9]);
+			if (count < 2 || count > tablebase_max_pieces || symmetry >= Symmetry::MAX)
+				return false;
+
+			vector<Slot> slots;
+			for (size_t i = 0; i < count; ++i) {
+				auto id = static_cast<PieceTypeId>(in[12 + i] & 0b111);
+				auto colour = static_cast<Colour>(in[12 + i] >> 3);
+				if (id == PieceTypeId::NONE || !PieceTypeIdCheck(id) || !ColourCheck(colour))
+					return false;
+				slots.push_back(Slot{ id, colour });
+			}
+			vector<Slot> parsed;
+			if (!parseMaterial(::getMaterialName(slots), parsed) ||
+			    !equal(slots.begin(), slots.end(), parsed.begin(), parsed.end()))
+				return false;
+
+			m_layout = TableLayout(slots, symmetry);
+			auto const block_cnt = getLittleEndian(in + 32, 8);
+			if (getLittleEndian(in + 20, 4) != entries_per_block ||
+			    getLittleEndian(in + 24, 8) != m_layout.size() ||
+			    block_cnt != (m_layout.size() + entries_per_block - 1) / entries_per_block ||
+			    (size - file_header_size) / file_block_size < block_cnt)
+				return false;
+
+			m_blocks = in + file_header_size;
+			m_data = m_blocks + block_cnt * file_block_size;
+			auto const data_size = size - (m_data - in);
+			if (data_size < file_padding)
+				return false;
+
+			// Every block must lie within the data
+			for (uint64_t block = 0; block < block_cnt; ++block) {
+				auto const* b = m_blocks + block * file_block_size;
+				auto entries = min<uint64_t>(entries_per_block,
+				                             m_layout.size() - block * entries_per_block);
+				auto end = getLittleEndian(b, 8) + entries * b[10];
+				if (b[10] > 16 || end > (data_size - file_padding) * 8)
+					return false;
+			}
+			return true;
+		}
+	private:
+		MappedFile m_file;
+		TableLayout m_layout;
+		unsigned char const* m_blocks = nullptr;
+		unsigned char const* m_data = nullptr;
+	};
+
+	// Solves every position of a table by retrograde analysis. Positions
+	// are solved by distance to mate, level by level: the mates first,
+	// then the positions where the player to move can mate at once, and
+	// so on. The predecessors of the positions solved at each level (the
+	// positions they can be reached from) are the only candidates for the
+	// next one, and are found by taking moves back. Positions that are
+	// left unsolved in the end are draws.
+	class TablebaseGenerator
+	{
+	public:
+		TablebaseGenerator(vector<Slot> const& slots, unsigned int threads,
+		                   ostream* log) :
+			m_layout(slots, getSymmetry(slots)),
+			m_values(m_layout.size()),
+			m_threads(threads),
+			m_log(log)
+		{}
+
+		// Open the tables of the positions reached by captures and
+		// promotions, which must be in the directory
+		// Returns true on success
+		bool link(filesystem::path const& directory)
+		{
+			bool ok = true;
+			forEachChild(m_layout.getSlots(), [&] (int captured, int promoted, size_t promotion,
+			                                      vector<Slot> const& child) {
+				auto const* table = m_tablebase.find(getMaterialName(child));
+				if (!table && m_tablebase.open(getTablePath(directory, child)))
+					table = m_tablebase.find(getMaterialName(child));
+				m_children[captured + 1][promoted + 1][promotion] = table;
+				ok = ok && table;
+			});
+			return ok;
+		}
+
+		// Solve every position
+		void run()
+		{
+			auto const start = chrono::steady_clock::now();
+			if (m_log)
+				*m_log << getMaterialName(m_layout.getSlots()) << ": "
+				       << m_layout.size() << " positions" << endl;
+
+			m_workers.assign(m_threads, Worker());
+			runParallel(m_layout.size(), m_threads,
+			            [this] (uint64_t begin, uint64_t end, unsigned int worker) {
+				for (auto index = begin; index < end; ++index)
+					initialize(index, m_workers[worker]);
+			});
+			collect();
+
+			for (unsigned int level = 0;
+			     level < m_ready.size() || level < m_pending.size(); ++level) {
+				vector<uint64_t> frontier;
+				if (level < m_ready.size())
+					frontier.swap(m_ready[level]);
+				if (level < m_pending.size()) {
+					uint16_t const value = value_mate + level;
+					for (auto index : m_pending[level]) {
+						auto expected = value_unknown;
+						if (m_values[index].compare_exchange_strong(expected, value))
+							frontier.push_back(index);
+					}
+					vector<uint64_t>().swap(m_pending[level]);
+				}
+				runParallel(frontier.size(), m_threads,
+				            [&] (uint64_t begin, uint64_t end, unsigned int worker) {
+					for (auto i = begin; i < end; ++i)
+						retract(frontier[i], level, m_workers[worker]);
+				});
+				collect();
+			}
+
+			uint64_t counts[3] = {};
+			unsigned int longest = 0;
+			for (auto& value : m_values) {
+				auto v = value.load(memory_order_relaxed);
+				if (v == value_unknown)
+					value.store(v = value_draw, memory_order_relaxed);
+				if (v == value_draw)
+					++counts[static_cast<int>(Outcome::DRAW)];
+				else if (isWin(v))
+					++counts[static_cast<int>(Outcome::WIN)];
+				else if (isLoss(v))
+					++counts[static_cast<int>(Outcome::LOSS)];
+				if (v >= value_mate)
+					longest = max(longest, getDtm(v));
+			}
+
+			if (m_log) {
+				auto const elapsed = chrono::duration<double>(chrono::steady_clock::now() - start);
+				*m_log << "  " << counts[static_cast<int>(Outcome::WIN)] << " wins, "
+				       << counts[static_cast<int>(Outcome::DRAW)] << " draws, "
+				       << counts[static_cast<int>(Outcome::LOSS)] << " losses, "
+				       << "longest mate in " << longest << " plies ("
+				       << elapsed.count() << " s)" << endl;
+			}
+		}
+
+		// Write solved table to file
+		// Returns true on success
+		bool write(filesystem::path const& path) const
+		{
+			return TablebaseFile::write(path, m_layout, m_values);
+		}
+	private:
+		// Positions found by a thread, by distance to mate
+		struct Worker
+		{
+			vector<vector<uint64_t>> ready; // already stored
+			vector<vector<uint64_t>> pending; // unless solved earlier
+
+			static void add(vector<vector<uint64_t>>& lists, unsigned int level, uint64_t index)
+			{
+				if (lists.size() <= level)
+					lists.resize(level + 1);
+				lists[level].push_back(index);
+			}
+		};
+
+		// Move the positions found by every thread to the shared lists
+		void collect()
+		{
+			auto merge = [] (vector<vector<uint64_t>>& from, vector<vector<uint64_t>>& to) {
+				if (to.size() < from.size())
+					to.resize(from.size());
+				for (size_t level = 0; level < from.size(); ++level)
+					to[level].insert(to[level].end(), from[level].begin(), from[level].end());
+				from.clear();
+			};
+			for (auto& worker : m_workers) {
+				merge(worker.ready, m_ready);
+				merge(worker.pending, m_pending);
+			}
+		}
+
+		uint16_t getChildValue(TableMove const& move) const
+		{
+			auto const* table = m_children[move.captured + 1][move.promoted + 1][move.promotion];
+			auto const promotion = move.promoted < 0 ? PieceTypeId::NONE : promotions[move.promotion];
+			return table->getValue(m_layout, move.next, move.promoted, promotion);
+		}
+
+		bool isChildMove(TableMove const& move) const
+		{
+			return move.captured >= 0 || move.promoted >= 0;
+		}
+
+		// Store what is known of a position before any other is solved:
+		// whether it can occur, whether it is mate or stalemate, and the
+		// best the player to move can do by leaving the table
+		void initialize(uint64_t index, Worker& worker)
+		{
+			auto const pos = m_layout.getPosition(index);
+			// Positions that have a smaller index are skipped, as well
+			if (m_layout.getIndex(pos) != index || !isValidPosition(m_layout, pos)) {
+				m_values[index].store(value_invalid, memory_order_relaxed);
+				return;
+			}
+
+			bool any = false, inside = false, draw = false;
+			unsigned int win = UINT_MAX, loss = 0;
+			forEachMove(m_layout, pos, [&] (TableMove const& move) {
+				any = true;
+				if (!isChildMove(move)) {
+					inside = true;
+					return;
+				}
+				auto value = getChildValue(move);
+				if (isLoss(value))
+					win = min(win, getDtm(value) + 1);
+				else if (isWin(value))
+					loss = max(loss, getDtm(value) + 1);
+				else
+					draw = true;
+			});
+
+			auto value = value_unknown;
+			if (!any) {
+				if (isInCheck(m_layout, pos)) {
+					value = value_mate;
+					Worker::add(worker.ready, 0, index);
+				} else {
+					value = value_draw;
+				}
+			} else if (win != UINT_MAX) {
+				// Moves inside the table might mate sooner
+				Worker::add(worker.pending, win, index);
+			} else if (!inside) {
+				if (draw)
+					value = value_draw;
+				else
+					Worker::add(worker.pending, loss, index);
+			}
+			m_values[index].store(value, memory_order_relaxed);
+		}
+
+		// Check whether every move of the player to move loses, in which
+		// case the distance to mate is returned (0 otherwise)
+		unsigned int getLossDistance(Position const& pos) const
+		{
+			unsigned int longest = 0;
+			bool lost = true;
+			forEachMove(m_layout, pos, [&] (TableMove const& move) {
+				if (!lost)
+					return;
+				auto value = isChildMove(move) ? getChildValue(move) :
+					m_values[m_layout.getIndex(move.next)].load(memory_order_relaxed);
+				if (isWin(value))
+					longest = max(longest, getDtm(value));
+				else
+					lost = false;
+			});
+			return lost ? longest + 1 : 0;
+		}
+
+		// Solve the positions that lead to a position solved at the level
+		void retract(uint64_t index, unsigned int level, Worker& worker)
+		{
+			auto const pos = m_layout.getPosition(index);
+			auto const mover = getOpponent(pos.turn);
+			auto const occupied = getOccupancy(m_layout, pos, Colour::WHITE) |
+			                      getOccupancy(m_layout, pos, Colour::BLACK);
+
+			for (size_t i = 0; i < m_layout.getPieceCount(); ++i) {
+				auto const& slot = m_layout.getSlot(i);
+				if (slot.colour != mover)
+					continue;
+				for (auto origins = getRetroMoves(slot, pos.squares[i], occupied); origins; ) {
+					auto prev = pos;
+					prev.squares[i] = popFirstSquare(origins);
+					prev.turn = mover;
+					if (!isValidPosition(m_layout, prev))
+						continue;
+					auto const prev_index = m_layout.getIndex(prev);
+					auto& value = m_values[prev_index];
+					if (value.load(memory_order_relaxed) != value_unknown)
+						continue;
+
+					unsigned int distance;
+					if (level % 2 == 0) {
+						// Moving to a lost position wins
+						distance = level + 1;
+					} else {
+						// Moving to a won position loses, if all other moves do
+						distance = getLossDistance(prev);
+						if (distance == 0)
+							continue;
+					}
+
+					auto expected = value_unknown;
+					if (value.compare_exchange_strong(expected, static_cast<uint16_t>(value_mate + distance)))
+						Worker::add(worker.ready, distance, prev_index);
+				}
+			}
+		}
+	private:
+		TableLayout m_layout;
+		vector<atomic<uint16_t>> m_values;
+		unsigned int m_threads;
+		ostream* m_log;
+		Tablebase m_tablebase; // tables of m_children
+		TablebaseFile const* m_children[tablebase_max_pieces + 1][tablebase_max_pieces + 1][promotion_cnt] = {};
+		vector<Worker> m_workers;
+		vector<vector<uint64_t>> m_ready;
+		vector<vector<uint64_t>> m_pending;
+	};
+}
+
+// Generate table and the tables it depends on, unless they exist
+static bool generateTable(vector<Slot> const& slots,
+                          filesystem::path const& directory,
+                          unsigned int threads, ostream* log)
+{
+	auto const path = getTablePath(directory, slots);
+	if (filesystem::exists(path))
+		return true;
+
+	bool ok = true;
+	forEachChild(slots, [&] (int, int, size_t, vector<Slot> const& child) {
+		ok = ok && generateTable(child, directory, threads, log);
+	});
+	if (!ok)
+		return false;
+
+	TablebaseGenerator generator(slots, threads, log);
+	if (!generator.link(directory))
+		return false;
+	generator.run();
+	return generator.write(path);
+}
+
+bool chesslib::generateTablebase(string const& material,
+                                 filesystem::path const& directory,
+                                 unsigned int threads, ostream* log)
+{
+	vector<Slot> slots;
+	if (!parseMaterial(material, slots)) {
+		if (log)
+			*log << material << ": invalid material" << endl;
+		return false;
+	}
+
+	// After a double push, the opponent could take the pawn en passant,
+	// and tables have no room for that
+	bool const pawns[] = {
+		find(slots.begin(), slots.end(), Slot{ PieceTypeId::PAWN, Colour::WHITE }) != slots.end(),
+		find(slots.begin(), slots.end(), Slot{ PieceTypeId::PAWN, Colour::BLACK }) != slots.end(),
+	};
+	if (pawns[0] && pawns[1]) {
+		if (log)
+			*log << material << ": pawns on both sides are not supported" << endl;
+		return false;
+	}
+
+	if (threads == 0)
+		threads = max(1u, thread::hardware_concurrency());
+
+	error_code ec;
+	filesystem::create_directories(directory, ec);
+	if (ec)
+		return false;
+
+	return generateTable(slots, directory, threads, log);
+}
+
+Tablebase::Tablebase() = default;
+
+Tablebase::~Tablebase() = default;
+
+bool Tablebase::load(filesystem::path const& directory)
+{
+	error_code ec;
+	bool ok = true;
+	for (auto const& entry : filesystem::directory_iterator(directory, ec))
+		if (entry.path().extension() == ".ctb")
+			ok = open(entry.path()) && ok;
+	return ok && !ec;
+}
+
+bool Tablebase::open(filesystem::path const& path)
+{
+	auto table = make_unique<TablebaseFile>();
+	if (!table->open(path))
+		return false;
+	auto name = table->getMaterialName();
+	m_tables[name] = move(table);
+	return true;
+}
+
+void Tablebase::close()
+{
+	m_tables.clear();
+}
+
+size_t Tablebase::size() const
+{
+	return m_tables.size();
+}
+
+TablebaseFile const* Tablebase::find(string const& material) const
+{
+	auto it = m_tables.find(material);
+	return it == m_tables.end() ? nullptr : it->second.get();
+}
+
+optional<TablebaseResult> Tablebase::probe(GameState const& state) const
+{
+	vector<Slot> slots;
+	vector<Square> squares;
+	for (Square sq = SQ_A1; sq < SQ_CNT; ++sq) {
+		auto const& piece = state.getPieceAt(sq);
+		if (piece.isClear())
+			continue;
+		if (slots.size() == tablebase_max_pieces)
+			return nullopt;
+		slots.push_back(Slot{ piece.getType()->getId(), piece.getColour() });
+		squares.push_back(sq);
+	}
+
+	// Castling is possible while a king and a rook have never moved
+	static const Square castlings[][3] = {
+		{ SQ_E1, SQ_A1, SQ_H1 },
+		{ SQ_E8, SQ_A8, SQ_H8 },
+	};
+	for (auto const& castling : castlings) {
+		auto const& king = state.getPieceAt(castling[0]);
+		if (king.getType()->getId() != PieceTypeId::KING ||
+		    state.wasSquareAltered(castling[0]))
+			continue;
+		for (auto rook : { castling[1], castling[2] }) {
+			auto const& piece = state.getPieceAt(rook);
+			if (piece.getType()->getId() == PieceTypeId::ROOK &&
+			    piece.getColour() == king.getColour() &&
+			    !state.wasSquareAltered(rook))
+				return nullopt;
+		}
+	}
+
+	// En passant only matters if the player to move has pawns
+	if (state.hasEnPassant() &&
+	    std::find(slots.begin(), slots.end(), Slot{ PieceTypeId::PAWN, state.getTurn() }) != slots.end())
+		return nullopt;
+
+	auto const* table = find(getMaterialName(slots));
+	if (!table)
+		return nullopt;
+
+	auto const& layout = table->getLayout();
+	Position pos;
+	pos.turn = state.getTurn();
+	vector<bool> used(slots.size());
+	for (size_t i = 0; i < layout.getPieceCount(); ++i) {
+		for (size_t j = 0; j < slots.size(); ++j) {
+			if (!used[j] && slots[j] == layout.getSlot(i)) {
+				used[j] = true;
+				pos.squares[i] = squares[j];
+				break;
+			}
+		}
+	}
+	if (!isValidPosition(layout, pos))
+		return nullopt;
+
+	auto const value = table->getValue(layout.getIndex(pos));
+	if (value < value_mate)
+		return TablebaseResult{ Outcome::DRAW, 0 };
+	return TablebaseResult{ isWin(value) ? Outcome::WIN : Outcome::LOSS, getDtm(value) };
+}
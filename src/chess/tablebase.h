@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef> // std::size_t
+#include <filesystem> // std::filesystem::path
+#include <iosfwd> // std::ostream
+#include <map> // std::map
+#include <memory> // std::unique_ptr
+#include <optional> // std::optional
+#include <string> // std::string
+
+namespace chesslib
+{
+
+	class GameState;
+	class TablebaseFile;
+	class TablebaseGenerator;
+
+	// Maximum number of pieces in a table, kings included
+	constexpr std::size_t tablebase_max_pieces = 5;
+
+	// Outcome of a position for the player whose turn it is
+	enum class Outcome
+	{
+		LOSS,
+		DRAW,
+		WIN,
+		MAX
+	};
+
+	// What a table knows about a position
+	struct TablebaseResult
+	{
+		Outcome outcome;
+		unsigned int dtm; // plies until checkmate (0 for draws)
+	};
+
+	// Generate the table of a material signature, such as "KQvK" (white
+	// pieces, then 'v', then black pieces), into the directory, along with
+	// the tables it depends on (the ones reached by captures and promotions)
+	// that are not there yet. Tables are generated by retrograde analysis,
+	// in parallel by the given number of threads (0 for one per core).
+	// Progress is written to the log, if any.
+	// Returns true on success
+	bool generateTablebase(std::string const& material,
+	                       std::filesystem::path const& directory,
+	                       unsigned int threads = 0,
+	                       std::ostream* log = nullptr);
+
+	// Endgame tablebase: the outcome and distance to mate of every position
+	// with few pieces, under the rules implemented by GameController.
+	// Tables are memory mapped, so loading them is immediate and probing
+	// only touches the few bytes of the position that is looked up.
+	//
+	// Tables do not account for castling, which is why positions where it
+	// could still happen are not found, nor for the fifty-move rule and
+	// repetitions, which might draw some games before the mate is given.
+	class Tablebase
+	{
+	public:
+		// Create an empty tablebase
+		Tablebase();
+
+		// Unmap all tables
+		~Tablebase();
+
+		// A tablebase cannot be copied
+		Tablebase(Tablebase const&) = delete;
+		Tablebase& operator=(Tablebase const&) = delete;
+
+		// Map every table file in the directory
+		// Returns true if all tables were valid
+		bool load(std::filesystem::path const& directory);
+
+		// Map a single table file
+		// Returns true on success
+		bool open(std::filesystem::path const& path);
+
+		// Unmap all tables
+		void close();
+
+		// Get number of tables
+		std::size_t size() const;
+
+		// Look up game state
+		// Returns nullopt if there is no table for it
+		std::optional<TablebaseResult> probe(GameState const& state) const;
+	private:
+		friend class TablebaseGenerator;
+
+		// Get table of a material signature (nullptr if there is none)
+		TablebaseFile const* find(std::string const& material) const;
+	private:
+		std::map<std::string, std::unique_ptr<TablebaseFile>> m_tables;
+	};
+
+}
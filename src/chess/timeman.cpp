@@ -0,0 +1,138 @@
+#include "timeman.h"
+
+#include <algorithm>
+
+#include "search.h"
+
+using namespace std;
+using namespace chesslib;
+
+using chrono::milliseconds;
+
+// Moves the rest of the game is assumed to last, when it is not known
+static const unsigned int default_moves_to_go = 40;
+
+// Time kept on the clock, for what is spent outside of the search
+static const milliseconds max_reserve(50);
+
+// Drop of the score, in centipawns, that counts as failing low
+static const int fail_low_margin = 30;
+
+TimeManager::TimeManager() :
+	m_optimum(0),
+	m_hard(0),
+	m_next_check(0),
+	m_best_move(0),
+	m_score(0),
+	m_stability(0),
+	m_failed_low(false),
+	m_failing_low(false),
+	m_limited(false),
+	m_fixed(false),
+	m_pondering(false)
+{}
+
+void TimeManager::start(SearchLimits const& limits)
+{
+	m_start = chrono::steady_clock::now();
+	m_clock = m_start;
+	m_next_check = check_interval;
+	m_best_move = 0;
+	m_score = 0;
+	m_stability = 0;
+	m_failed_low = false;
+	m_failing_low = false;
+	m_pondering = limits.ponder;
+	m_fixed = limits.time.count() > 0;
+	m_limited = m_fixed || limits.remaining.count() > 0;
+
+	if (m_fixed) {
+		m_optimum = m_hard = limits.time;
+		return;
+	}
+	if (!m_limited) {
+		m_optimum = m_hard = milliseconds(0);
+		return;
+	}
+
+	// The time left is shared evenly by the moves to go, along with most
+	// of the increments they bring, but a single move may take several
+	// times its share if the search asks for it
+	auto const reserve = min(max_reserve, limits.remaining / 10);
+	auto const available = limits.remaining - reserve;
+	auto const moves_to_go = limits.moves_to_go ?
+		min(limits.moves_to_go, default_moves_to_go) : default_moves_to_go;
+	m_optimum = available / moves_to_go + limits.increment * 3 / 4;
+	m_hard = min(available, m_optimum * 5);
+	m_optimum = min(m_optimum, m_hard);
+}
+
+void TimeManager::onPonderHit(uint64_t nodes)
+{
+	m_clock = chrono::steady_clock::now();
+	m_next_check = nodes + check_interval;
+	m_pondering = false;
+}
+
+void TimeManager::onIteration(uint16_t best_move, int score)
+{
+	if (best_move == m_best_move)
+		++m_stability;
+	else
+		m_stability = 0;
+
+	// A score well below that of the previous iteration means the best
+	// event was refuted, even if it is still the best one
+	m_failed_low = m_failing_low ||
+		(m_best_move != 0 && score <= m_score - fail_low_margin);
+	m_failing_low = false;
+	m_best_move = best_move;
+	m_score = score;
+}
+
+void TimeManager::onFailLow()
+{
+	// The deadline is pushed back right away, as the iteration going on
+	// is the one that needs the time
+	m_failed_low = true;
+	m_failing_low = true;
+}
+
+bool TimeManager::canStartIteration() const
+{
+	if (!m_limited || m_pondering)
+		return true;
+	// Each iteration takes about twice as long as the previous one, so
+	// an iteration started past about half of the deadline rarely ends
+	// before it
+	auto const elapsed = getElapsed();
+	if (m_fixed)
+		return elapsed < m_hard;
+	return elapsed < getSoftDeadline() / 2;
+}
+
+milliseconds TimeManager::getElapsed() const
+{
+	return chrono::duration_cast<milliseconds>(chrono::steady_clock::now() - m_start);
+}
+
+milliseconds TimeManager::getSoftDeadline() const
+{
+	if (m_fixed)
+		return m_hard;
+
+	// A stable best event needs less time, one that failed low more
+	auto soft = m_optimum;
+	if (m_stability >= 4)
+		soft = soft / 2;
+	else if (m_stability >= 2)
+		soft = soft * 3 / 4;
+	if (m_failed_low)
+		soft = soft * 2;
+	return min(soft, m_hard);
+}
+
+milliseconds TimeManager::getHardDeadline() const
+{
+	return m_hard;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono> // std::chrono
+#include <cstdint> // std::uint16_t, std::uint64_t
+
+namespace chesslib
+{
+
+	struct SearchLimits;
+
+	// Decides how long a search may go on, from the clock of the player
+	// to move. Two deadlines are worked out when the search starts: the
+	// soft one, which the search aims at and which is only looked at
+	// between iterations, and the hard one, at which the search is cut
+	// short wherever it is. The soft deadline moves while searching:
+	// it is pushed back when the score drops (the best event failed
+	// low, and a better one may be found with more time) and brought
+	// forward when the best event stays the same iteration after
+	// iteration. A search that ponders has no deadline until the
+	// opponent plays the expected event, when its clock starts: the
+	// hard deadline counts from then, but the soft one from the start
+	// of the search, as the iterations searched while pondering need
+	// not be searched again.
+	//
+	// The hard deadline is checked at every node, but the clock itself
+	// is only read every so many nodes, which costs next to nothing.
+	class TimeManager
+	{
+	public:
+		// Nodes searched between two reads of the clock
+		static constexpr std::uint64_t check_interval = 1024;
+
+		// Create manager of a search without time limits
+		TimeManager();
+
+		// Start the clock of a search, working out its deadlines
+		void start(SearchLimits const& limits);
+
+		// Check whether the search must stop at once, given the number
+		// of nodes searched so far
+		bool isTimeUp(std::uint64_t nodes)
+		{
+			if (nodes < m_next_check)
+				return false;
+			m_next_check = nodes + check_interval;
+			return m_limited && !m_pondering &&
+				std::chrono::steady_clock::now() - m_clock >= m_hard;
+		}
+
+		// Tell that the search was pondering and that the opponent played
+		// the expected event, so the clock starts now, given the number
+		// of nodes searched so far
+		void onPonderHit(std::uint64_t nodes);
+
+		// Tell that an iteration completed, with its best event and its
+		// score, which tells whether the best event is stable
+		void onIteration(std::uint16_t best_move, int score);
+
+		// Tell that the score of the best event dropped below what was
+		// expected, so the search needs more time
+		void onFailLow();
+
+		// Check whether another iteration is worth starting, that is,
+		// whether it has any chance to complete before the soft deadline
+		bool canStartIteration() const;
+
+		// Get time since the search started, pondering included
+		std::chrono::milliseconds getElapsed() const;
+
+		// Get time the search aims at, as of now
+		std::chrono::milliseconds getSoftDeadline() const;
+
+		// Get time at which the search is cut short
+		std::chrono::milliseconds getHardDeadline() const;
+	private:
+		std::chrono::steady_clock::time_point m_start;
+		std::chrono::steady_clock::time_point m_clock; // when the clock started
+		std::chrono::milliseconds m_optimum; // soft deadline of an average move
+		std::chrono::milliseconds m_hard;
+		std::uint64_t m_next_check; // nodes at which the clock is read next
+		std::uint16_t m_best_move; // of the last iteration
+		int m_score; // of the last iteration
+		unsigned int m_stability; // iterations with the same best event
+		bool m_failed_low; // in the last iteration
+		bool m_failing_low; // in the iteration going on
+		bool m_limited; // whether there is a deadline at all
+		bool m_fixed; // whether the time of the move is given as is
+		bool m_pondering; // whether the clock has not started yet
+	};
+
+}
@@ -0,0 +1,192 @@
+#include "trace.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+using namespace chesslib;
+
+// Number of spans kept per thread
+static const size_t ring_size = 1 << 14;
+
+namespace
+{
+	// Fields are atomic only so that writeTrace may read them while the
+	// owning thread is recording; it is the only one to write them
+	struct SpanSlot
+	{
+		atomic<char const*> name;
+		atomic<int64_t> start; // in nanoseconds since the trace epoch
+		atomic<int64_t> duration; // in nanoseconds
+	};
+
+	struct RingBuffer
+	{
+		array<SpanSlot, ring_size> slots;
+		atomic<uint64_t> head{ 0 }; // number of spans ever recorded
+		atomic<uint64_t> tail{ 0 }; // where the trace was last cleared
+		atomic<char const*> thread_name{ nullptr };
+		unsigned int tid;
+	};
+
+	// Ring buffers of all threads, kept after threads finish so that
+	// their spans can still be written
+	struct Registry
+	{
+		mutex lock;
+		vector<unique_ptr<RingBuffer>> buffers;
+	};
+
+	// Never destroyed, as threads may finish after static destruction
+	Registry& getRegistry()
+	{
+		static auto* registry = new Registry;
+		return *registry;
+	}
+
+	chrono::steady_clock::time_point getEpoch()
+	{
+		static const auto epoch = chrono::steady_clock::now();
+		return epoch;
+	}
+
+	int64_t getNanoseconds(chrono::steady_clock::duration d)
+	{
+		return chrono::duration_cast<chrono::nanoseconds>(d).count();
+	}
+
+	RingBuffer& getThreadBuffer()
+	{
+		thread_local RingBuffer* buffer = [] {
+			auto& registry = getRegistry();
+			lock_guard<mutex> guard(registry.lock);
+			registry.buffers.push_back(make_unique<RingBuffer>());
+			auto* b = registry.buffers.back().get();
+			b->tid = static_cast<unsigned int>(registry.buffers.size());
+			return b;
+		}();
+		return *buffer;
+	}
+
+	void writeString(ostream& os, char const* s)
+	{
+		os << '"';
+		for (; *s; ++s) {
+			if (*s == '"' || *s == '\\')
+				os << '\\';
+			os << *s;
+		}
+		os << '"';
+	}
+
+	// Write time in microseconds, as Chrome expects
+	void writeTime(ostream& os, int64_t ns)
+	{
+		os << ns / 1000 << '.' << setw(3) << setfill('0') << ns % 1000
+		   << setfill(' ');
+	}
+}
+
+TraceSpan::TraceSpan(char const* name) :
+	m_name(name)
+{
+	// The epoch is set on first use, which must not be after the start
+	getEpoch();
+	m_start = chrono::steady_clock::now();
+}
+
+TraceSpan::~TraceSpan()
+{
+	auto const end = chrono::steady_clock::now();
+	auto& buffer = getThreadBuffer();
+	auto const head = buffer.head.load(memory_order_relaxed);
+	auto& slot = buffer.slots[head % ring_size];
+	slot.name.store(m_name, memory_order_relaxed);
+	slot.start.store(getNanoseconds(m_start - getEpoch()), memory_order_relaxed);
+	slot.duration.store(getNanoseconds(end - m_start), memory_order_relaxed);
+	buffer.head.store(head + 1, memory_order_release);
+}
+
+#if defined(CHESS_TRACING)
+void chesslib::setTraceThreadName(char const* name)
+{
+	getThreadBuffer().thread_name.store(name, memory_order_relaxed);
+}
+#endif
+
+void chesslib::writeTrace(ostream& os)
+{
+	auto& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+
+	os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	auto separate = [&] {
+		if (!first)
+			os << ',';
+		os << '\n';
+		first = false;
+	};
+
+	for (auto const& buffer : registry.buffers) {
+		if (auto const* name = buffer->thread_name.load(memory_order_relaxed)) {
+			separate();
+			os << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+			   << buffer->tid << ",\"args\":{\"name\":";
+			writeString(os, name);
+			os << "}}";
+		}
+
+		// Copy spans first, then drop those that the owning thread
+		// might have overwritten in the meantime
+		auto const head = buffer->head.load(memory_order_acquire);
+		auto begin = buffer->tail.load(memory_order_relaxed);
+		if (head - begin > ring_size)
+			begin = head - ring_size;
+		vector<tuple<char const*, int64_t, int64_t>> spans;
+		for (auto i = begin; i < head; ++i) {
+			auto const& slot = buffer->slots[i % ring_size];
+			spans.emplace_back(slot.name.load(memory_order_relaxed),
+			                   slot.start.load(memory_order_relaxed),
+			                   slot.duration.load(memory_order_relaxed));
+		}
+		atomic_thread_fence(memory_order_acquire);
+		// The span being recorded now takes the slot of the oldest one
+		auto const now = buffer->head.load(memory_order_relaxed);
+		auto const valid = now + 1 - begin > ring_size ?
+			now + 1 - begin - ring_size : 0;
+
+		for (size_t i = valid; i < spans.size(); ++i) {
+			auto const& [name, start, duration] = spans[i];
+			separate();
+			os << "{\"ph\":\"X\",\"name\":";
+			writeString(os, name);
+			os << ",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":";
+			writeTime(os, start);
+			os << ",\"dur\":";
+			writeTime(os, duration);
+			os << '}';
+		}
+	}
+
+	os << "\n]}" << endl;
+}
+
+void chesslib::clearTrace()
+{
+	// Spans are never written to by other threads, so clearing
+	// only moves the point from which they are written
+	auto& registry = getRegistry();
+	lock_guard<mutex> guard(registry.lock);
+	for (auto const& buffer : registry.buffers)
+		buffer->tail.store(buffer->head.load(memory_order_acquire),
+		                   memory_order_relaxed);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono> // std::chrono::steady_clock
+#include <iosfwd> // std::ostream
+
+namespace chesslib
+{
+
+#if defined(CHESS_TRACING)
+	constexpr bool tracing_enabled = true;
+#else
+	constexpr bool tracing_enabled = false;
+#endif
+
+	// Span of time spent in a scope, recorded when the scope is left
+	// into a ring buffer of the calling thread, so that tracing takes no
+	// lock and only the most recent spans of each thread are kept.
+	// Names must be string literals (or live as long as the trace does).
+	class TraceSpan
+	{
+	public:
+		explicit TraceSpan(char const* name);
+		~TraceSpan();
+
+		TraceSpan(TraceSpan const&) = delete;
+		TraceSpan& operator=(TraceSpan const&) = delete;
+	private:
+		char const* m_name;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	// Name the calling thread in the trace (nothing at all unless tracing
+	// is compiled in, as naming a thread gives it a ring buffer)
+#if defined(CHESS_TRACING)
+	void setTraceThreadName(char const* name);
+#else
+	inline void setTraceThreadName(char const*) {}
+#endif
+
+	// Write the spans of all threads as Chrome trace event JSON, which
+	// chrome://tracing and Perfetto can open (nothing unless tracing is
+	// compiled in, with CHESS_TRACING)
+	void writeTrace(std::ostream& os);
+
+	// Forget the spans recorded so far
+	void clearTrace();
+
+}
+
+#define CHESS_TRACE_CONCAT_(a, b) a##b
+#define CHESS_TRACE_CONCAT(a, b) CHESS_TRACE_CONCAT_(a, b)
+
+// Trace the rest of the current scope as a span of given name, or do
+// nothing at all if tracing is not compiled in
+#if defined(CHESS_TRACING)
+#define CHESS_TRACE_SCOPE(name) \
+	::chesslib::TraceSpan CHESS_TRACE_CONCAT(chess_trace_span_, __LINE__)(name)
+#else
+#define CHESS_TRACE_SCOPE(name) ((void) 0)
+#endif
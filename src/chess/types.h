@@ -108,6 +108,16 @@ namespace chesslib
 		RUNNING,
 		WHITE_WON,
 		BLACK_WON,
+		DRAW,
+		MAX
+	};
+
+	enum class DrawReason
+	{
+		NONE,
+		STALEMATE,
+		FIFTY_MOVE_RULE,
+		REPETITION,
 		MAX
 	};
 
@@ -266,6 +276,7 @@ namespace chesslib
 	ENABLE_VALIDITY_CHECK(Colour, Colour::MAX)
 	ENABLE_VALIDITY_CHECK(PieceTypeId, PieceTypeId::MAX)
 	ENABLE_VALIDITY_CHECK(Phase, Phase::MAX)
+	ENABLE_VALIDITY_CHECK(DrawReason, DrawReason::MAX)
 
 	ENABLE_MIRROR_OPERATOR_ON(Square, SQ_CNT)
 	ENABLE_MIRROR_OPERATOR_ON(File, FL_CNT)
@@ -273,4 +284,40 @@ namespace chesslib
 
 	ENABLE_COMPARE_OPERATOR_ON(Square)
 
+	// Rules that depend on the colour of a player, as compile-time
+	// constants, so that they can be specialised for each colour
+	template<Colour C>
+	struct ColourTraits;
+
+	template<>
+	struct ColourTraits<Colour::WHITE>
+	{
+		static constexpr Direction forward = DIR_NORTH;
+		static constexpr Rank pawn_rank = RK_2; // pawns can advance two squares
+		static constexpr Rank enpassant_rank = RK_6; // pawns capture en passant
+		static constexpr Rank promotion_rank = RK_8;
+	};
+
+	template<>
+	struct ColourTraits<Colour::BLACK>
+	{
+		static constexpr Direction forward = DIR_SOUTH;
+		static constexpr Rank pawn_rank = RK_7;
+		static constexpr Rank enpassant_rank = RK_3;
+		static constexpr Rank promotion_rank = RK_1;
+	};
+
+	// Get colour of the opponent of a player
+	constexpr Colour getOpponent(Colour c)
+	{
+		return c == Colour::WHITE ? Colour::BLACK : Colour::WHITE;
+	}
+
+	// Get rank on which the pawns of a player are promoted
+	constexpr Rank getPromotionRank(Colour c)
+	{
+		return c == Colour::WHITE ? ColourTraits<Colour::WHITE>::promotion_rank :
+		                            ColourTraits<Colour::BLACK>::promotion_rank;
+	}
+
 }